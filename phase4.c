@@ -15,6 +15,22 @@
 #define IN_USE 1
 #define AWAKE 2
 #define ASLEEP 3
+#define MAXDISKREQS (MAXPROC * 4)
+#define DISK_GEN_MASK 0xfffff     // keeps gen * MAXDISKREQS + slot a positive int
+#define BUSY_BITS (8 * (int)sizeof(unsigned long))
+#define DISK_MAXSTEPS (4 * (USLOSS_DISK_TRACK_SIZE + 1))
+#define DISK_AGE_LIMIT 8
+#define DISK_CFQ_SLICE 64
+#define DISK_ANTIC_WINDOW 20000
+#define DISK_ANTIC_DIST 2
+#define DISK_ANTIC_BATCH 8      // follow-ups in a row before the elevator gets a turn
+#define DISK_WRITE_STARVE 4
+#define DISK_WRITE_BATCH 8
+#define DISK_DIR_READ 0
+#define DISK_DIR_WRITE 1
+#define DISK_CONFLICT_NONE 0    // overlaps nothing it must follow
+#define DISK_CONFLICT_BUCKET 1  // only requests waiting in its own bucket
+#define DISK_CONFLICT_HOLD 2    // something else, it has to wait aside
 
 // ----- Includes
 #include <phase1.h>
@@ -22,6 +38,7 @@
 #include <phase3.h>
 #include <phase4.h>
 #include <phase4_usermode.h>
+#include "phase4_internal.h"
 #include <usloss.h>
 #include <usyscall.h>
 #include <string.h>
@@ -31,7 +48,11 @@
 // ----- typedefs
 typedef USLOSS_Sysargs sysArgs;
 typedef struct sleepRequest sleepRequest; 
-typedef struct diskRequest diskRequest; 
+typedef struct diskProc diskProc;
+typedef struct diskQueue diskQueue;
+typedef struct diskUnit diskUnit;
+typedef struct diskStep diskStep;
+typedef struct diskCfq diskCfq;
 
 // ----- Structs
 
@@ -44,13 +65,93 @@ struct sleepRequest {
 
 struct diskRequest {
     int pid;
-    int track;
-    int first;
-    int sector; 
-    void* buffer; 
+    int track;              // queue key, lowest track the request touches
+    diskSegment segs[DISK_MAXSEGS];
+    int nsegs;
     int op;
     int mboxID; 
+    int status;             // completion status for the caller
+    int async;              // if the caller collects it with DiskWait
+    int gen;                // bumped on free so stale handles are rejected
+    int queuedAt;           // when it was handed to the daemon
+    int startedAt;          // when its first chunk went to the device
+    int ioClass;            // DISK_CLASS_* of the process that issued it
+    int dir;                // DISK_DIR_* queue it waits in
     diskRequest* next; 
+    diskRequest* doneNext;  // next completed, unreaped async request
+    diskRequest* mergeNext; // next request riding along in the same pass
+    diskRequest* shareNext; // next request completed by this one's work
+};
+
+struct diskQueue {
+    diskRequest* head[DISK_MAXTRACKS];  // oldest waiting request per track
+    diskRequest* tail[DISK_MAXTRACKS];  // newest waiting request per track
+    unsigned long busy[DISK_MAXTRACKS / BUSY_BITS]; // tracks with requests
+    int count;                          // requests waiting on all tracks
+};
+
+struct diskStep {
+    USLOSS_DeviceRequest request;   // what to send to the device
+    diskRequest* req;   // request(s) the sector belongs to, NULL on a seek
+    int abs;            // absolute sector, for blaming errors
+    int status;         // device status, filled in by the interrupt
+};
+
+struct diskCfq {
+    diskRequest* head;  // the process's waiting requests, sorted by track
+    int count;          // requests in the list
+    int budget;         // sectors left in its turn
+    int active;         // if it is on the round robin
+    int pid;            // process it belongs to while active
+    int nextActive;     // next slot on the round robin, -1 at the end
+};
+
+struct diskUnit {
+    int wakeMbox;           // wakes the daemon when requests are queued
+    int queueMutex;         // lock for the request queue
+    int headTrack;          // track the arm is on, -1 until the first seek
+    diskStep steps[DISK_MAXSTEPS]; // device operations chained together
+    int nsteps;             // steps in the chain
+    int curStep;            // step on the device, -1 when not chaining
+    int geomMutex;          // token handed around once the geometry is known
+    int geomReady;          // set once the fields below are filled in
+    int sectorSize;         // bytes in a sector
+    int trackSize;          // sectors in a track
+    int numTracks;          // tracks on the disk, probed by the daemon
+    diskQueue queues[DISK_NCLASSES][2]; // requests waiting, by class and
+                                        // DISK_DIR_*
+    int writeStarve;        // reads served while writes waited
+    int writeStarveLimit;   // reads after which writes get a batch
+    int writeBatch;         // writes left in the current batch
+    int writeBatchSize;     // writes per batch
+    int age[DISK_NCLASSES]; // times each class was passed over
+    int sched;              // DISK_SCHED_* used for new requests
+    int cfqSlice;           // sectors a process gets per turn in CFQ
+    diskCfq cfq[DISK_NCLASSES][MAXPROC]; // CFQ sub-queues, one per process
+    int cfqFirst[DISK_NCLASSES]; // round robin, process being served first
+    int cfqLast[DISK_NCLASSES];
+    int cfqCount[DISK_NCLASSES]; // requests in all CFQ sub-queues
+    int anticWindow;        // microseconds to wait for a follow-up read
+    long anticDeadline;     // end of the wait going on, 0 if none
+    int anticStreak;        // follow-ups served in a row
+    diskRequest* active;    // request in service, with its merged riders
+    diskRequest* heldHead;  // requests waiting for an overlapping one to
+    diskRequest* heldTail;  // finish, in arrival order
+    diskStats stats;        // counters, the daemon owns most of them
+    int heat[DISK_MAXTRACKS]; // requests that touched each track, ditto
+};
+
+struct diskProc {
+    int pid;            // process currently owning this slot
+    int pending;        // async requests issued but not yet reaped
+    int waitingAny;     // if the owner is blocked in DiskWaitAny
+    int wakeMbox;       // wakes the owner out of DiskWaitAny
+    int ioClass;        // DISK_CLASS_* of the owner's requests
+    int diskTime;       // microseconds of device time used by the owner
+    int lastDone;       // when its last synchronous read completed, or -1
+    int thinkTime;      // running average of the gap before the next read
+    int thinkSamples;   // gaps measured so far
+    diskRequest* done;  // completed async requests, oldest first
 };
 
 // ----- Function Prototypes
@@ -66,6 +167,16 @@ void termWriteHandler(sysArgs*);
 void diskSizeHandler(sysArgs*);
 void diskReadHandler(sysArgs*);
 void diskWriteHandler(sysArgs*);
+void diskReadAsyncHandler(sysArgs*);
+void diskWriteAsyncHandler(sysArgs*);
+void diskWaitHandler(sysArgs*);
+void diskReadVHandler(sysArgs*);
+void diskWriteVHandler(sysArgs*);
+void diskStatsHandler(sysArgs*);
+void diskHeatHandler(sysArgs*);
+void diskSetPriorityHandler(sysArgs*);
+void diskControlHandler(sysArgs*);
+void diskProcTimeHandler(sysArgs*);
 
 // Helpers
 void kernelCheck(char*);
@@ -74,11 +185,80 @@ int sleepHelperMain(char*);
 void cleanSleepEntry(int);
 int getNextSleeper();
 int termHelperMain(char*);
+int termReadLine(int, char*);
+void termWriteLock(int);
+void termWriteUnlock(int);
+void termWriteChars(int, char*, int);
 int diskHelperMain(char*);
-void diskSeek(int, int);
+void diskChainSeek(int, int);
 int diskReader(int, int, int, int, void*);
-void diskQueueHelper(int, int, int);
+void diskQueueHelper(int, diskRequest*);
+void diskPlaceRequest(int, diskRequest*, diskQueue*);
+void diskReleaseHeld(int);
+int diskConflicts(diskRequest*, diskRequest*);
+int diskFindConflicts(diskUnit*, diskRequest*, diskRequest*, diskQueue**);
 int diskWrite(int, int, int, int, void*);
+diskRequest* diskAllocRequest(void);
+void diskFreeRequest(diskRequest*);
+diskProc* getDiskProc(int);
+diskRequest* diskSubmit(int, int, int, int, void*, int, int);
+diskRequest* diskSubmitV(int, diskSegment*, int, int, int);
+diskRequest* diskSubmitRaw(int, int, int, int, void*, int);
+diskRequest* diskSubmitRawV(int, diskSegment*, int, int);
+diskRequest* diskQueueSegs(int, diskSegment*, int, int, int, int);
+void diskChainSector(int, diskRequest*, int, int, int, void*);
+void diskChainRun(int);
+void diskIntHandler(int, void*);
+int diskGatherMerges(diskQueue*, diskRequest*);
+int diskOverlaps(diskRequest*, int, int);
+int diskServiceChunk(int, diskRequest*, int*);
+void diskServiceMerged(int, diskRequest*, int*);
+diskRequest* diskSectorOwner(diskRequest*, int, void**);
+int getDiskMerges(int);
+int diskDedup(int, diskRequest*);
+void diskQueueInit(diskQueue*);
+void diskQueuePush(diskQueue*, diskRequest*);
+void diskQueuePushFront(diskQueue*, diskRequest*);
+diskRequest* diskQueuePop(diskQueue*, int);
+void diskQueueUnlink(diskQueue*, diskRequest*, diskRequest*);
+int diskQueueNextTrack(diskQueue*, int);
+int getDiskSharedReads(int);
+int getDiskAbsorbedWrites(int);
+int diskGetTracks(int);
+int diskUserTracks(int);
+int diskPickMirror(int*);
+void diskCountMirror(int);
+void diskSetClass(int);
+int diskCheckArgs(int, int, int);
+void diskVectorHelper(sysArgs*, int);
+int diskReap(diskRequest*);
+void diskFinishRequest(diskRequest*);
+void diskAsyncHelper(sysArgs*, int);
+int diskWaitHelper(int, int*, int*);
+void diskAccount(int, diskRequest*, int);
+void diskHistAdd(int*, int);
+int diskHistPercentile(int*, int);
+void diskStatsSnapshot(int, diskStats*);
+int diskHeat(int, int*, int);
+diskRequest* diskUnitPop(diskUnit*, int);
+int diskQueueDepth(diskUnit*);
+int diskClassCount(diskUnit*, int);
+void diskUnitPush(diskUnit*, diskRequest*, int);
+void diskCfqPush(diskUnit*, diskRequest*, int);
+int diskCfqSlot(diskUnit*, int, int);
+diskRequest* diskCfqPop(diskUnit*, int, int);
+void diskCfqDrain(diskUnit*);
+int diskChunkSectors(diskRequest*);
+int diskPickDirection(diskUnit*, int);
+void diskChargeTime(int, int);
+int diskShouldAnticipate(diskUnit*, int, int);
+int diskAnticBlocked(diskUnit*, int);
+void diskAgeClasses(diskUnit*, int);
+void diskChargeFollowUp(diskUnit*, diskRequest*);
+void diskNoteReadDone(int);
+diskRequest* diskAnticipate(diskUnit*, int, int, int);
+diskRequest* diskTakeFollowUp(diskUnit*, int, int);
+int diskConflictsBefore(diskQueue*, diskRequest*);
 
 // ----- Global data structures/vars
 
@@ -86,6 +266,7 @@ int diskWrite(int, int, int, int, void*);
 sleepRequest sleepRequestsTable[MAXPROC];
 sleepRequest* sleepRequests;
 int curSleeperIdx;      
+int sleepListMutex;
 
 // terminal
 char termLines[USLOSS_TERM_UNITS][MAXLINE]; 
@@ -95,20 +276,13 @@ int termReadyWrite[USLOSS_TERM_UNITS];
 int termWriteMutex[USLOSS_TERM_UNITS];
 
 // disk
-diskRequest diskRequestsTable[MAXPROC];
-int disk0;
-int disk0Q;
-int disk1;
-int disk1Q;
-int disk0Mutex;
-int disk1Mutex;
-int disk0MutexTrack;
-int disk1MutexTrack;
-int globaldisk;
-int disk0NumTracks;
-int disk1NumTracks;
-diskRequest* disk0Req;
-diskRequest* disk1Req;
+diskRequest diskRequestsTable[MAXDISKREQS];
+diskRequest* diskFreeRequests;
+int diskTableMutex;
+diskProc diskProcTable[MAXPROC];
+int diskProcMutex;
+diskUnit diskUnits[USLOSS_DISK_UNITS];
+void (*phase2DiskHandler)(int, void*);
 
 // ----- Phase 4 Bootload
 
@@ -124,13 +298,34 @@ void phase4_init(void) {
     systemCallVec[SYS_DISKSIZE]  = diskSizeHandler;
     systemCallVec[SYS_DISKREAD]  = diskReadHandler;
     systemCallVec[SYS_DISKWRITE] = diskWriteHandler;
+    systemCallVec[SYS_DISKREADASYNC]  = diskReadAsyncHandler;
+    systemCallVec[SYS_DISKWRITEASYNC] = diskWriteAsyncHandler;
+    systemCallVec[SYS_DISKWAIT]       = diskWaitHandler;
+    systemCallVec[SYS_DISKREADV]      = diskReadVHandler;
+    systemCallVec[SYS_DISKWRITEV]     = diskWriteVHandler;
+    systemCallVec[SYS_DISKCOPY]       = diskCopyHandler;
+    systemCallVec[SYS_SPLICEOUT]      = spliceOutHandler;
+    systemCallVec[SYS_SPLICEIN]       = spliceInHandler;
+    systemCallVec[SYS_SPLICEWAIT]     = spliceWaitHandler;
+    systemCallVec[SYS_DISKSTATS]      = diskStatsHandler;
+    systemCallVec[SYS_DISKHEAT]       = diskHeatHandler;
+    systemCallVec[SYS_DISKSETPRIO]    = diskSetPriorityHandler;
+    systemCallVec[SYS_DISKCONTROL]    = diskControlHandler;
+    systemCallVec[SYS_DISKPROCTIME]   = diskProcTimeHandler;
+    systemCallVec[SYS_BLOCKIO]        = blockIOHandler;
+    systemCallVec[SYS_FILECREATE]     = fileCreateHandler;
+    systemCallVec[SYS_FILEOPEN]       = fileOpenHandler;
+    systemCallVec[SYS_FILEIO]         = fileIOHandler;
+    systemCallVec[SYS_KV]             = kvHandler;
 
     // sleepRequest setup
     for (int i = 0; i < MAXPROC; i++) {
         cleanSleepEntry(i);
+        sleepRequestsTable[i].mutex = MboxCreate(1, 0);
     }
     sleepRequests = NULL;
     curSleeperIdx = 0;
+    sleepListMutex = MboxCreate(1, 0);
 
     // terminal initialization
     memset(termLines, '\0', sizeof(termLines));
@@ -142,24 +337,79 @@ void phase4_init(void) {
         termWriteMutex[i] = MboxCreate(1, 0);
     }
 
-    // diskRequest setup
-    for (int i = 0; i < MAXPROC; i++) {
+    // diskRequest setup, every slot starts out on the free list
+    diskFreeRequests = NULL;
+    for (int i = MAXDISKREQS - 1; i >= 0; i--) {
         cleanDiskEntry(i);
+        diskRequestsTable[i].gen = 0;
+        diskRequestsTable[i].mboxID = MboxCreate(1, 0);
+        diskRequestsTable[i].next = diskFreeRequests;
+        diskFreeRequests = &diskRequestsTable[i];
+    }
+    diskTableMutex = MboxCreate(1, 0);
+
+    // per process async bookkeeping
+    for (int i = 0; i < MAXPROC; i++) {
+        diskProcTable[i].pid = -1;
+        diskProcTable[i].pending = 0;
+        diskProcTable[i].waitingAny = 0;
+        diskProcTable[i].done = NULL;
+        diskProcTable[i].ioClass = DISK_CLASS_BE;
+        diskProcTable[i].diskTime = 0;
+        diskProcTable[i].lastDone = -1;
+        diskProcTable[i].thinkTime = 0;
+        diskProcTable[i].thinkSamples = 0;
+        diskProcTable[i].wakeMbox = MboxCreate(1, 0);
+    }
+    diskProcMutex = MboxCreate(1, 0);
+
+    // per unit state, the geometry is filled in by each daemon
+    memset(diskUnits, 0, sizeof(diskUnits));
+    for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+        diskUnits[i].wakeMbox = MboxCreate(1, 0);
+        diskUnits[i].queueMutex = MboxCreate(1, 0);
+        diskUnits[i].headTrack = -1;
+        diskUnits[i].curStep = -1;
+        diskUnits[i].geomMutex = MboxCreate(1, 0);
+        diskUnits[i].sched = DISK_SCHED_CLOOK;
+        diskUnits[i].cfqSlice = DISK_CFQ_SLICE;
+        diskUnits[i].anticWindow = DISK_ANTIC_WINDOW;
+        diskUnits[i].anticDeadline = 0;
+        diskUnits[i].active = NULL;
+        diskUnits[i].heldHead = NULL;
+        diskUnits[i].heldTail = NULL;
+        diskUnits[i].writeStarveLimit = DISK_WRITE_STARVE;
+        diskUnits[i].writeBatchSize = DISK_WRITE_BATCH;
+        for (int c = 0; c < DISK_NCLASSES; c++) {
+            diskQueueInit(&diskUnits[i].queues[c][DISK_DIR_READ]);
+            diskQueueInit(&diskUnits[i].queues[c][DISK_DIR_WRITE]);
+            diskUnits[i].cfqFirst[c] = -1;
+            diskUnits[i].cfqLast[c] = -1;
+        }
     }
 
-    // setup all mutexes
-    disk0 = MboxCreate(1, 0);
-    disk0Q = MboxCreate(1, 0);
-    disk1 = MboxCreate(1, 0);
-    disk1Q = MboxCreate(1, 0);
-    disk0Mutex = MboxCreate(1, 0);
-    disk1Mutex = MboxCreate(1, 0);
-    disk0MutexTrack = MboxCreate(1, 0);
-    disk1MutexTrack = MboxCreate(1, 0);
+    // chain disk operations from the interrupt, phase2 only hears about
+    // the last one of each chain
+    phase2DiskHandler = USLOSS_IntVec[USLOSS_DISK_INT];
+    USLOSS_IntVec[USLOSS_DISK_INT] = diskIntHandler;
+
+    // logical volumes on top of the disks
+    blockInit();
+
+    // journals of small writes
+    journalInit();
 
-    // setup linked lists
-    disk0Req = NULL;
-    disk1Req = NULL;
+    // flat file store
+    fileInit();
+
+    // read cache and its hot lists
+    cacheInit();
+
+    // key-value store
+    kvInit();
+
+    // disk to disk copies
+    copyInit();
 }
 
 /**
@@ -192,6 +442,18 @@ void phase4_start_service_processes(void) {
         int diskPID = fork1(process, diskHelperMain, buffer, USLOSS_MIN_STACK, 2);
     }
 
+    // cleaner for the log structured volumes
+    blockStartDaemons();
+
+    // journal daemons, they replay what the journals hold first
+    journalStartDaemons();
+
+    // cache warmer, it reads the hot lists and prefetches what they name
+    cacheStartDaemons();
+
+    // splice workers, two per terminal
+    spliceStartDaemons();
+
 
 }
 
@@ -217,26 +479,32 @@ void sleepHandler(sysArgs* args) {
         return;
     }
 
+    MboxSend(sleepListMutex, NULL, 0);
+
     int sleepIdx = getNextSleeper();
+    if (sleepIdx < 0) {
+        MboxRecv(sleepListMutex, NULL, 0);
+        args->arg4 = (void *)(long)-1;
+        return;
+    }
 
     // allocate the sleep request
     sleepRequest* toSleep = &sleepRequestsTable[sleepIdx];
     toSleep->wakeUpTime = currentTime() + msecs * 1000000;
-    toSleep->mutex = MboxCreate(1, 0);
     toSleep->status = ASLEEP;
 
     // add to sleep requests queue
-    if (sleepRequests == NULL) {
-        sleepRequests = toSleep;
-    } else {
-        sleepRequest* rest = sleepRequests;
-        toSleep->next = rest; 
-        sleepRequests = toSleep; 
-    }
+    toSleep->next = sleepRequests;
+    sleepRequests = toSleep;
+
+    MboxRecv(sleepListMutex, NULL, 0);
 
     // block/sleep proc until we can wake it up
     MboxRecv(toSleep->mutex, NULL, 0);
 
+    // the daemon took us off the list, the slot can be reused now
+    toSleep->status = FREE;
+
     // return 0 as operation was successful
     args->arg4 = (void *) (long) 0;
 }
@@ -268,7 +536,7 @@ void termReadHandler(sysArgs* args) {
     char line[MAXLINE];
 
     // receive line from mailbox
-    int lineLen = MboxRecv(termRead[termUnit], &line, MAXLINE);
+    int lineLen = termReadLine(termUnit, line);
 
     // if the location is less than the lineLen, we need to bound lineLen
     if (locationLen < lineLen) {
@@ -305,28 +573,16 @@ void termWriteHandler(sysArgs* args) {
     }
 
     // acquire lock to work on terminal
-    MboxSend(termWriteMutex[termUnit], NULL, 0);
-
-    for (int i = 0; i < locationLen; i++) {
-        // if we are not ready, block
-        MboxRecv(termReadyWrite[termUnit], NULL, 0);
-
-        // get the control value
-        int ctrl = 0x1;
-        ctrl |= 0x2;
-        ctrl |= 0x4;
-        ctrl |= (location[i] << 8);
+    termWriteLock(termUnit);
 
-        // update the control while writing to character
-        USLOSS_DeviceOutput(USLOSS_TERM_DEV, termUnit, (void*)(long)ctrl);
-    }
+    termWriteChars(termUnit, location, locationLen);
 
     // set return values
     args->arg2 = (void*)(long)locationLen;
     args->arg4 = (void*)(long)0;
 
     // release lock as we stopped work on the terminal
-    MboxRecv(termWriteMutex[termUnit], NULL, 0);
+    termWriteUnlock(termUnit);
 }
 
 /**
@@ -343,21 +599,19 @@ void diskSizeHandler(sysArgs* args) {
     kernelCheck("diskSizeHandler");
 
     int unit = (long)args->arg1;
-    int daemonMutexTrack = -1;
 
-    // setup daemon mutex
-    if (unit == 0) {
-        daemonMutexTrack = disk0MutexTrack;
-    } else {
-        daemonMutexTrack = disk1MutexTrack;
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        args->arg4 = (void *)(long)-1;
+        return;
     }
 
-    MboxRecv(daemonMutexTrack, NULL, 0);
+    // only blocks if the daemons have not probed the disk and its journal yet
+    int numTracks = diskUserTracks(unit);
 
     // set the appropriate syscall output values
-    args->arg1 = (void *)USLOSS_DISK_SECTOR_SIZE;
-    args->arg2 = (void *)USLOSS_DISK_TRACK_SIZE;
-    args->arg3 = (void *)(long) globaldisk;
+    args->arg1 = (void *)(long) diskUnits[unit].sectorSize;
+    args->arg2 = (void *)(long) diskUnits[unit].trackSize;
+    args->arg3 = (void *)(long) numTracks;
     args->arg4 = (void *)0;
 
 }
@@ -380,6 +634,11 @@ void diskReadHandler(sysArgs* args) {
     int first = (int)(long)args->arg4;
     int unit = (int)(long)args->arg5;
 
+    if (sectors <= 0 || diskCheckArgs(unit, track, first) < 0) {
+        args->arg4 = (void *)(long)-1;
+        return;
+    }
+
     args->arg1 = (void *)(long)diskReader(unit, track, first, sectors, buffer);
     args->arg4 = (void *)(long)0;
 
@@ -403,27 +662,325 @@ void diskWriteHandler(sysArgs* args) {
     int first = (int)(long)args->arg4;
     int unit = (int)(long)args->arg5;
 
-    if (unit != 1 && unit != 0) {
+    if (sectors <= 0 || diskCheckArgs(unit, track, first) < 0) {
         args->arg4 = (void*)(long)-1;
         return;
     }
 
-    int numTracks = -1;
+    args->arg1 = (void*)(long)diskWrite(unit, track, first, sectors, buffer);
+    args->arg4 = (void*)(long)0;
+
+}
 
-    if (unit == 0) {
-        numTracks = 16;
-    } else {
-        numTracks = 32;
+/**
+ * Queues a read of a certain number of blocks from disk and returns right
+ * away with a handle for the request. The caller must not touch the buffer
+ * until the request has been collected with DiskWait or DiskWaitAny.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+*/
+void diskReadAsyncHandler(sysArgs* args) {
+    kernelCheck("diskReadAsyncHandler");
+    diskAsyncHelper(args, USLOSS_DISK_READ);
+}
+
+/**
+ * Queues a write of a certain number of blocks to disk and returns right
+ * away with a handle for the request. The caller must not touch the buffer
+ * until the request has been collected with DiskWait or DiskWaitAny.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+*/
+void diskWriteAsyncHandler(sysArgs* args) {
+    kernelCheck("diskWriteAsyncHandler");
+    diskAsyncHelper(args, USLOSS_DISK_WRITE);
+}
+
+/**
+ * Blocks until an asynchronous disk request of the calling process has
+ * completed, and hands back its status. A handle of -1 waits for whichever
+ * request finishes first (DiskWaitAny).
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+*/
+void diskWaitHandler(sysArgs* args) {
+    kernelCheck("diskWaitHandler");
+
+    int handle = (int)(long)args->arg1;
+    int status = 0;
+
+    if (diskWaitHelper(handle, &handle, &status) < 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
     }
 
-    if (track < 0 || track > numTracks - 1 || first < 0 || first >= USLOSS_DISK_TRACK_SIZE) {
-        args->arg4 = (void *)(long)-1;
+    args->arg1 = (void*)(long)handle;
+    args->arg2 = (void*)(long)status;
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Reads a list of (track, first, count, buffer) segments from disk. The
+ * daemon services the whole vector in one pass, in the order the head
+ * reaches the segments, and wakes the caller once at the end.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+*/
+void diskReadVHandler(sysArgs* args) {
+    kernelCheck("diskReadVHandler");
+    diskVectorHelper(args, USLOSS_DISK_READ);
+}
+
+/**
+ * Writes a list of (track, first, count, buffer) segments to disk. The
+ * daemon services the whole vector in one pass, in the order the head
+ * reaches the segments, and wakes the caller once at the end.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+*/
+void diskWriteVHandler(sysArgs* args) {
+    kernelCheck("diskWriteVHandler");
+    diskVectorHelper(args, USLOSS_DISK_WRITE);
+}
+
+/**
+ * Copies the I/O counters and latency histograms of a disk unit out to
+ * the caller.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+ */
+void diskStatsHandler(sysArgs* args) {
+    kernelCheck("diskStatsHandler");
+
+    int unit = (int)(long) args->arg1;
+    diskStats* stats = (diskStats*) args->arg2;
+
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS || stats == NULL) {
+        args->arg4 = (void*)(long)-1;
         return;
     }
 
-    args->arg1 = (void*)(long)diskWrite(unit, track, first, sectors, buffer);
+    diskStatsSnapshot(unit, stats);
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Copies the per-track access counts of a disk unit out to the caller,
+ * as many as fit, and tells how many tracks the disk has.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+ */
+void diskHeatHandler(sysArgs* args) {
+    kernelCheck("diskHeatHandler");
+
+    int unit = (int)(long) args->arg1;
+    int* counts = (int*) args->arg2;
+    int size = (int)(long) args->arg3;
+
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS || size < 0 || (size > 0 && counts == NULL)) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    args->arg1 = (void*)(long) diskHeat(unit, counts, size);
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Sets the I/O priority class of the calling process. Its requests from
+ * then on are queued with that class.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+ */
+void diskSetPriorityHandler(sysArgs* args) {
+    kernelCheck("diskSetPriorityHandler");
+
+    int ioClass = (int)(long) args->arg1;
+
+    if (ioClass < 0 || ioClass >= DISK_NCLASSES) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    diskSetClass(ioClass);
+
     args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Reads or changes a tunable of a disk unit, like which scheduler it
+ * runs. A request already queued stays where it is when the scheduler
+ * changes.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+ */
+void diskControlHandler(sysArgs* args) {
+    kernelCheck("diskControlHandler");
+
+    int unit = (int)(long) args->arg1;
+    int ctl = (int)(long) args->arg2;
+    int value = (int)(long) args->arg3;
+
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    // the journal daemon does this one, it takes disk I/O
+    if (ctl == DISK_CTL_JOURNAL) {
+        if (value != 0 && value != 1) {
+            args->arg4 = (void*)(long)-1;
+            return;
+        }
+        args->arg4 = (void*)(long)(journalEnable(unit, value) == 0 ? 0 : -1);
+        return;
+    }
+
+    // the cache reads and writes its list
+    if (ctl == DISK_CTL_CACHE) {
+        if (value != 0 && value != 1) {
+            args->arg4 = (void*)(long)-1;
+            return;
+        }
+        args->arg4 = (void*)(long)(cacheEnable(unit, value) == 0 ? 0 : -1);
+        return;
+    }
+
+    // the key-value store formats or drops its region
+    if (ctl == DISK_CTL_KV) {
+        if (value < 0) {
+            args->arg4 = (void*)(long)-1;
+            return;
+        }
+        args->arg4 = (void*)(long)(kvEnable(unit, value) == 0 ? 0 : -1);
+        return;
+    }
+
+    // and so does the file store
+    if (ctl == DISK_CTL_FILES) {
+        if (value < 0) {
+            args->arg4 = (void*)(long)-1;
+            return;
+        }
+        args->arg4 = (void*)(long)(fileEnable(unit, value) == 0 ? 0 : -1);
+        return;
+    }
+
+    // the block layer owns the remapping table
+    if (ctl == DISK_CTL_MIGRATE) {
+        if (value != 0 && value != 1) {
+            args->arg4 = (void*)(long)-1;
+            return;
+        }
+        args->arg4 = (void*)(long)(blockMigrateEnable(unit, value) == 0 ? 0 : -1);
+        return;
+    }
+
+    diskUnit* disk = &diskUnits[unit];
+    int rc = 0;
+
+    MboxSend(disk->queueMutex, NULL, 0);
+    switch (ctl) {
+        case DISK_CTL_SCHED:
+            if (value == DISK_SCHED_CLOOK || value == DISK_SCHED_CFQ || value == DISK_SCHED_AS) {
+                // nothing pops the sub-queues once CFQ is left
+                if (disk->sched == DISK_SCHED_CFQ && value != DISK_SCHED_CFQ) {
+                    diskCfqDrain(disk);
+                }
+                disk->sched = value;
+            } else {
+                rc = -1;
+            }
+            break;
+        case DISK_CTL_CFQSLICE:
+            if (value > 0) {
+                disk->cfqSlice = value;
+            } else {
+                rc = -1;
+            }
+            break;
+        case DISK_CTL_WRITESTARVE:
+            if (value > 0) {
+                disk->writeStarveLimit = value;
+            } else {
+                rc = -1;
+            }
+            break;
+        case DISK_CTL_WRITEBATCH:
+            if (value > 0) {
+                disk->writeBatchSize = value;
+            } else {
+                rc = -1;
+            }
+            break;
+        case DISK_CTL_ANTICWINDOW:
+            if (value > 0) {
+                disk->anticWindow = value;
+            } else {
+                rc = -1;
+            }
+            break;
+        default:
+            rc = -1;
+    }
+    MboxRecv(disk->queueMutex, NULL, 0);
+
+    args->arg4 = (void*)(long)rc;
+}
+
+/**
+ * Tells how much device time the requests of a process have used. A
+ * process that never touched the disk has used none.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * 
+ * @return void
+ */
+void diskProcTimeHandler(sysArgs* args) {
+    kernelCheck("diskProcTimeHandler");
+
+    int pid = (int)(long) args->arg1;
+
+    if (pid < 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    MboxSend(diskProcMutex, NULL, 0);
+    diskProc* proc = &diskProcTable[pid % MAXPROC];
+    int used = proc->pid == pid ? proc->diskTime : 0;
+    MboxRecv(diskProcMutex, NULL, 0);
 
+    args->arg1 = (void*)(long)used;
+    args->arg4 = (void*)(long)0;
 }
 
 // ----- Helper Functions
@@ -460,18 +1017,39 @@ int sleepHelperMain(char* args) {
     while (1) {
         waitDevice(USLOSS_CLOCK_DEV, 0, &status);
 
-        sleepRequest *proc = sleepRequests;
+        MboxSend(sleepListMutex, NULL, 0);
+
+        sleepRequest** link = &sleepRequests;
         
         // if we still have processes to wake up, do 
         // so 
-        while (proc != NULL) {
+        while (*link != NULL) {
+            sleepRequest* proc = *link;
+
             // if we can wake up one process, do so, otherwise check along
             // the queue
-            if (proc->status == ASLEEP && proc->wakeUpTime < currentTime()) {
-                proc->status = AWAKE;
-                MboxSend(proc->mutex, NULL, 0);
+            if (proc->status != ASLEEP || proc->wakeUpTime >= currentTime()) {
+                link = &proc->next;
+                continue;
+            }
+
+            *link = proc->next;
+            proc->next = NULL;
+
+            // the sleeper frees its slot once it is running again
+            proc->status = AWAKE;
+            MboxSend(proc->mutex, NULL, 0);
+        }
+
+        MboxRecv(sleepListMutex, NULL, 0);
+
+        // end the anticipation of any disk whose window is over
+        for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+            diskUnit* unit = &diskUnits[i];
+            if (unit->anticDeadline > 0 && unit->anticDeadline <= currentTime()) {
+                unit->anticDeadline = 0;
+                MboxCondSend(unit->wakeMbox, NULL, 0);
             }
-            proc = proc->next;
         }
     }
     return 0; 
@@ -484,7 +1062,6 @@ int sleepHelperMain(char* args) {
  * @param slot, int representing index into the sleepRequestTable
  */
 void cleanSleepEntry(int slot) {
-    sleepRequestsTable[slot].mutex = 0;
     sleepRequestsTable[slot].next = NULL;
     sleepRequestsTable[slot].status = FREE;
     sleepRequestsTable[slot].wakeUpTime = 0;
@@ -579,165 +1156,250 @@ int termHelperMain(char* args) {
 }
 
 /**
- * Helper for cleaning/initializing a disk entry to the default/zero
- * values. 
+ * Blocks until the terminal has a line of input and takes it. The line
+ * either ends with a newline or is exactly MAXLINE characters long.
  * 
- * @param slot, int representing index into the diskRequestTable
+ * @param termUnit, int representing the terminal
+ * @param line, char* representing a buffer of MAXLINE characters
+ * 
+ * @return int the length of the line
  */
-void cleanDiskEntry(int slot) {
-    diskRequestsTable[slot].pid = -1;
-    diskRequestsTable[slot].next = NULL;
-    diskRequestsTable[slot].mboxID = MboxCreate(1, 0);
+int termReadLine(int termUnit, char* line) {
+    return MboxRecv(termRead[termUnit], line, MAXLINE);
 }
 
 /**
- * Main function for the daemon process responsible for checking
- * disk requests. 
+ * Takes the output side of a terminal, so the characters written until it
+ * is released come out together.
  * 
- * @param args, char pointer for the main function arguments
+ * @param termUnit, int representing the terminal
+ */
+void termWriteLock(int termUnit) {
+    MboxSend(termWriteMutex[termUnit], NULL, 0);
+}
+
+/**
+ * Releases the output side of a terminal.
  * 
- * @return int representing if the exit status was normal
+ * @param termUnit, int representing the terminal
  */
-int diskHelperMain(char* args) {
-    int daemonMbox;
-    int daemonQMbox;
-    int daemonMutex;
-    int daemonMutexTrack;
-    int diskUnit;
+void termWriteUnlock(int termUnit) {
+    MboxRecv(termWriteMutex[termUnit], NULL, 0);
+}
 
+/**
+ * Writes characters to a terminal one at a time, waiting for the daemon
+ * to say it is ready for each. The caller holds the terminal's output.
+ * 
+ * @param termUnit, int representing the terminal
+ * @param buffer, char* representing the characters
+ * @param len, int representing how many there are
+ */
+void termWriteChars(int termUnit, char* buffer, int len) {
+    for (int i = 0; i < len; i++) {
+        // if we are not ready, block
+        MboxRecv(termReadyWrite[termUnit], NULL, 0);
 
-    int res;
+        // get the control value
+        int ctrl = 0x1;
+        ctrl |= 0x2;
+        ctrl |= 0x4;
+        ctrl |= (buffer[i] << 8);
+
+        // update the control while writing to character
+        USLOSS_DeviceOutput(USLOSS_TERM_DEV, termUnit, (void*)(long)ctrl);
+    }
+}
+
+/**
+ * Helper for cleaning/initializing a disk entry to the default/zero
+ * values. 
+ * 
+ * @param slot, int representing index into the diskRequestTable
+ */
+void cleanDiskEntry(int slot) {
+    diskRequestsTable[slot].pid = -1;
+    diskRequestsTable[slot].status = 0;
+    diskRequestsTable[slot].async = 0;
+    diskRequestsTable[slot].next = NULL;
+    diskRequestsTable[slot].doneNext = NULL;
+    diskRequestsTable[slot].mergeNext = NULL;
+    diskRequestsTable[slot].shareNext = NULL;
+}
+
+/**
+ * Main function for the daemon process responsible for checking
+ * disk requests. The daemon is the only process that talks to its unit's
+ * device, so a request is serviced start to finish without taking any
+ * lock; only the queue is shared with the syscall handlers.
+ * 
+ * @param args, char pointer for the main function arguments
+ * 
+ * @return int representing if the exit status was normal
+ */
+int diskHelperMain(char* args) {
     int status;
 
-    diskRequest** diskQPtr = NULL;
     diskRequest* diskQ = NULL;
     USLOSS_DeviceRequest request; 
+    int curTrack = 0;
 
     // select appropriate disk
-    if (*args == '0') {
-        diskUnit = 0;
-        daemonMbox = disk0;
-        daemonQMbox = disk0Q;
-        daemonMutex = disk0Mutex;
-        daemonMutexTrack = disk0MutexTrack;
-        diskQPtr = &disk0Req;
-    } else {
-        diskUnit = 1;
-        daemonMbox = disk1;
-        daemonQMbox = disk1Q;
-        daemonMutex = disk1Mutex;
-        daemonMutexTrack = disk1MutexTrack;
-        diskQPtr = &disk1Req;
-    }
+    int diskUnitIdx = atoi(args);
+    diskUnit* unit = &diskUnits[diskUnitIdx];
 
     // get number of tracks
     request.opr = USLOSS_DISK_TRACKS;
-    request.reg1 = (void*)(long)&globaldisk;
+    request.reg1 = (void*)(long)&unit->numTracks;
 
     // enable and receive the request
-    int retval = USLOSS_DeviceOutput(USLOSS_DISK_DEV, diskUnit, &request);
-    waitDevice(USLOSS_DISK_DEV, diskUnit, &status);
+    USLOSS_DeviceOutput(USLOSS_DISK_DEV, diskUnitIdx, &request);
+    waitDevice(USLOSS_DISK_DEV, diskUnitIdx, &status);
+
+    // the queue cannot hold anything past its last bucket
+    if (unit->numTracks > DISK_MAXTRACKS) {
+        USLOSS_Console("Disk %d has %d tracks, only the first %d are usable.\n", diskUnitIdx, unit->numTracks, DISK_MAXTRACKS);
+        unit->numTracks = DISK_MAXTRACKS;
+    }
 
-    // keep the number of tracks
-    if (diskUnit == 0) disk0NumTracks = globaldisk;
-    else disk1NumTracks = globaldisk;
+    // publish the geometry, after this it is read without any lock
+    unit->sectorSize = USLOSS_DISK_SECTOR_SIZE;
+    unit->trackSize = USLOSS_DISK_TRACK_SIZE;
+    unit->geomReady = 1;
 
-    // now we can acquire the lock to work on this disk
-    MboxSend(daemonMutexTrack, NULL, 0);
+    // let through whoever asked before the probe was done
+    MboxSend(unit->geomMutex, NULL, 0);
 
     // daemon work
     while (1) {
         // wait for syscall
-        MboxRecv(daemonMbox, NULL, 0);
-
-        while (*diskQPtr != NULL) {
-            diskQ = *diskQPtr;
-
-            int mboxID = diskQ->mboxID;
-            int track = diskQ->track;
-            int first = diskQ->first;
-            int sector = diskQ->sector;
-            void *buffer = diskQ->buffer;
-            int op = diskQ->op;
-
-            diskSeek(diskUnit, track);
-
-            // setup the USLOSS struct
-            request.opr = op;
-            request.reg1 = (void*)(long)first;
-            request.reg2 = buffer;
-
-            for (int i = 0; i < sector; i++) {
-                // if we were to go over, tart from beginning
-                if ((int)(long)request.reg1 == USLOSS_DISK_TRACK_SIZE) {
-                    request.reg1 = 0;
-                    track++;
-                    diskSeek(diskUnit, track);
-                }
+        MboxRecv(unit->wakeMbox, NULL, 0);
+
+        diskRequest* followUp = NULL;
+        while (1) {
+            // take the next request, and outside CFQ the queued
+            // neighbours that touch the same sectors
+            MboxSend(unit->queueMutex, NULL, 0);
+            if (followUp != NULL) {
+                diskQ = followUp;
+                unit->anticStreak++;
+            } else {
+                diskQ = diskUnitPop(unit, curTrack);
+                unit->anticStreak = 0;
+            }
+            followUp = NULL;
+            int merged = 0;
+            if (diskQ != NULL && unit->sched != DISK_SCHED_CFQ) {
+                merged = diskGatherMerges(&unit->queues[diskQ->ioClass][diskQ->dir], diskQ);
+            }
+            unit->active = diskQ;
+            MboxRecv(unit->queueMutex, NULL, 0);
 
-                // acquire lock since we will send a USLOSS request
-                MboxSend(daemonMutex, NULL, 0);
+            if (diskQ == NULL) {
+                break;
+            }
 
-                // send the request
-                res = USLOSS_DeviceOutput(USLOSS_DISK_DEV, diskUnit, &request);
-                waitDevice(USLOSS_DISK_DEV, diskUnit, &status);
+            unit->stats.merged += merged;
 
-                // since we finish our work (send request), release lock
-                MboxRecv(daemonMutex, NULL, 0);
+            int now = currentTime();
+            for (diskRequest* r = diskQ; r != NULL; r = r->mergeNext) {
+                if (r->startedAt < 0) {
+                    r->startedAt = now;
+                }
+            }
 
-                // increment request pointer to move sectors
-                request.reg1++;
-                request.reg2 += USLOSS_DISK_SECTOR_SIZE;
+            int done = 1;
+            if (merged > 0) {
+                diskServiceMerged(diskUnitIdx, diskQ, &curTrack);
+            } else {
+                done = diskServiceChunk(diskUnitIdx, diskQ, &curTrack);
             }
 
-            // acquire the lock on the queue since we will change it
-            MboxSend(daemonQMbox, NULL, 0);
-            
-            *diskQPtr = (*diskQPtr)->next;
-            diskQ->next = NULL;
+            // the pass is charged to whoever's request led it
+            int finished = currentTime();
+            diskChargeTime(diskQ->pid, finished - now);
+
+            if (!done) {
+                // the rest goes back through the scheduler, so whatever
+                // queued up meanwhile gets a turn on the way, but it keeps
+                // its place ahead of what came after it on its next track
+                MboxSend(unit->queueMutex, NULL, 0);
+                diskUnitPush(unit, diskQ, 1);
+                unit->active = NULL;
+                diskReleaseHeld(diskUnitIdx);
+                MboxRecv(unit->queueMutex, NULL, 0);
+                continue;
+            }
 
-            // release the lock on the queue
-            MboxRecv(daemonQMbox, NULL, 0);
+            // the sectors are on the platter, so whatever had to wait for
+            // them can be queued before anyone is woken up
+            MboxSend(unit->queueMutex, NULL, 0);
+            unit->active = NULL;
+            diskReleaseHeld(diskUnitIdx);
+            MboxRecv(unit->queueMutex, NULL, 0);
+
+            // complete every request that rode along, then the head
+            while (diskQ->mergeNext != NULL) {
+                diskRequest* rider = diskQ->mergeNext;
+                diskQ->mergeNext = rider->mergeNext;
+                rider->mergeNext = NULL;
+                diskAccount(diskUnitIdx, rider, finished);
+                diskFinishRequest(rider);
+            }
+            diskAccount(diskUnitIdx, diskQ, finished);
+
+            // the caller may free the request as soon as it is finished
+            int pid = diskQ->pid;
+            int ioClass = diskQ->ioClass;
+            int syncRead = !diskQ->async && diskQ->op == USLOSS_DISK_READ;
+            if (syncRead) {
+                diskNoteReadDone(pid);
+            }
+            diskFinishRequest(diskQ);
 
-            MboxSend(mboxID, NULL, 0);
+            // give a synchronous reader the chance to ask for more nearby
+            // before the head goes off somewhere else
+            if (syncRead && diskShouldAnticipate(unit, pid, ioClass)) {
+                followUp = diskAnticipate(unit, pid, ioClass, curTrack);
+            }
         }
     }
     return 0;
 }
 
 /**
- * Seeks the given disk for the appropriate task. 
+ * Adds a seek for the appropriate track to the unit's chain. Nothing is
+ * added if the arm will already be on that track. Only called by the
+ * unit's daemon.
  * 
  * @param unit, int representing the disk unit
  * @param track, int representing the track to
  * search for
  */
-void diskSeek(int unit, int track) {
-    int result;
-    int status;
+void diskChainSeek(int unit, int track) {
+    diskUnit* disk = &diskUnits[unit];
 
-    int daemonMutex = 1;
-
-    // check for the unit
-    if (unit == 0) {
-        daemonMutex = disk0Mutex;
-    } else {
-        daemonMutex = disk1Mutex;
+    if (disk->headTrack == track) {
+        return;
     }
 
-    // set up the request struct
-    USLOSS_DeviceRequest request; 
-    request.opr = USLOSS_DISK_SEEK;
-    request.reg1 = (void*)(long)track;
+    // chain is full, get it done before adding more
+    if (disk->nsteps == DISK_MAXSTEPS) {
+        diskChainRun(unit);
+    }
 
-    // acquire lock to work on it
-    MboxSend(daemonMutex, NULL, 0);
+    int from = disk->headTrack < 0 ? 0 : disk->headTrack;
+    disk->stats.seeks++;
+    disk->stats.seekDistance += track > from ? track - from : from - track;
 
-    result = USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, &request);
-    waitDevice(USLOSS_DISK_DEV, unit, &status);
+    // set up the request struct
+    diskStep* step = &disk->steps[disk->nsteps++];
+    step->request.opr = USLOSS_DISK_SEEK;
+    step->request.reg1 = (void*)(long)track;
+    step->req = NULL;
+    step->status = 0;
 
-    // release lock
-    MboxRecv(daemonMutex, NULL, 0);
+    disk->headTrack = track;
 }
 
 /**
@@ -752,97 +1414,228 @@ void diskSeek(int unit, int track) {
  * @return int 0 if the opertaion was sucessful
  */
 int diskReader(int unit, int track, int first, int sectors, void* buffer) {
-    int pid = getpid();
+    if (cacheRead(unit, track, first, sectors, buffer)) {
+        return 0;
+    }
 
-    int daemonQMbox = -1;
-    int daemonMbox = -1;
+    int gen = cacheGen(unit);
+    diskRequest* req = diskSubmit(unit, track, first, sectors, buffer, USLOSS_DISK_READ, 0);
 
-    if (unit == 0) {
-        daemonQMbox = disk0Q;
-        daemonMbox = disk0;
-    } else {
-        daemonQMbox = disk1Q;
-        daemonMbox = disk1;
+    // every request slot is taken by async requests
+    if (req == NULL) {
+        return -1;
     }
 
-    diskRequestsTable[pid % MAXPROC].pid = pid;
-    diskRequestsTable[pid % MAXPROC].track = track;
-    diskRequestsTable[pid % MAXPROC].first = first;
-    diskRequestsTable[pid % MAXPROC].sector = sectors;
-    diskRequestsTable[pid % MAXPROC].buffer = buffer;
-    diskRequestsTable[pid % MAXPROC].op = USLOSS_DISK_READ;
+    int status = diskReap(req);
+    if (status == 0) {
+        cacheFill(unit, track, first, sectors, buffer, gen);
+    }
+    return status;
+}
 
-    // acquire the lock since we want to add ourselves to the queue
-    MboxSend(daemonQMbox, NULL, 0);
+/**
+ * Adds a request to the disk request queue. The caller holds the queue
+ * lock of the unit. Requests that touch the same sectors, one of them a
+ * write, must reach the platter in arrival order. A request whose only
+ * such neighbours wait in the bucket of its own track, in one queue, is
+ * queued behind them there; one that would have to follow anything else,
+ * the request in service included, is held aside until that is done.
+ * 
+ * @param unit, int representing the disk unit
+ * @param newReq, diskRequest* representing the request to add
+ */
+void diskQueueHelper(int unit, diskRequest* newReq) {
+    diskUnit* disk = &diskUnits[unit];
+    diskQueue* where = NULL;
+
+    if (diskFindConflicts(disk, newReq, NULL, &where) == DISK_CONFLICT_HOLD) {
+        newReq->next = NULL;
+        if (disk->heldTail == NULL) {
+            disk->heldHead = newReq;
+        } else {
+            disk->heldTail->next = newReq;
+        }
+        disk->heldTail = newReq;
+        return;
+    }
 
-    // call the queue helper
-    diskQueueHelper(unit, pid, daemonQMbox);
+    diskPlaceRequest(unit, newReq, where);
+}
 
-    // release the lock 
-    MboxRecv(daemonQMbox, NULL, 0);
+/**
+ * Puts a request that may be queued on the queue of its direction, or on
+ * the one holding the requests it has to follow. The caller holds the
+ * queue lock.
+ * 
+ * @param unit, int representing the disk unit
+ * @param req, diskRequest* representing the request to add
+ * @param where, diskQueue* representing the queue it has to follow
+ * requests in, NULL if none
+ */
+void diskPlaceRequest(int unit, diskRequest* req, diskQueue* where) {
+    diskUnit* disk = &diskUnits[unit];
+
+    // reads and writes wait apart, but one touching sectors that a request
+    // of the other kind is already waiting for on its track queues behind
+    // it, so neither sees the platter in the wrong state
+    int dir = req->op == USLOSS_DISK_READ ? DISK_DIR_READ : DISK_DIR_WRITE;
+    if (where != NULL) {
+        dir = where == &disk->queues[req->ioClass][DISK_DIR_READ] ? DISK_DIR_READ : DISK_DIR_WRITE;
+    }
+    req->dir = dir;
 
-    // wake up the disk daemon
-    MboxCondSend(daemonMbox, NULL, 0);
-    MboxRecv(diskRequestsTable[pid % MAXPROC].mboxID, NULL, 0);
+    // a read of sectors that are already on their way needs no slot, but
+    // CFQ keeps processes apart so it never looks at other processes
+    if (disk->sched != DISK_SCHED_CFQ && diskDedup(unit, req)) {
+        return;
+    }
 
-    return 0;
+    diskUnitPush(disk, req, 0);
+
+    int depth = diskQueueDepth(disk);
+    if (depth > disk->stats.peakQueueDepth) {
+        disk->stats.peakQueueDepth = depth;
+    }
 }
 
 /**
- * Adds a request to the disk request queue.
+ * Queues the held requests that no longer have to wait, oldest first. A
+ * held request stays behind any older held one it conflicts with. The
+ * caller holds the queue lock.
  * 
  * @param unit, int representing the disk unit
- * @param pid, int representing id of the current process to add
- * @param mboxToSend, int representing the mbox we will send the 
- * information to
- */
-void diskQueueHelper(int unit, int pid, int mboxToSend) {
-    diskRequest* diskReq = NULL;
-
-    // set the queue based on the disk we are working with
-    if (unit == 0) {
-        // if no requests, this is the only one
-        if (disk0Req == NULL) {
-            disk0Req = &diskRequestsTable[pid % MAXPROC];
-            return;
+ */
+void diskReleaseHeld(int unit) {
+    diskUnit* disk = &diskUnits[unit];
+    diskRequest* prev = NULL;
+    diskRequest* req = disk->heldHead;
+
+    while (req != NULL) {
+        diskRequest* next = req->next;
+        diskQueue* where = NULL;
+
+        if (diskFindConflicts(disk, req, req, &where) == DISK_CONFLICT_HOLD) {
+            prev = req;
+        } else {
+            if (prev == NULL) {
+                disk->heldHead = next;
+            } else {
+                prev->next = next;
+            }
+            if (disk->heldTail == req) {
+                disk->heldTail = prev;
+            }
+            req->next = NULL;
+            diskPlaceRequest(unit, req, where);
         }
-        diskReq = disk0Req;
-    } else {
-        // if no requests, this is the only one
-        if (disk1Req == NULL) {
-            disk1Req = &diskRequestsTable[pid % MAXPROC];
-            return;
+
+        req = next;
+    }
+}
+
+/**
+ * Tells if two requests touch a common sector and at least one of them
+ * writes it, so the order they run in matters.
+ * 
+ * @param a, diskRequest* representing one request
+ * @param b, diskRequest* representing the other
+ * 
+ * @return int 1 if they conflict, 0 otherwise
+ */
+int diskConflicts(diskRequest* a, diskRequest* b) {
+    if (a->op == USLOSS_DISK_READ && b->op == USLOSS_DISK_READ) {
+        return 0;
+    }
+
+    for (int s = 0; s < a->nsegs; s++) {
+        int lo = a->segs[s].track * USLOSS_DISK_TRACK_SIZE + a->segs[s].first;
+        if (diskOverlaps(b, lo, lo + a->segs[s].count)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Looks for everything a request has to come after: the request in
+ * service and its riders, the held requests older than it, and every
+ * waiting request in any class, direction or CFQ sub-queue that conflicts
+ * with it. A waiting request is keyed by its lowest track, so only the
+ * buckets up to the last track the request touches can hold one. The
+ * caller holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param req, diskRequest* representing the request
+ * @param stop, diskRequest* representing req itself if it is held, so only
+ * the held requests before it count, or NULL if it is new
+ * @param where, diskQueue** filled in with the queue of the conflicting
+ * requests when it returns DISK_CONFLICT_BUCKET
+ * 
+ * @return int DISK_CONFLICT_NONE, DISK_CONFLICT_BUCKET or
+ * DISK_CONFLICT_HOLD
+ */
+int diskFindConflicts(diskUnit* unit, diskRequest* req, diskRequest* stop, diskQueue** where) {
+    int hiTrack = req->track;
+    for (int s = 0; s < req->nsegs; s++) {
+        int last = (req->segs[s].track * USLOSS_DISK_TRACK_SIZE + req->segs[s].first + req->segs[s].count - 1) / USLOSS_DISK_TRACK_SIZE;
+        if (last > hiTrack) {
+            hiTrack = last;
         }
-        diskReq = disk1Req;
+    }
+    if (hiTrack >= DISK_MAXTRACKS) {
+        hiTrack = DISK_MAXTRACKS - 1;
     }
 
-    int currTrack = diskReq->track;
-    int savedTrack = diskRequestsTable[pid % MAXPROC].track;
+    for (diskRequest* r = unit->active; r != NULL; r = r->mergeNext) {
+        if (diskConflicts(req, r)) {
+            return DISK_CONFLICT_HOLD;
+        }
+    }
 
-    if (currTrack <= savedTrack) {
-        while (diskReq->next != NULL && diskReq->next->track <= savedTrack && diskReq->next->track >= currTrack) {
-            diskReq = diskReq->next;
+    for (diskRequest* r = unit->heldHead; r != stop; r = r->next) {
+        if (diskConflicts(req, r)) {
+            return DISK_CONFLICT_HOLD;
         }
-        diskRequestsTable[pid % MAXPROC].next = diskReq->next;
-        diskReq->next = &diskRequestsTable[pid % MAXPROC];
-        return;
-    } else {
-        while (diskReq->next != NULL && diskReq->next->track >= currTrack) {
-            diskReq = diskReq->next;
+    }
+
+    for (int c = 0; c < DISK_NCLASSES; c++) {
+        for (int slot = 0; slot < MAXPROC; slot++) {
+            if (!unit->cfq[c][slot].active) {
+                continue;
+            }
+            for (diskRequest* r = unit->cfq[c][slot].head; r != NULL && r->track <= hiTrack; r = r->next) {
+                if (diskConflicts(req, r)) {
+                    return DISK_CONFLICT_HOLD;
+                }
+            }
         }
+    }
 
-        if (diskReq->next == NULL) {
-            diskReq->next = &diskRequestsTable[pid % MAXPROC];
-            return;
-        } else {
-            while (diskReq->next != NULL && diskReq->next->track <= savedTrack) {
-                diskReq = diskReq->next;
+    *where = NULL;
+    for (int c = 0; c < DISK_NCLASSES; c++) {
+        for (int d = 0; d < 2; d++) {
+            diskQueue* queue = &unit->queues[c][d];
+
+            for (int track = diskQueueNextTrack(queue, 0); track >= 0 && track <= hiTrack;
+                 track = diskQueueNextTrack(queue, track + 1)) {
+                for (diskRequest* r = queue->head[track]; r != NULL; r = r->next) {
+                    if (!diskConflicts(req, r)) {
+                        continue;
+                    }
+
+                    // behind it in the same bucket is still arrival order,
+                    // as long as that is where req goes
+                    int sameBucket = track == req->track && c == req->ioClass && unit->sched != DISK_SCHED_CFQ;
+                    if (!sameBucket || (*where != NULL && *where != queue)) {
+                        return DISK_CONFLICT_HOLD;
+                    }
+                    *where = queue;
+                }
             }
-            diskRequestsTable[pid % MAXPROC].next = diskReq->next;
-            diskReq->next = &diskRequestsTable[pid % MAXPROC];
-            return;
         }
     }
+
+    return *where == NULL ? DISK_CONFLICT_NONE : DISK_CONFLICT_BUCKET;
 }
 
 /**
@@ -857,34 +1650,1859 @@ void diskQueueHelper(int unit, int pid, int mboxToSend) {
  * @return int 0 if the opertaion was sucessful
  */
 int diskWrite(int unit, int track, int first, int sectors, void* buffer) {
-    int pid = getpid();
+    int status;
 
-    int daemonQMbox = -1;
-    int daemonMbox = -1; 
+    // a write the journal takes is never queued, so the cache hears of it here
+    diskSegment seg = { track, first, sectors, buffer };
+    cacheInvalidate(unit, &seg, 1);
 
-    if (unit == 0) {
-        daemonQMbox = disk0Q;
-        daemonMbox = disk0;
-    } else {
-        daemonQMbox = disk1Q;
-        daemonMbox = disk1;
+    // small writes to a disk with a journal are committed in batches
+    if (journalWrite(unit, track, first, sectors, buffer, &status) == 0) {
+        return status;
+    }
+
+    diskRequest* req = diskSubmit(unit, track, first, sectors, buffer, USLOSS_DISK_WRITE, 0);
+
+    // every request slot is taken by async requests
+    if (req == NULL) {
+        return -1;
+    }
+
+    return diskReap(req);
+}
+
+/**
+ * Takes a request slot off the free list.
+ * 
+ * @return diskRequest* the slot, or NULL if all of them are in flight
+ */
+diskRequest* diskAllocRequest(void) {
+    MboxSend(diskTableMutex, NULL, 0);
+
+    diskRequest* req = diskFreeRequests;
+    if (req != NULL) {
+        diskFreeRequests = req->next;
+        req->next = NULL;
+    }
+
+    MboxRecv(diskTableMutex, NULL, 0);
+    return req;
+}
+
+/**
+ * Puts a request slot back on the free list. Bumping the generation makes
+ * every handle that still points at this slot invalid; it wraps before the
+ * handles it goes into could overflow.
+ * 
+ * @param req, diskRequest* representing the slot to release
+ */
+void diskFreeRequest(diskRequest* req) {
+    MboxSend(diskTableMutex, NULL, 0);
+
+    cleanDiskEntry(req - diskRequestsTable);
+    req->gen = (req->gen + 1) & DISK_GEN_MASK;
+    req->next = diskFreeRequests;
+    diskFreeRequests = req;
+
+    MboxRecv(diskTableMutex, NULL, 0);
+}
+
+/**
+ * Finds the async bookkeeping slot of a process. If the slot still belongs
+ * to a process that already exited, its unreaped completions are dropped.
+ * The caller must hold diskProcMutex.
+ * 
+ * @param pid, int representing the process id
+ * 
+ * @return diskProc* the slot of the process
+ */
+diskProc* getDiskProc(int pid) {
+    diskProc* proc = &diskProcTable[pid % MAXPROC];
+
+    if (proc->pid != pid) {
+        while (proc->done != NULL) {
+            diskRequest* req = proc->done;
+            proc->done = req->doneNext;
+            MboxRecv(req->mboxID, NULL, 0);
+            diskFreeRequest(req);
+        }
+        proc->pid = pid;
+        proc->pending = 0;
+        proc->waitingAny = 0;
+        proc->ioClass = DISK_CLASS_BE;
+        proc->diskTime = 0;
+        proc->lastDone = -1;
+        proc->thinkTime = 0;
+        proc->thinkSamples = 0;
+    }
+
+    return proc;
+}
+
+/**
+ * Fills in a request slot and hands it to the daemon of the given unit.
+ * 
+ * @param unit, int representing the disk unit
+ * @param track, int representing the first track
+ * @param first, int representing the first sector on that track
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the buffer to read into/write from
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * @param async, int representing if the caller reaps it with DiskWait
+ * 
+ * @return diskRequest* the queued request, or NULL if no slot was free
+ */
+diskRequest* diskSubmit(int unit, int track, int first, int sectors, void* buffer, int op, int async) {
+    diskSegment seg;
+
+    seg.track = track;
+    seg.first = first;
+    seg.count = sectors;
+    seg.buffer = buffer;
+
+    return diskSubmitV(unit, &seg, 1, op, async);
+}
+
+/**
+ * Fills in a request slot with a list of segments and hands it to the
+ * daemon of the given unit. The segments are copied, so the caller's
+ * array may go away once this returns. If the disk has a journal that
+ * holds some of the sectors, it is checkpointed first.
+ * 
+ * @param unit, int representing the disk unit
+ * @param segs, diskSegment* representing the segments to transfer
+ * @param nsegs, int representing the number of segments
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * @param async, int representing if the caller reaps it with DiskWait
+ * 
+ * @return diskRequest* the queued request, or NULL if no slot was free
+ */
+diskRequest* diskSubmitV(int unit, diskSegment* segs, int nsegs, int op, int async) {
+    journalSyncOverlap(unit, segs, nsegs);
+    return diskQueueSegs(unit, segs, nsegs, op, async, diskUserTracks(unit));
+}
+
+/**
+ * Queues a request for the journal of a disk, which may use the tracks
+ * it hides from everyone else.
+ * 
+ * @param unit, int representing the disk unit
+ * @param track, int representing the first track
+ * @param first, int representing the first sector
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the buffer
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * 
+ * @return diskRequest* the queued request, or NULL if no slot was free
+ */
+diskRequest* diskSubmitRaw(int unit, int track, int first, int sectors, void* buffer, int op) {
+    diskSegment seg = { track, first, sectors, buffer };
+    return diskSubmitRawV(unit, &seg, 1, op);
+}
+
+/**
+ * Queues a list of segments for a store that keeps tracks of a disk for
+ * itself, which may use them.
+ * 
+ * @param unit, int representing the disk unit
+ * @param segs, diskSegment* representing the segments to transfer
+ * @param nsegs, int representing the number of segments
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * 
+ * @return diskRequest* the queued request, or NULL if no slot was free
+ */
+diskRequest* diskSubmitRawV(int unit, diskSegment* segs, int nsegs, int op) {
+    return diskQueueSegs(unit, segs, nsegs, op, 0, diskGetTracks(unit));
+}
+
+/**
+ * Does the work of diskSubmitV. An empty segment, or one starting before
+ * the disk or ending past its first numTracks tracks, fails the request,
+ * so nobody reaches the tracks a journal, a cache list or a store keeps
+ * for itself.
+ * 
+ * @param unit, int representing the disk unit
+ * @param segs, diskSegment* representing the segments to transfer
+ * @param nsegs, int representing the number of segments
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * @param async, int representing if the caller reaps it with DiskWait
+ * @param numTracks, int representing the tracks the caller may use
+ * 
+ * @return diskRequest* the queued request, or NULL if no slot was free
+ */
+diskRequest* diskQueueSegs(int unit, diskSegment* segs, int nsegs, int op, int async, int numTracks) {
+    int daemonQMbox = diskUnits[unit].queueMutex;
+    int daemonMbox = diskUnits[unit].wakeMbox;
+
+    diskRequest* req = diskAllocRequest();
+    if (req == NULL) {
+        return NULL;
+    }
+
+    req->pid = getpid();
+    req->track = segs[0].track;
+    for (int i = 0; i < nsegs; i++) {
+        req->segs[i] = segs[i];
+        if (segs[i].track < req->track) {
+            req->track = segs[i].track;
+        }
+    }
+    req->nsegs = nsegs;
+    req->op = op;
+    req->status = 0;
+    req->async = async;
+    req->queuedAt = currentTime();
+    req->startedAt = -1;
+
+    MboxSend(diskProcMutex, NULL, 0);
+    diskProc* proc = getDiskProc(req->pid);
+    req->ioClass = proc->ioClass;
+    if (async) {
+        proc->pending++;
+    } else if (op == USLOSS_DISK_READ && proc->lastDone >= 0) {
+        // how long the process thought since its last read came back
+        int think = req->queuedAt - proc->lastDone;
+        proc->thinkTime = proc->thinkSamples == 0 ? think : (7 * proc->thinkTime + think) / 8;
+        proc->thinkSamples++;
+    }
+    MboxRecv(diskProcMutex, NULL, 0);
+
+    // a sector off either end of the disk is attempted, and fails right away
+    for (int i = 0; i < nsegs; i++) {
+        long end = (long) segs[i].track * USLOSS_DISK_TRACK_SIZE + segs[i].first + segs[i].count;
+        if (segs[i].track < 0 || segs[i].first < 0 || segs[i].count <= 0 ||
+            segs[i].track >= numTracks || end > (long) numTracks * USLOSS_DISK_TRACK_SIZE) {
+            req->status = USLOSS_DEV_ERROR;
+            diskFinishRequest(req);
+            return req;
+        }
     }
 
-    diskRequestsTable[pid % MAXPROC].pid = pid;
-    diskRequestsTable[pid % MAXPROC].track = track;
-    diskRequestsTable[pid % MAXPROC].first = first;
-    diskRequestsTable[pid % MAXPROC].sector = sectors;
-    diskRequestsTable[pid % MAXPROC].buffer = buffer;
-    diskRequestsTable[pid % MAXPROC].op = USLOSS_DISK_WRITE;
+    if (op == USLOSS_DISK_WRITE) {
+        cacheInvalidate(unit, segs, nsegs);
+    }
 
+    // acquire the lock since we want to add ourselves to the queue
     MboxSend(daemonQMbox, NULL, 0);
 
-    diskQueueHelper(unit, pid, daemonQMbox);
+    diskQueueHelper(unit, req);
 
+    // release the lock 
     MboxRecv(daemonQMbox, NULL, 0);
 
+    // wake up the disk daemon
     MboxCondSend(daemonMbox, NULL, 0);
-    MboxRecv(diskRequestsTable[pid % MAXPROC].mboxID, NULL, 0);
 
-    return 0;
-}
\ No newline at end of file
+    return req;
+}
+
+/**
+ * Blocks until a request is done, then releases its slot.
+ * 
+ * @param req, diskRequest* representing the request to wait for
+ * 
+ * @return int the completion status of the request
+ */
+int diskReap(diskRequest* req) {
+    MboxRecv(req->mboxID, NULL, 0);
+
+    int status = req->status;
+    diskFreeRequest(req);
+
+    return status;
+}
+
+/**
+ * Called by the daemon once a request has been serviced. Requests that
+ * shared its device work are completed along with it. Async requests
+ * are also put on the done list of their owner, so DiskWaitAny can find
+ * them.
+ * 
+ * @param req, diskRequest* representing the finished request
+ */
+void diskFinishRequest(diskRequest* req) {
+    // hand the result to every request that shared this one's device work
+    while (req->shareNext != NULL) {
+        diskRequest* sharer = req->shareNext;
+        req->shareNext = sharer->shareNext;
+        sharer->shareNext = NULL;
+
+        if (req->op == USLOSS_DISK_READ) {
+            int offset = (sharer->segs[0].track - req->segs[0].track) * USLOSS_DISK_TRACK_SIZE +
+                         sharer->segs[0].first - req->segs[0].first;
+            memcpy(sharer->segs[0].buffer, req->segs[0].buffer + offset * USLOSS_DISK_SECTOR_SIZE,
+                   sharer->segs[0].count * USLOSS_DISK_SECTOR_SIZE);
+        }
+        sharer->status = req->status;
+        diskFinishRequest(sharer);
+    }
+
+    if (req->async) {
+        MboxSend(diskProcMutex, NULL, 0);
+
+        diskProc* proc = &diskProcTable[req->pid % MAXPROC];
+
+        // the owner exited and its slot was reused, nobody will reap this
+        if (proc->pid != req->pid) {
+            MboxRecv(diskProcMutex, NULL, 0);
+            diskFreeRequest(req);
+            return;
+        }
+
+        // append, so DiskWaitAny hands completions back in order
+        diskRequest** tail = &proc->done;
+        while (*tail != NULL) {
+            tail = &(*tail)->doneNext;
+        }
+        req->doneNext = NULL;
+        *tail = req;
+
+        if (proc->waitingAny) {
+            proc->waitingAny = 0;
+            MboxCondSend(proc->wakeMbox, NULL, 0);
+        }
+
+        MboxRecv(diskProcMutex, NULL, 0);
+    }
+
+    MboxSend(req->mboxID, NULL, 0);
+}
+
+/**
+ * Shared body of the async read and write syscalls.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ */
+void diskAsyncHelper(sysArgs* args, int op) {
+    void* buffer = args->arg1;
+    int sectors = (int)(long)args->arg2;
+    int track = (int)(long)args->arg3;
+    int first = (int)(long)args->arg4;
+    int unit = (int)(long)args->arg5;
+
+    if (buffer == NULL || sectors <= 0 || diskCheckArgs(unit, track, first) < 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    diskRequest* req = diskSubmit(unit, track, first, sectors, buffer, op, 1);
+    if (req == NULL) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    // the handle encodes the generation, so it dies with the slot
+    int slot = req - diskRequestsTable;
+    args->arg1 = (void*)(long)(req->gen * MAXDISKREQS + slot);
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Waits for an async request of the current process and reaps it.
+ * 
+ * @param handle, int representing the request, or -1 for any of them
+ * @param *reaped, int pointer set to the handle that completed
+ * @param *status, int pointer set to the completion status
+ * 
+ * @return int 0 on success, -1 on a bad handle or nothing to wait for
+ */
+int diskWaitHelper(int handle, int* reaped, int* status) {
+    int pid = getpid();
+    diskRequest* req = NULL;
+
+    MboxSend(diskProcMutex, NULL, 0);
+    diskProc* proc = getDiskProc(pid);
+
+    if (handle < 0) {
+        // wait for whichever request finishes first
+        while (proc->done == NULL) {
+            if (proc->pending == 0) {
+                MboxRecv(diskProcMutex, NULL, 0);
+                return -1;
+            }
+            proc->waitingAny = 1;
+            MboxRecv(diskProcMutex, NULL, 0);
+            MboxRecv(proc->wakeMbox, NULL, 0);
+            MboxSend(diskProcMutex, NULL, 0);
+        }
+        req = proc->done;
+        proc->done = req->doneNext;
+        req->doneNext = NULL;
+        MboxRecv(diskProcMutex, NULL, 0);
+
+        // the daemon may still be about to post its completion token
+        MboxRecv(req->mboxID, NULL, 0);
+    } else {
+        int slot = handle % MAXDISKREQS;
+        req = &diskRequestsTable[slot];
+        if (req->gen != handle / MAXDISKREQS || req->pid != pid || !req->async) {
+            MboxRecv(diskProcMutex, NULL, 0);
+            return -1;
+        }
+        MboxRecv(diskProcMutex, NULL, 0);
+
+        // block until the daemon is done with it
+        MboxRecv(req->mboxID, NULL, 0);
+
+        // it is on the done list now, take it off
+        MboxSend(diskProcMutex, NULL, 0);
+        diskRequest** link = &proc->done;
+        while (*link != NULL && *link != req) {
+            link = &(*link)->doneNext;
+        }
+        if (*link == req) {
+            *link = req->doneNext;
+        }
+        req->doneNext = NULL;
+        MboxRecv(diskProcMutex, NULL, 0);
+    }
+
+    MboxSend(diskProcMutex, NULL, 0);
+    proc->pending--;
+    MboxRecv(diskProcMutex, NULL, 0);
+
+    *reaped = req->gen * MAXDISKREQS + (int)(req - diskRequestsTable);
+    *status = req->status;
+    diskFreeRequest(req);
+    return 0;
+}
+
+/**
+ * Shared body of the vectored read and write syscalls.
+ * 
+ * @param *args, USLOSS System args to receive and return 
+ * params
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ */
+void diskVectorHelper(sysArgs* args, int op) {
+    diskSegment* segs = (diskSegment*)args->arg1;
+    int nsegs = (int)(long)args->arg2;
+    int unit = (int)(long)args->arg3;
+
+    if (segs == NULL || nsegs <= 0 || nsegs > DISK_MAXSEGS || unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    for (int i = 0; i < nsegs; i++) {
+        if (segs[i].buffer == NULL || segs[i].count <= 0 ||
+            diskCheckArgs(unit, segs[i].track, segs[i].first) < 0) {
+            args->arg4 = (void*)(long)-1;
+            return;
+        }
+    }
+
+    diskRequest* req = diskSubmitV(unit, segs, nsegs, op, 0);
+    if (req == NULL) {
+        args->arg1 = (void*)(long)-1;
+        args->arg4 = (void*)(long)0;
+        return;
+    }
+
+    args->arg1 = (void*)(long)diskReap(req);
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Adds a single sector read or write on the track the arm will be on to
+ * the unit's chain. If it fails, every request chained from req through
+ * mergeNext that covers the sector gets USLOSS_DEV_ERROR. Only called by
+ * the unit's daemon, which owns the device.
+ * 
+ * @param unit, int representing the disk unit
+ * @param req, diskRequest* representing the request(s) to blame
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * @param track, int representing the track the arm will be on
+ * @param sector, int representing the sector on that track
+ * @param buffer, void* representing the sector sized buffer
+ */
+void diskChainSector(int unit, diskRequest* req, int op, int track, int sector, void* buffer) {
+    diskUnit* disk = &diskUnits[unit];
+
+    // chain is full, get it done before adding more
+    if (disk->nsteps == DISK_MAXSTEPS) {
+        diskChainRun(unit);
+    }
+
+    diskStep* step = &disk->steps[disk->nsteps++];
+    step->request.opr = op;
+    step->request.reg1 = (void*)(long)sector;
+    step->request.reg2 = buffer;
+    step->req = req;
+    step->abs = track * USLOSS_DISK_TRACK_SIZE + sector;
+    step->status = 0;
+}
+
+/**
+ * Runs the unit's chain. The first step is sent from here, every other
+ * one from the interrupt of the step before it, so the daemon wakes up
+ * once per chain instead of once per sector. Failed sectors are then
+ * blamed on the requests that wanted them.
+ * 
+ * @param unit, int representing the disk unit
+ */
+void diskChainRun(int unit) {
+    diskUnit* disk = &diskUnits[unit];
+    int status;
+
+    if (disk->nsteps == 0) {
+        return;
+    }
+
+    disk->curStep = 0;
+    USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, &disk->steps[0].request);
+    waitDevice(USLOSS_DISK_DEV, unit, &status);
+
+    for (int i = 0; i < disk->nsteps; i++) {
+        diskStep* step = &disk->steps[i];
+        if (step->request.opr == USLOSS_DISK_READ) {
+            disk->stats.sectorsRead++;
+        } else if (step->request.opr == USLOSS_DISK_WRITE) {
+            disk->stats.sectorsWritten++;
+        }
+
+        if (step->status != USLOSS_DEV_ERROR) {
+            continue;
+        }
+        for (diskRequest* r = step->req; r != NULL; r = r->mergeNext) {
+            if (diskOverlaps(r, step->abs, step->abs + 1)) {
+                r->status = USLOSS_DEV_ERROR;
+            }
+        }
+    }
+
+    disk->nsteps = 0;
+    disk->curStep = -1;
+}
+
+/**
+ * Disk interrupt handler, installed over the phase2 one. While a chain is
+ * running it records the status of the step that just finished and sends
+ * the next one straight to the device; only the interrupt for the last
+ * step goes on to phase2, which wakes the daemon. Anything else, like the
+ * geometry probe, goes to phase2 untouched.
+ * 
+ * @param dev, int representing the device type
+ * @param arg, void* representing the unit
+ */
+void diskIntHandler(int dev, void* arg) {
+    int unit = (int)(long)arg;
+    diskUnit* disk = &diskUnits[unit];
+
+    if (disk->curStep >= 0 && disk->curStep < disk->nsteps) {
+        int status;
+        USLOSS_DeviceInput(dev, unit, &status);
+        disk->steps[disk->curStep].status = status;
+
+        disk->curStep++;
+        if (disk->curStep < disk->nsteps) {
+            USLOSS_DeviceOutput(dev, unit, &disk->steps[disk->curStep].request);
+            return;
+        }
+    }
+
+    phase2DiskHandler(dev, arg);
+}
+
+/**
+ * Tells if any segment of a request overlaps the absolute sector range
+ * [lo, hi), where absolute means track * USLOSS_DISK_TRACK_SIZE + sector.
+ * 
+ * @param req, diskRequest* representing the request to check
+ * @param lo, int representing the first absolute sector
+ * @param hi, int representing one past the last absolute sector
+ * 
+ * @return int 1 if they overlap, 0 otherwise
+ */
+int diskOverlaps(diskRequest* req, int lo, int hi) {
+    for (int i = 0; i < req->nsegs; i++) {
+        int start = req->segs[i].track * USLOSS_DISK_TRACK_SIZE + req->segs[i].first;
+        if (start < hi && start + req->segs[i].count > lo) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Walks the requests waiting behind the head on the same track and
+ * chains onto head->mergeNext the ones that can share its device pass:
+ * single segment requests of the same kind whose sectors touch or overlap
+ * the running range without leaving the track. Same track requests are
+ * queued in arrival order, so only the unbroken run at the front of the
+ * track is taken; anything past a request that does not qualify could be
+ * ordered after it. The caller holds the queue lock.
+ * 
+ * @param queue, diskQueue* representing the queue head was taken from
+ * @param head, diskRequest* representing the request about to be serviced
+ * 
+ * @return int the number of requests merged into head
+ */
+int diskGatherMerges(diskQueue* queue, diskRequest* head) {
+    if (head->nsegs != 1) {
+        return 0;
+    }
+
+    int lo = head->segs[0].track * USLOSS_DISK_TRACK_SIZE + head->segs[0].first;
+    int hi = lo + head->segs[0].count;
+    int trackEnd = (head->track + 1) * USLOSS_DISK_TRACK_SIZE;
+
+    // a pass never leaves its track, longer requests go in chunks
+    if (hi > trackEnd) {
+        return 0;
+    }
+    int merged = 0;
+
+    diskRequest** tail = &head->mergeNext;
+    diskRequest* cand = queue->head[head->track];
+
+    while (cand != NULL && cand->op == head->op && cand->nsegs == 1) {
+        int candLo = cand->segs[0].track * USLOSS_DISK_TRACK_SIZE + cand->segs[0].first;
+        int candHi = candLo + cand->segs[0].count;
+
+        // a gap between the two means separate passes
+        if (candLo > hi || candHi < lo || candHi > trackEnd) {
+            break;
+        }
+
+        // unlink it from the queue, it is serviced with the head
+        diskQueueUnlink(queue, NULL, cand);
+        *tail = cand;
+        tail = &cand->mergeNext;
+
+        if (candLo < lo) lo = candLo;
+        if (candHi > hi) hi = candHi;
+        merged++;
+
+        cand = queue->head[head->track];
+    }
+
+    return merged;
+}
+
+/**
+ * Services the part of a request that lies on its lowest track, then
+ * trims those sectors off its segments so that what is left starts on a
+ * later track, with the queue key moved along to match. A request that
+ * spans many tracks is thus done one track per trip through the queue,
+ * and small requests queued behind it are not stuck waiting for all of
+ * it.
+ * 
+ * @param unit, int representing the disk unit
+ * @param req, diskRequest* representing the request
+ * @param *curTrack, int pointer to the track the head is on
+ * 
+ * @return int 1 if the whole request is done, 0 if some is left
+ */
+int diskServiceChunk(int unit, diskRequest* req, int* curTrack) {
+    diskSegment left[DISK_MAXSEGS];
+    int nleft = 0;
+    int track = req->track;
+
+    diskChainSeek(unit, track);
+    *curTrack = track;
+
+    // each pass does one track of the request, counted before it is
+    // trimmed off
+    diskUnits[unit].heat[track]++;
+
+    for (int s = 0; s < req->nsegs; s++) {
+        diskSegment seg = req->segs[s];
+
+        if (seg.track == track) {
+            // the sectors up to the end of this track
+            int count = USLOSS_DISK_TRACK_SIZE - seg.first;
+            if (count > seg.count) {
+                count = seg.count;
+            }
+
+            for (int i = 0; i < count; i++) {
+                diskChainSector(unit, req, req->op, track, seg.first + i, seg.buffer + i * USLOSS_DISK_SECTOR_SIZE);
+            }
+
+            // what is left wraps onto the start of the next track
+            seg.track++;
+            seg.first = 0;
+            seg.count -= count;
+            seg.buffer += count * USLOSS_DISK_SECTOR_SIZE;
+
+            if (seg.count == 0) {
+                continue;
+            }
+
+            // ran off the end of the disk
+            if (seg.track >= diskUnits[unit].numTracks) {
+                req->status = USLOSS_DEV_ERROR;
+                continue;
+            }
+        }
+
+        left[nleft++] = seg;
+    }
+
+    // errors are matched against the segments, so trim them afterwards
+    diskChainRun(unit);
+
+    req->nsegs = nleft;
+    for (int s = 0; s < nleft; s++) {
+        req->segs[s] = left[s];
+        if (s == 0 || left[s].track < req->track) {
+            req->track = left[s].track;
+        }
+    }
+
+    return nleft == 0;
+}
+
+/**
+ * Picks whose buffer talks to the device for one sector of a merged pass:
+ * the oldest request covering it on a read, the newest on a write.
+ * 
+ * @param head, diskRequest* representing the head of the merged chain
+ * @param abs, int representing the absolute sector
+ * @param data, void** filled in with the owner's buffer for that sector
+ * 
+ * @return diskRequest* the owner
+ */
+diskRequest* diskSectorOwner(diskRequest* head, int abs, void** data) {
+    diskRequest* owner = NULL;
+    for (diskRequest* r = head; r != NULL; r = r->mergeNext) {
+        if (diskOverlaps(r, abs, abs + 1) && (owner == NULL || head->op == USLOSS_DISK_WRITE)) {
+            owner = r;
+        }
+    }
+
+    int ownerStart = owner->segs[0].track * USLOSS_DISK_TRACK_SIZE + owner->segs[0].first;
+    *data = owner->segs[0].buffer + (abs - ownerStart) * USLOSS_DISK_SECTOR_SIZE;
+    return owner;
+}
+
+/**
+ * Services a head request together with the requests merged into it, in
+ * one sweep over the union of their sectors. A read sector lands in the
+ * oldest request covering it and is copied to the others; a written
+ * sector takes the data of the newest request covering it, which is what
+ * the platter would hold had they run one after the other.
+ * 
+ * @param unit, int representing the disk unit
+ * @param head, diskRequest* representing the head of the merged chain
+ * @param *curTrack, int pointer to the track the head is on
+ */
+void diskServiceMerged(int unit, diskRequest* head, int* curTrack) {
+    int lo = head->segs[0].track * USLOSS_DISK_TRACK_SIZE + head->segs[0].first;
+    int hi = lo + head->segs[0].count;
+
+    for (diskRequest* r = head->mergeNext; r != NULL; r = r->mergeNext) {
+        int start = r->segs[0].track * USLOSS_DISK_TRACK_SIZE + r->segs[0].first;
+        if (start < lo) lo = start;
+        if (start + r->segs[0].count > hi) hi = start + r->segs[0].count;
+    }
+
+    int end = hi;
+    for (int abs = lo; abs < hi; abs++) {
+        int track = abs / USLOSS_DISK_TRACK_SIZE;
+        int sector = abs % USLOSS_DISK_TRACK_SIZE;
+
+        // ran off the end of the disk, fail everyone still wanting more
+        if (track >= diskUnits[unit].numTracks) {
+            for (diskRequest* r = head; r != NULL; r = r->mergeNext) {
+                if (diskOverlaps(r, abs, hi)) {
+                    r->status = USLOSS_DEV_ERROR;
+                }
+            }
+            end = abs;
+            break;
+        }
+
+        if (abs == lo || sector == 0) {
+            diskChainSeek(unit, track);
+            *curTrack = track;
+
+            // every request of the sweep with sectors on this track
+            int trackEnd = (track + 1) * USLOSS_DISK_TRACK_SIZE;
+            for (diskRequest* r = head; r != NULL; r = r->mergeNext) {
+                if (diskOverlaps(r, abs, trackEnd < hi ? trackEnd : hi)) {
+                    diskUnits[unit].heat[track]++;
+                }
+            }
+        }
+
+        void* data;
+        diskSectorOwner(head, abs, &data);
+        diskChainSector(unit, head, head->op, track, sector, data);
+    }
+
+    diskChainRun(unit);
+
+    if (head->op != USLOSS_DISK_READ) {
+        return;
+    }
+
+    // hand every other reader a copy of what landed in the owner's buffer
+    for (int abs = lo; abs < end; abs++) {
+        void* data;
+        diskRequest* owner = diskSectorOwner(head, abs, &data);
+
+        for (diskRequest* r = head; r != NULL; r = r->mergeNext) {
+            if (r != owner && diskOverlaps(r, abs, abs + 1)) {
+                int start = r->segs[0].track * USLOSS_DISK_TRACK_SIZE + r->segs[0].first;
+                memcpy(r->segs[0].buffer + (abs - start) * USLOSS_DISK_SECTOR_SIZE, data, USLOSS_DISK_SECTOR_SIZE);
+            }
+        }
+    }
+}
+
+/**
+ * Tells how many queued requests were merged into another request's
+ * device pass on the given unit.
+ * 
+ * @param unit, int representing the disk unit
+ * 
+ * @return int the number of merges so far
+ */
+int getDiskMerges(int unit) {
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        return -1;
+    }
+    return diskUnits[unit].stats.merged;
+}
+
+/**
+ * Checks a new single segment request against the requests still waiting
+ * on the same track, and looks at the latest one overlapping it, since
+ * each track is serviced in arrival order.
+ * 
+ * A read covered by a pending read shares that read: it is chained onto
+ * it and gets a copy of the data, without going to the device. A write
+ * covering a pending write absorbs it: the older write is taken off the
+ * queue and completes when the new one hits the platter. Nothing queued
+ * behind the older request overlaps it, so nobody can tell the
+ * difference. The caller holds the queue lock.
+ * 
+ * @param unit, int representing the disk unit
+ * @param req, diskRequest* representing the new request
+ * 
+ * @return int 1 if req was attached to a pending read and must not be
+ * queued, 0 otherwise
+ */
+int diskDedup(int unit, diskRequest* req) {
+    diskQueue* queue = &diskUnits[unit].queues[req->ioClass][req->dir];
+
+    if (req->nsegs != 1) {
+        return 0;
+    }
+
+    int lo = req->segs[0].track * USLOSS_DISK_TRACK_SIZE + req->segs[0].first;
+    int hi = lo + req->segs[0].count;
+
+    while (1) {
+        // requests in service are off the queue, so all of these wait
+        diskRequest* last = NULL;
+        diskRequest* lastPrev = NULL;
+        diskRequest* prev = NULL;
+        for (diskRequest* r = queue->head[req->track]; r != NULL; r = r->next) {
+            if (diskOverlaps(r, lo, hi)) {
+                last = r;
+                lastPrev = prev;
+            }
+            prev = r;
+        }
+
+        if (last == NULL || last->nsegs != 1 || last->op != req->op) {
+            return 0;
+        }
+
+        int lastLo = last->segs[0].track * USLOSS_DISK_TRACK_SIZE + last->segs[0].first;
+        int lastHi = lastLo + last->segs[0].count;
+
+        if (req->op == USLOSS_DISK_READ) {
+            if (lastLo > lo || lastHi < hi) {
+                return 0;
+            }
+
+            diskRequest** tail = &last->shareNext;
+            while (*tail != NULL) {
+                tail = &(*tail)->shareNext;
+            }
+            *tail = req;
+
+            diskUnits[unit].stats.sharedReads++;
+            return 1;
+        }
+
+        if (lo > lastLo || hi < lastHi) {
+            return 0;
+        }
+
+        // the older write is superseded, it rides on the new one
+        diskQueueUnlink(queue, lastPrev, last);
+
+        diskRequest** tail = &req->shareNext;
+        while (*tail != NULL) {
+            tail = &(*tail)->shareNext;
+        }
+        *tail = last;
+
+        diskUnits[unit].stats.absorbedWrites++;
+    }
+}
+
+/**
+ * Tells how many reads were served from another pending read of the same
+ * sectors on the given unit.
+ * 
+ * @param unit, int representing the disk unit
+ * 
+ * @return int the number of shared reads so far
+ */
+int getDiskSharedReads(int unit) {
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        return -1;
+    }
+    return diskUnits[unit].stats.sharedReads;
+}
+
+/**
+ * Tells how many pending writes were superseded by a newer write of the
+ * same sectors on the given unit, and never reached the platter.
+ * 
+ * @param unit, int representing the disk unit
+ * 
+ * @return int the number of absorbed writes so far
+ */
+int getDiskAbsorbedWrites(int unit) {
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        return -1;
+    }
+    return diskUnits[unit].stats.absorbedWrites;
+}
+
+/**
+ * Counts a request the device is done with in the stats of its unit.
+ * Only called by the unit's daemon.
+ * 
+ * @param unit, int representing the disk unit
+ * @param req, diskRequest* representing the request
+ * @param finished, int representing when its last pass came back
+ */
+void diskAccount(int unit, diskRequest* req, int finished) {
+    diskStats* stats = &diskUnits[unit].stats;
+
+    if (req->op == USLOSS_DISK_READ) {
+        stats->reads++;
+    } else {
+        stats->writes++;
+    }
+
+    diskHistAdd(stats->waitHist, req->startedAt - req->queuedAt);
+    diskHistAdd(stats->serviceHist, finished - req->startedAt);
+
+    if (req->op == USLOSS_DISK_READ) {
+        diskHistAdd(stats->readHist, finished - req->queuedAt);
+    } else {
+        diskHistAdd(stats->writeHist, finished - req->queuedAt);
+    }
+}
+
+/**
+ * Adds a time to a log2 histogram.
+ * 
+ * @param hist, int* representing the DISK_HISTBUCKETS buckets
+ * @param us, int representing the time in microseconds
+ */
+void diskHistAdd(int* hist, int us) {
+    int bucket = 0;
+    while (us > 1 && bucket < DISK_HISTBUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    hist[bucket]++;
+}
+
+/**
+ * Finds the bucket a percentile of a log2 histogram falls in.
+ * 
+ * @param hist, int* representing the DISK_HISTBUCKETS buckets
+ * @param pct, int representing the percentile, 1 to 100
+ * 
+ * @return int the upper bound of that bucket in microseconds, 0 if the
+ * histogram is empty
+ */
+int diskHistPercentile(int* hist, int pct) {
+    int total = 0;
+    for (int b = 0; b < DISK_HISTBUCKETS; b++) {
+        total += hist[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // smallest bucket with at least pct percent of the samples up to it
+    int seen = 0;
+    for (int b = 0; b < DISK_HISTBUCKETS; b++) {
+        seen += hist[b];
+        if (seen * 100 >= total * pct) {
+            return 1 << (b + 1);
+        }
+    }
+    return 1 << DISK_HISTBUCKETS;
+}
+
+/**
+ * Takes a consistent copy of the stats of a unit, with the current queue
+ * depth and the percentiles filled in.
+ * 
+ * @param unit, int representing the disk unit
+ * @param out, diskStats* representing where to copy them
+ */
+void diskStatsSnapshot(int unit, diskStats* out) {
+    MboxSend(diskUnits[unit].queueMutex, NULL, 0);
+    *out = diskUnits[unit].stats;
+    out->queueDepth = diskQueueDepth(&diskUnits[unit]);
+    MboxRecv(diskUnits[unit].queueMutex, NULL, 0);
+    journalStats(unit, out);
+    cacheStats(unit, out);
+
+    out->waitP50 = diskHistPercentile(out->waitHist, 50);
+    out->waitP99 = diskHistPercentile(out->waitHist, 99);
+    out->serviceP50 = diskHistPercentile(out->serviceHist, 50);
+    out->serviceP99 = diskHistPercentile(out->serviceHist, 99);
+    out->readP50 = diskHistPercentile(out->readHist, 50);
+    out->readP99 = diskHistPercentile(out->readHist, 99);
+    out->writeP50 = diskHistPercentile(out->writeHist, 50);
+    out->writeP99 = diskHistPercentile(out->writeHist, 99);
+}
+
+/**
+ * Copies the per-track access counts of a unit, counted since the system
+ * came up. A request counts once for every track it touched.
+ * 
+ * @param unit, int representing the disk unit
+ * @param counts, int* representing where to copy them
+ * @param max, int representing how many tracks fit there
+ * 
+ * @return int the number of tracks on the disk
+ */
+int diskHeat(int unit, int* counts, int max) {
+    int tracks = diskGetTracks(unit);
+    int n = tracks < max ? tracks : max;
+
+    if (n > DISK_MAXTRACKS) {
+        n = DISK_MAXTRACKS;
+    }
+
+    MboxSend(diskUnits[unit].queueMutex, NULL, 0);
+    memcpy(counts, diskUnits[unit].heat, n * sizeof(int));
+    MboxRecv(diskUnits[unit].queueMutex, NULL, 0);
+
+    return tracks;
+}
+
+/**
+ * Prints the stats of a disk unit to the console, for tuning.
+ * 
+ * @param unit, int representing the disk unit
+ */
+void dumpDiskStats(int unit) {
+    diskStats stats;
+
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        return;
+    }
+    diskStatsSnapshot(unit, &stats);
+
+    USLOSS_Console("disk %d: %d reads, %d writes, %d sectors read, %d sectors written\n",
+                   unit, stats.reads, stats.writes, stats.sectorsRead, stats.sectorsWritten);
+    USLOSS_Console("disk %d: %d seeks over %d tracks, queue depth %d (peak %d)\n",
+                   unit, stats.seeks, stats.seekDistance, stats.queueDepth, stats.peakQueueDepth);
+    USLOSS_Console("disk %d: %d merged, %d shared reads, %d absorbed writes\n",
+                   unit, stats.merged, stats.sharedReads, stats.absorbedWrites);
+    USLOSS_Console("disk %d: %d anticipations, %d hits, %d mirrored reads\n",
+                   unit, stats.anticipations, stats.anticipationHits, stats.mirrorReads);
+    USLOSS_Console("disk %d: journal %d writes in %d batches, %d checkpoints, %d replayed\n",
+                   unit, stats.journalWrites, stats.journalBatches, stats.journalCheckpoints,
+                   stats.journalReplayed);
+    USLOSS_Console("disk %d: cache %d hits, %d misses, %d sectors prefetched\n",
+                   unit, stats.cacheHits, stats.cacheMisses, stats.cachePrefetched);
+    USLOSS_Console("disk %d: wait p50 %d us p99 %d us, service p50 %d us p99 %d us\n",
+                   unit, stats.waitP50, stats.waitP99, stats.serviceP50, stats.serviceP99);
+    USLOSS_Console("disk %d: read p50 %d us p99 %d us, write p50 %d us p99 %d us\n",
+                   unit, stats.readP50, stats.readP99, stats.writeP50, stats.writeP99);
+}
+
+/**
+ * Empties a per track request queue.
+ * 
+ * @param queue, diskQueue* representing the queue to initialize
+ */
+void diskQueueInit(diskQueue* queue) {
+    memset(queue, 0, sizeof(*queue));
+}
+
+/**
+ * Appends a request to the bucket of its track. O(1).
+ * 
+ * @param queue, diskQueue* representing the queue to add to
+ * @param req, diskRequest* representing the request to add
+ */
+void diskQueuePush(diskQueue* queue, diskRequest* req) {
+    int track = req->track;
+
+    req->next = NULL;
+    if (queue->tail[track] == NULL) {
+        queue->head[track] = req;
+        queue->busy[track / BUSY_BITS] |= 1UL << (track % BUSY_BITS);
+    } else {
+        queue->tail[track]->next = req;
+    }
+    queue->tail[track] = req;
+    queue->count++;
+}
+
+/**
+ * Puts a request at the head of the bucket of its track. O(1).
+ * 
+ * @param queue, diskQueue* representing the queue to add to
+ * @param req, diskRequest* representing the request to add
+ */
+void diskQueuePushFront(diskQueue* queue, diskRequest* req) {
+    int track = req->track;
+
+    req->next = queue->head[track];
+    if (queue->head[track] == NULL) {
+        queue->tail[track] = req;
+        queue->busy[track / BUSY_BITS] |= 1UL << (track % BUSY_BITS);
+    }
+    queue->head[track] = req;
+    queue->count++;
+}
+
+/**
+ * Finds the lowest track at or above from that has a request waiting.
+ * Costs one bitmap word per BUSY_BITS tracks.
+ * 
+ * @param queue, diskQueue* representing the queue to look in
+ * @param from, int representing the first track to consider
+ * 
+ * @return int the track, or -1 if there is none
+ */
+int diskQueueNextTrack(diskQueue* queue, int from) {
+    for (int w = from / BUSY_BITS; w < DISK_MAXTRACKS / BUSY_BITS; w++) {
+        unsigned long bits = queue->busy[w];
+        if (w == from / BUSY_BITS) {
+            bits &= ~0UL << (from % BUSY_BITS);
+        }
+        if (bits != 0) {
+            return w * BUSY_BITS + __builtin_ctzl(bits);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Takes the next request of a unit off its class queues: real-time
+ * first, then best-effort, then idle. A class with requests waiting ages
+ * by one each time another class is served ahead of it, and once it has
+ * aged DISK_AGE_LIMIT times it gets the next turn, so a steady stream of
+ * higher class requests cannot starve it. Within a class the order is
+ * C-LOOK. The caller holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit to take from
+ * @param curTrack, int representing the track the head is on
+ * 
+ * @return diskRequest* the request, or NULL if every queue is empty
+ */
+diskRequest* diskUnitPop(diskUnit* unit, int curTrack) {
+    int pick = -1;
+
+    for (int c = 0; c < DISK_NCLASSES && pick < 0; c++) {
+        if (diskClassCount(unit, c) > 0 && unit->age[c] >= DISK_AGE_LIMIT) {
+            pick = c;
+        }
+    }
+    for (int c = 0; c < DISK_NCLASSES && pick < 0; c++) {
+        if (diskClassCount(unit, c) > 0) {
+            pick = c;
+        }
+    }
+    if (pick < 0) {
+        return NULL;
+    }
+    diskAgeClasses(unit, pick);
+
+    // whatever was queued before a switch to CFQ drains first
+    if (unit->queues[pick][DISK_DIR_READ].count + unit->queues[pick][DISK_DIR_WRITE].count > 0) {
+        int dir = diskPickDirection(unit, pick);
+        return diskQueuePop(&unit->queues[pick][dir], curTrack);
+    }
+    return diskCfqPop(unit, pick, curTrack);
+}
+
+/**
+ * Ages every class with requests waiting that is passed over for the one
+ * served next, which starts again from nothing. The caller holds the
+ * queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param pick, int representing the class served
+ */
+void diskAgeClasses(diskUnit* unit, int pick) {
+    for (int c = 0; c < DISK_NCLASSES; c++) {
+        if (c != pick && diskClassCount(unit, c) > 0) {
+            unit->age[c]++;
+        }
+    }
+    unit->age[pick] = 0;
+}
+
+/**
+ * Picks whether a class serves a read or a write next. Callers block on
+ * reads, so reads go first; but once DISK_CTL_WRITESTARVE reads went
+ * ahead of waiting writes, the writes get a batch of DISK_CTL_WRITEBATCH,
+ * which the elevator sweeps in track order. The caller holds the queue
+ * lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param ioClass, int representing the class, with something queued
+ * 
+ * @return int DISK_DIR_READ or DISK_DIR_WRITE
+ */
+int diskPickDirection(diskUnit* unit, int ioClass) {
+    int reads = unit->queues[ioClass][DISK_DIR_READ].count;
+    int writes = unit->queues[ioClass][DISK_DIR_WRITE].count;
+
+    if (writes == 0) {
+        unit->writeBatch = 0;
+        return DISK_DIR_READ;
+    }
+    if (reads == 0) {
+        return DISK_DIR_WRITE;
+    }
+
+    if (unit->writeBatch > 0) {
+        unit->writeBatch--;
+        return DISK_DIR_WRITE;
+    }
+
+    if (unit->writeStarve >= unit->writeStarveLimit) {
+        unit->writeStarve = 0;
+        unit->writeBatch = unit->writeBatchSize - 1;
+        return DISK_DIR_WRITE;
+    }
+    unit->writeStarve++;
+    return DISK_DIR_READ;
+}
+
+/**
+ * Counts the requests waiting on a unit in all classes.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * 
+ * @return int the number of requests
+ */
+int diskQueueDepth(diskUnit* unit) {
+    int depth = 0;
+    for (int c = 0; c < DISK_NCLASSES; c++) {
+        depth += diskClassCount(unit, c);
+    }
+    return depth;
+}
+
+/**
+ * Counts the requests waiting on a unit in one class.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param ioClass, int representing the class
+ * 
+ * @return int the number of requests
+ */
+int diskClassCount(diskUnit* unit, int ioClass) {
+    return unit->queues[ioClass][DISK_DIR_READ].count + unit->queues[ioClass][DISK_DIR_WRITE].count + unit->cfqCount[ioClass];
+}
+
+/**
+ * Queues a request on its unit the way the unit's scheduler wants it.
+ * The caller holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param req, diskRequest* representing the request to add
+ * @param front, int representing if it goes ahead of the requests already
+ * waiting on its track, as the rest of one that was in service does
+ */
+void diskUnitPush(diskUnit* unit, diskRequest* req, int front) {
+    if (unit->sched == DISK_SCHED_CFQ) {
+        diskCfqPush(unit, req, front);
+    } else if (front) {
+        diskQueuePushFront(&unit->queues[req->ioClass][req->dir], req);
+    } else {
+        diskQueuePush(&unit->queues[req->ioClass][req->dir], req);
+    }
+}
+
+/**
+ * Adds a request to the CFQ sub-queue of the process that issued it,
+ * keeping the sub-queue sorted by track. A process that had nothing
+ * waiting goes to the back of the round robin with a fresh budget.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param req, diskRequest* representing the request to add
+ * @param front, int representing if it goes ahead of the others on its
+ * track
+ */
+void diskCfqPush(diskUnit* unit, diskRequest* req, int front) {
+    int c = req->ioClass;
+    int slot = diskCfqSlot(unit, c, req->pid);
+    diskCfq* sub = &unit->cfq[c][slot];
+
+    // after anything on the same track, so a track keeps arrival order
+    diskRequest** link = &sub->head;
+    while (*link != NULL && ((*link)->track < req->track || (!front && (*link)->track == req->track))) {
+        link = &(*link)->next;
+    }
+    req->next = *link;
+    *link = req;
+    sub->count++;
+    unit->cfqCount[c]++;
+
+    if (!sub->active) {
+        sub->active = 1;
+        sub->pid = req->pid;
+        sub->budget = unit->cfqSlice;
+        sub->nextActive = -1;
+        if (unit->cfqLast[c] < 0) {
+            unit->cfqFirst[c] = slot;
+        } else {
+            unit->cfq[c][unit->cfqLast[c]].nextActive = slot;
+        }
+        unit->cfqLast[c] = slot;
+    }
+}
+
+/**
+ * Finds the CFQ sub-queue of a process: the active one it owns, or else a
+ * free one, looking from the slot its pid hashes to. A sub-queue is only
+ * active while it holds requests, so there is a free one for every live
+ * process.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param ioClass, int representing the class of the sub-queues
+ * @param pid, int representing the process
+ * 
+ * @return int the slot of the sub-queue
+ */
+int diskCfqSlot(diskUnit* unit, int ioClass, int pid) {
+    int free = -1;
+
+    for (int i = 0; i < MAXPROC; i++) {
+        int slot = (pid + i) % MAXPROC;
+        diskCfq* sub = &unit->cfq[ioClass][slot];
+
+        if (sub->active && sub->pid == pid) {
+            return slot;
+        }
+        if (!sub->active && free < 0) {
+            free = slot;
+        }
+    }
+
+    // every sub-queue busy cannot happen with MAXPROC processes, share one
+    return free >= 0 ? free : pid % MAXPROC;
+}
+
+/**
+ * Takes the next request of a class in CFQ order: the process at the
+ * front of the round robin is served in C-LOOK order until its sub-queue
+ * is empty or its budget runs out, then it moves to the back.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param ioClass, int representing the class to take from
+ * @param curTrack, int representing the track the head is on
+ * 
+ * @return diskRequest* the request, or NULL if the class is empty
+ */
+diskRequest* diskCfqPop(diskUnit* unit, int ioClass, int curTrack) {
+    int slot = unit->cfqFirst[ioClass];
+    if (slot < 0) {
+        return NULL;
+    }
+    diskCfq* sub = &unit->cfq[ioClass][slot];
+
+    // nearest track at or above the head, or the lowest one
+    diskRequest** link = &sub->head;
+    while (*link != NULL && (*link)->track < curTrack) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        link = &sub->head;
+    }
+
+    diskRequest* req = *link;
+    *link = req->next;
+    req->next = NULL;
+    sub->count--;
+    unit->cfqCount[ioClass]--;
+    sub->budget -= diskChunkSectors(req);
+
+    if (sub->count > 0 && sub->budget > 0) {
+        return req;
+    }
+
+    // its turn is over, off the front of the round robin
+    unit->cfqFirst[ioClass] = sub->nextActive;
+    if (unit->cfqFirst[ioClass] < 0) {
+        unit->cfqLast[ioClass] = -1;
+    }
+    sub->active = 0;
+
+    // still has work, so back in line with a new budget
+    if (sub->count > 0) {
+        sub->active = 1;
+        sub->budget = unit->cfqSlice;
+        sub->nextActive = -1;
+        if (unit->cfqLast[ioClass] < 0) {
+            unit->cfqFirst[ioClass] = slot;
+        } else {
+            unit->cfq[ioClass][unit->cfqLast[ioClass]].nextActive = slot;
+        }
+        unit->cfqLast[ioClass] = slot;
+    }
+
+    return req;
+}
+
+/**
+ * Moves every request waiting in the CFQ sub-queues of a unit to its
+ * class queues, going round the round robin, so they are served in
+ * C-LOOK order with everything else once the unit leaves CFQ. The caller
+ * holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ */
+void diskCfqDrain(diskUnit* unit) {
+    for (int c = 0; c < DISK_NCLASSES; c++) {
+        for (int slot = unit->cfqFirst[c]; slot >= 0; slot = unit->cfq[c][slot].nextActive) {
+            diskCfq* sub = &unit->cfq[c][slot];
+
+            while (sub->head != NULL) {
+                diskRequest* req = sub->head;
+                sub->head = req->next;
+                req->next = NULL;
+                diskQueuePush(&unit->queues[c][req->dir], req);
+            }
+            sub->count = 0;
+            sub->active = 0;
+        }
+        unit->cfqFirst[c] = -1;
+        unit->cfqLast[c] = -1;
+        unit->cfqCount[c] = 0;
+    }
+}
+
+/**
+ * Counts the sectors the next chunk of a request moves, the ones on its
+ * lowest track.
+ * 
+ * @param req, diskRequest* representing the request
+ * 
+ * @return int the number of sectors
+ */
+int diskChunkSectors(diskRequest* req) {
+    int sectors = 0;
+    for (int s = 0; s < req->nsegs; s++) {
+        if (req->segs[s].track == req->track) {
+            int count = USLOSS_DISK_TRACK_SIZE - req->segs[s].first;
+            sectors += count < req->segs[s].count ? count : req->segs[s].count;
+        }
+    }
+    return sectors;
+}
+
+/**
+ * Adds device time to what a process has used, if its bookkeeping slot
+ * still belongs to it.
+ * 
+ * @param pid, int representing the process id
+ * @param us, int representing the time in microseconds
+ */
+void diskChargeTime(int pid, int us) {
+    MboxSend(diskProcMutex, NULL, 0);
+    diskProc* proc = &diskProcTable[pid % MAXPROC];
+    if (proc->pid == pid) {
+        proc->diskTime += us;
+    }
+    MboxRecv(diskProcMutex, NULL, 0);
+}
+
+/**
+ * Remembers when a process's synchronous read completed, to measure how
+ * long it thinks before the next one.
+ * 
+ * @param pid, int representing the process id
+ */
+void diskNoteReadDone(int pid) {
+    MboxSend(diskProcMutex, NULL, 0);
+    diskProc* proc = &diskProcTable[pid % MAXPROC];
+    if (proc->pid == pid) {
+        proc->lastDone = currentTime();
+    }
+    MboxRecv(diskProcMutex, NULL, 0);
+}
+
+/**
+ * Tells if waiting for a process's next read is likely to pay off: the
+ * unit runs the anticipatory scheduler, the process usually comes back
+ * within the window, and nobody else is owed the disk first. A process
+ * not measured yet gets the benefit of the doubt.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param pid, int representing the process whose read just completed
+ * @param ioClass, int representing the class of that read
+ * 
+ * @return int 1 if the daemon should wait, 0 otherwise
+ */
+int diskShouldAnticipate(diskUnit* unit, int pid, int ioClass) {
+    if (unit->sched != DISK_SCHED_AS) {
+        return 0;
+    }
+
+    MboxSend(unit->queueMutex, NULL, 0);
+    int blocked = diskAnticBlocked(unit, ioClass);
+    MboxRecv(unit->queueMutex, NULL, 0);
+    if (blocked) {
+        return 0;
+    }
+
+    MboxSend(diskProcMutex, NULL, 0);
+    diskProc* proc = &diskProcTable[pid % MAXPROC];
+    int worth = proc->pid == pid && (proc->thinkSamples == 0 || proc->thinkTime < unit->anticWindow);
+    MboxRecv(diskProcMutex, NULL, 0);
+
+    return worth;
+}
+
+/**
+ * Keeps the head where it is for up to the unit's window, waiting for a
+ * request from the given process within DISK_ANTIC_DIST tracks. Every
+ * new request wakes the daemon to look, and the sleep daemon wakes it on
+ * the first clock interrupt after the unit's deadline. The wait ends
+ * early once a request arrives that is owed the disk first. A follow-up
+ * counts as a turn of its class, like any request the elevator takes.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param pid, int representing the process to wait for
+ * @param ioClass, int representing the class of its last read
+ * @param curTrack, int representing the track the head is on
+ * 
+ * @return diskRequest* the follow-up, taken off the queue, or NULL if
+ * none came in time
+ */
+diskRequest* diskAnticipate(diskUnit* unit, int pid, int ioClass, int curTrack) {
+    long deadline = currentTime() + unit->anticWindow;
+
+    unit->anticDeadline = deadline;
+    unit->stats.anticipations++;
+
+    while (1) {
+        MboxSend(unit->queueMutex, NULL, 0);
+        int blocked = diskAnticBlocked(unit, ioClass);
+        diskRequest* req = blocked ? NULL : diskTakeFollowUp(unit, pid, curTrack);
+        if (req != NULL) {
+            diskChargeFollowUp(unit, req);
+        }
+        MboxRecv(unit->queueMutex, NULL, 0);
+
+        if (blocked) {
+            unit->anticDeadline = 0;
+            return NULL;
+        }
+        if (req != NULL) {
+            unit->anticDeadline = 0;
+            unit->stats.anticipationHits++;
+            return req;
+        }
+        if (currentTime() >= deadline) {
+            unit->anticDeadline = 0;
+            return NULL;
+        }
+
+        MboxRecv(unit->wakeMbox, NULL, 0);
+    }
+}
+
+/**
+ * Tells if the disk is owed to someone other than a process it could
+ * wait for: it already had DISK_ANTIC_BATCH follow-ups in a row, a
+ * higher class has requests waiting, another class has been passed over
+ * DISK_AGE_LIMIT times, or the writes of the process's class are due a
+ * batch. The caller holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param ioClass, int representing the class of the process
+ * 
+ * @return int 1 if the daemon must not wait, 0 otherwise
+ */
+int diskAnticBlocked(diskUnit* unit, int ioClass) {
+    if (unit->anticStreak >= DISK_ANTIC_BATCH) {
+        return 1;
+    }
+    for (int c = 0; c < DISK_NCLASSES; c++) {
+        if (c != ioClass && diskClassCount(unit, c) > 0 && (c < ioClass || unit->age[c] >= DISK_AGE_LIMIT)) {
+            return 1;
+        }
+    }
+    return unit->queues[ioClass][DISK_DIR_WRITE].count > 0 && unit->writeStarve >= unit->writeStarveLimit;
+}
+
+/**
+ * Charges a follow-up taken out of turn as the elevator would have: the
+ * other classes waiting age, and a read served while writes of its class
+ * wait counts towards their batch. The caller holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param req, diskRequest* representing the follow-up
+ */
+void diskChargeFollowUp(diskUnit* unit, diskRequest* req) {
+    diskAgeClasses(unit, req->ioClass);
+    if (req->dir == DISK_DIR_READ && unit->queues[req->ioClass][DISK_DIR_WRITE].count > 0) {
+        unit->writeStarve++;
+    }
+}
+
+/**
+ * Looks for a request from the given process near the head and takes it
+ * off the queue. The caller holds the queue lock.
+ * 
+ * @param unit, diskUnit* representing the unit
+ * @param pid, int representing the process
+ * @param curTrack, int representing the track the head is on
+ * 
+ * @return diskRequest* the request, or NULL if there is none
+ */
+diskRequest* diskTakeFollowUp(diskUnit* unit, int pid, int curTrack) {
+    for (int q = 0; q < DISK_NCLASSES * 2; q++) {
+        diskQueue* queue = &unit->queues[q / 2][q % 2];
+
+        for (int track = curTrack - DISK_ANTIC_DIST; track <= curTrack + DISK_ANTIC_DIST; track++) {
+            if (track < 0 || track >= DISK_MAXTRACKS) {
+                continue;
+            }
+
+            diskRequest* prev = NULL;
+            for (diskRequest* r = queue->head[track]; r != NULL; r = r->next) {
+                if (r->pid == pid && !diskConflictsBefore(queue, r)) {
+                    diskQueueUnlink(queue, prev, r);
+                    return r;
+                }
+                prev = r;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Tells if a waiting request conflicts with one ahead of it in its
+ * bucket, so it may not be taken out of turn.
+ * 
+ * @param queue, diskQueue* representing the queue holding req
+ * @param req, diskRequest* representing the request
+ * 
+ * @return int 1 if one ahead of it conflicts, 0 otherwise
+ */
+int diskConflictsBefore(diskQueue* queue, diskRequest* req) {
+    for (diskRequest* r = queue->head[req->track]; r != req; r = r->next) {
+        if (diskConflicts(req, r)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Takes the next request off the queue in C-LOOK order: the oldest request
+ * on the nearest track at or above the head, or, once nothing is left
+ * above, on the lowest track.
+ * 
+ * @param queue, diskQueue* representing the queue to take from
+ * @param curTrack, int representing the track the head is on
+ * 
+ * @return diskRequest* the request, or NULL if the queue is empty
+ */
+diskRequest* diskQueuePop(diskQueue* queue, int curTrack) {
+    if (queue->count == 0) {
+        return NULL;
+    }
+
+    int track = diskQueueNextTrack(queue, curTrack);
+    if (track < 0) {
+        track = diskQueueNextTrack(queue, 0);
+    }
+
+    diskRequest* req = queue->head[track];
+    diskQueueUnlink(queue, NULL, req);
+    return req;
+}
+
+/**
+ * Takes a request out of the bucket of its track.
+ * 
+ * @param queue, diskQueue* representing the queue holding req
+ * @param prev, diskRequest* representing the request before req in its
+ * bucket, or NULL if req is the first one
+ * @param req, diskRequest* representing the request to remove
+ */
+void diskQueueUnlink(diskQueue* queue, diskRequest* prev, diskRequest* req) {
+    int track = req->track;
+
+    if (prev == NULL) {
+        queue->head[track] = req->next;
+    } else {
+        prev->next = req->next;
+    }
+    if (queue->tail[track] == req) {
+        queue->tail[track] = prev;
+    }
+    if (queue->head[track] == NULL) {
+        queue->busy[track / BUSY_BITS] &= ~(1UL << (track % BUSY_BITS));
+    }
+
+    req->next = NULL;
+    queue->count--;
+}
+
+/**
+ * Gets the number of tracks of a disk unit. The geometry never changes
+ * once the daemon has probed it, so from then on this is a plain read.
+ * Only callers that come in before the probe wait on the geometry token,
+ * and they hand it right back so every one of them gets through.
+ * 
+ * @param unit, int representing the disk unit
+ * 
+ * @return int the number of tracks on the disk
+ */
+int diskGetTracks(int unit) {
+    if (diskUnits[unit].geomReady) {
+        return diskUnits[unit].numTracks;
+    }
+
+    MboxRecv(diskUnits[unit].geomMutex, NULL, 0);
+    MboxSend(diskUnits[unit].geomMutex, NULL, 0);
+
+    return diskUnits[unit].numTracks;
+}
+
+/**
+ * Puts the disk requests the current process makes from now on in an
+ * I/O priority class.
+ * 
+ * @param ioClass, int representing the class, one of DISK_CLASS_*
+ */
+void diskSetClass(int ioClass) {
+    MboxSend(diskProcMutex, NULL, 0);
+    getDiskProc(getpid())->ioClass = ioClass;
+    MboxRecv(diskProcMutex, NULL, 0);
+}
+
+/**
+ * Picks the unit a read of the mirrored volume goes to. The unit with
+ * fewer requests waiting wins; on a tie, the one whose head is closer to
+ * the track. A disk that migrates tracks keeps the block somewhere else
+ * than the other, so each unit has its own track.
+ * 
+ * @param tracks, int* representing the first track the read touches on
+ * each unit
+ * 
+ * @return int the disk unit to read from
+ */
+int diskPickMirror(int* tracks) {
+    int best = 0;
+    int bestDepth = 0;
+    int bestDist = 0;
+
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        MboxSend(diskUnits[unit].queueMutex, NULL, 0);
+        int depth = diskQueueDepth(&diskUnits[unit]);
+        int head = diskUnits[unit].headTrack < 0 ? 0 : diskUnits[unit].headTrack;
+        MboxRecv(diskUnits[unit].queueMutex, NULL, 0);
+
+        int track = tracks[unit];
+        int dist = track > head ? track - head : head - track;
+        if (unit == 0 || depth < bestDepth || (depth == bestDepth && dist < bestDist)) {
+            best = unit;
+            bestDepth = depth;
+            bestDist = dist;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Counts a read of the mirrored volume that a unit has finished, whether
+ * it was picked for the read or took it over when the other copy failed.
+ * 
+ * @param unit, int representing the disk unit
+ */
+void diskCountMirror(int unit) {
+    MboxSend(diskUnits[unit].queueMutex, NULL, 0);
+    diskUnits[unit].stats.mirrorReads++;
+    MboxRecv(diskUnits[unit].queueMutex, NULL, 0);
+}
+
+/**
+ * Tells how many tracks of a disk its users see, which leaves out the
+ * journal, the cache list, the stores and the saved remapping table if
+ * the disk has them.
+ * Each of these sits at the end of the disk and counts the tracks after
+ * it, so only the largest one matters.
+ * 
+ * @param unit, int representing the disk unit
+ * 
+ * @return int the number of tracks
+ */
+int diskUserTracks(int unit) {
+    int reserved = journalReserved(unit);
+    int cached = cacheReserved(unit);
+    int stored = kvReserved(unit);
+    int filed = fileReserved(unit);
+    int remapped = blockReserved(unit);
+
+    if (cached > reserved) {
+        reserved = cached;
+    }
+    if (stored > reserved) {
+        reserved = stored;
+    }
+    if (filed > reserved) {
+        reserved = filed;
+    }
+    if (remapped > reserved) {
+        reserved = remapped;
+    }
+    return diskGetTracks(unit) - reserved;
+}
+
+/**
+ * Validates the unit, track and first sector of a disk syscall. A track
+ * past the end of the disk is not an invalid argument: the request is
+ * attempted and completes with USLOSS_DEV_ERROR.
+ * 
+ * @param unit, int representing the disk unit
+ * @param track, int representing the track
+ * @param first, int representing the first sector on the track
+ * 
+ * @return int 0 if they are valid, -1 otherwise
+ */
+int diskCheckArgs(int unit, int track, int first) {
+    if (unit < 0 || unit >= USLOSS_DISK_UNITS) {
+        return -1;
+    }
+
+    if (track < 0 || first < 0 || first >= USLOSS_DISK_TRACK_SIZE) {
+        return -1;
+    }
+
+    return 0;
+}
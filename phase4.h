@@ -7,6 +7,34 @@
 
 #define MAXLINE         80
 
+/*
+ * System call numbers for the phase 4 extensions; they sit above the ones
+ * handed out by usyscall.h and below MAXSYSCALLS.
+ */
+#define SYS_DISKREADASYNC   30
+#define SYS_DISKWRITEASYNC  31
+#define SYS_DISKWAIT        32
+#define SYS_DISKREADV       33
+#define SYS_DISKWRITEV      34
+#define SYS_DISKSTATS       35
+#define SYS_DISKSETPRIO     36
+#define SYS_DISKCONTROL     37
+#define SYS_DISKPROCTIME    38
+#define SYS_BLOCKIO         39
+#define SYS_FILECREATE      40
+#define SYS_FILEOPEN        41
+#define SYS_FILEIO          42
+#define SYS_KV              43
+#define SYS_DISKHEAT        44
+#define SYS_DISKCOPY        45
+#define SYS_SPLICEOUT       46
+#define SYS_SPLICEIN        47
+#define SYS_SPLICEWAIT      48
+
 extern void phase4_init(void);
+extern int  getDiskMerges(int unit);
+extern int  getDiskSharedReads(int unit);
+extern int  getDiskAbsorbedWrites(int unit);
+extern void dumpDiskStats(int unit);
 
 #endif /* _PHASE4_H */
@@ -0,0 +1,1251 @@
+/**
+ * Block layer on top of the disk driver. Callers address a volume by
+ * logical block (one sector) instead of by unit, track and sector, and
+ * the layer maps every block to where it really lives. Besides one
+ * volume per disk there is a striped volume that spreads its blocks over
+ * both disks, so large transfers keep both daemons busy at once, a
+ * mirrored volume that keeps every block on both disks, and one log
+ * structured volume per disk.
+ *
+ * A log volume treats every track of its disk as a segment and appends
+ * each write to the segment being filled, so writes land one after the
+ * other wherever their logical blocks are. An index in memory maps each
+ * logical block to its latest copy; older copies are dead. The cleaner
+ * copies the live blocks of mostly dead segments to the head of the log
+ * so whole segments can be written again. It runs at the lowest priority
+ * so it only gets the disk when nothing else wants it; a writer that
+ * finds the log nearly full cleans for itself.
+ *
+ * The plain, striped and mirrored volumes reach each disk through a
+ * remapping table of whole tracks, which starts out as the identity. A
+ * disk can have migration turned on; the migrator then watches how often
+ * the driver hits each track and swaps hot tracks far from the middle of
+ * the disk with cold ones near it, so a workload with a few hot spots
+ * keeps the arm in a narrow band. Transfers on the disk wait while two
+ * tracks are being swapped. While a disk migrates, and for as long as any
+ * of its tracks is away from home, the table is kept in a checksummed
+ * sector on the cache list's track, which DiskSize then leaves out. It is
+ * written after every swap, before the table in memory changes, and read
+ * back on first use after the system comes up. Turning migration off
+ * moves every track home and gives the sector back.
+ */
+
+// ----- Constants
+#define BLOCK_INFLIGHT 8
+#define BLOCK_LOG_SEG USLOSS_DISK_TRACK_SIZE // blocks per log segment
+#define BLOCK_LOG_RESERVE 2                  // segments left out of the size
+#define BLOCK_LOG_MINFREE 2                  // writers clean below this
+#define BLOCK_LOG_IDLEFREE 4                 // the cleaner cleans up to this
+#define BLOCK_LOG_IDLELIVE (BLOCK_LOG_SEG / 2) // if a segment is this dead
+#define BLOCK_MIGRATE_PERIOD 32              // transfers between migrator turns
+#define BLOCK_MIGRATE_MIN 8                  // heat a swap has to win by
+#define BLOCK_REMAP_SECTOR 1                 // on the cache list's track
+#define BLOCK_REMAP_MAGIC 0x52454d50
+
+// ----- Includes
+#include <phase1.h>
+#include <phase2.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+#include "phase4_internal.h"
+#include <usloss.h>
+#include <usyscall.h>
+#include <string.h>
+
+// ----- typedefs
+typedef USLOSS_Sysargs sysArgs;
+typedef struct blockIO blockIO;
+typedef struct blockLog blockLog;
+typedef struct blockRemap blockRemap;
+typedef struct blockRemapSaved blockRemapSaved;
+
+// ----- Structs
+
+struct blockIO {
+    int op;                         // USLOSS_DISK_READ or USLOSS_DISK_WRITE
+    diskSegment segs[USLOSS_DISK_UNITS][DISK_MAXSEGS]; // gathered per unit
+    int nsegs[USLOSS_DISK_UNITS];
+    diskRequest* inflight[BLOCK_INFLIGHT]; // submitted, not reaped yet
+    int ninflight;
+    int status;                     // first error seen, 0 if none
+};
+
+struct blockLog {
+    int mutex;                      // held for any use of the log
+    int ready;                      // set up on first use, needs geometry
+    int tracks;                     // segments on the disk
+    int head;                       // segment being appended to
+    int headUsed;                   // blocks of it already written
+    int freeSegs;
+    int map[DISK_MAXTRACKS * BLOCK_LOG_SEG];   // logical -> disk block, or -1
+    int owner[DISK_MAXTRACKS * BLOCK_LOG_SEG]; // disk -> logical block, or -1
+    int live[DISK_MAXTRACKS];       // blocks of each segment still mapped
+    int isFree[DISK_MAXTRACKS];     // segment may be written from the start
+    char cleanBuf[BLOCK_LOG_SEG * USLOSS_DISK_SECTOR_SIZE];
+};
+
+struct blockRemapSaved {
+    int magic;                      // BLOCK_REMAP_MAGIC while it is kept
+    int tracks;                     // tracks the migrator moves around
+    int sum;                        // checksum of the rest
+    unsigned char map[DISK_MAXTRACKS]; // logical -> disk track
+};
+
+struct blockRemap {
+    int mutex;                      // guards the fields up to transfers
+    int users;                      // transfers using the table right now
+    int moving;                     // the migrator is swapping two tracks
+    int waiters;                    // transfers waiting for the swap
+    int gate;                       // where they wait
+    int drained;                    // where the migrator waits for users
+    int on;                         // migration turned on
+    int transfers;                  // since the migrator last had a turn
+    int tracks;                     // tracks the migrator moves around
+    int loadMutex;                  // held while the saved table is first read
+    int loaded;                     // saved table read
+    int saved;                      // the table is kept on the disk
+    int moveMutex;                  // held by whoever moves tracks
+    int map[DISK_MAXTRACKS];        // logical -> disk track
+    int where[DISK_MAXTRACKS];      // disk -> logical track
+    int heat[DISK_MAXTRACKS];       // recent accesses per logical track
+    int seen[DISK_MAXTRACKS];       // driver counts per disk track last turn
+    int now[DISK_MAXTRACKS];        // driver counts per disk track this turn
+    char buf[2][USLOSS_DISK_TRACK_SIZE * USLOSS_DISK_SECTOR_SIZE];
+    char sector[USLOSS_DISK_SECTOR_SIZE]; // the saved table, as on disk
+};
+
+// ----- Function Prototypes
+
+void blockInit(void);
+void blockIOHandler(sysArgs*);
+int blockVolumeSize(int);
+int blockMap(int, int, int*);
+int blockTransfer(int, int, int, void*, int);
+int blockTransferOnce(int, int, int, void*, int, int);
+void blockAdd(blockIO*, int, int, void*);
+int blockFlush(blockIO*, int);
+void blockReapAll(blockIO*);
+void blockLogSetup(int);
+int blockLogRead(int, int, int, void*);
+int blockLogWrite(int, int, int, void*);
+int blockLogAppend(int, int, int*, int, void*);
+int blockLogAdvance(blockLog*);
+void blockLogRemap(blockLog*, int, int);
+int blockLogClean(int, int);
+int blockCleanerMain(char*);
+int blockMigrateEnable(int, int);
+int blockReserved(int);
+void blockRemapLoad(int);
+int blockRemapSave(int, int*);
+int blockRemapSum(blockRemapSaved*);
+int blockMigrateHome(int);
+void blockRemapEnter(int);
+void blockRemapLeave(int);
+int blockRemapBlock(int, int);
+void blockMigrateTurn(int);
+int blockMigrateSwap(int, int, int);
+int blockMigrateCopy(int, int, int, int*);
+int blockMigrateWrite(int, int, void*);
+int blockMigratorMain(char*);
+
+// ----- Global data structures/vars
+blockLog blockLogs[USLOSS_DISK_UNITS];
+int blockCleanMbox;
+blockRemap blockRemaps[USLOSS_DISK_UNITS];
+int blockMigrateMbox;
+
+// ----- Phase 4 Bootload
+
+/**
+ * Called from phase4_init. Only the locks and the identity remapping can
+ * be made here; the log volumes are set up, and a saved remapping table
+ * is read, once the geometry of their disk is known.
+ */
+void blockInit(void) {
+    for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+        blockRemap* r = &blockRemaps[i];
+
+        blockLogs[i].mutex = MboxCreate(1, 0);
+        r->mutex = MboxCreate(1, 0);
+        r->gate = MboxCreate(0, 0);
+        r->drained = MboxCreate(1, 0);
+        r->loadMutex = MboxCreate(1, 0);
+        r->moveMutex = MboxCreate(1, 0);
+        for (int t = 0; t < DISK_MAXTRACKS; t++) {
+            r->map[t] = t;
+            r->where[t] = t;
+        }
+    }
+    blockCleanMbox = MboxCreate(1, 0);
+    blockMigrateMbox = MboxCreate(1, 0);
+}
+
+/**
+ * Called from phase4_start_service_processes, starts the log cleaner and
+ * the track migrator.
+ */
+void blockStartDaemons(void) {
+    fork1("Log Cleaner", blockCleanerMain, NULL, USLOSS_MIN_STACK, 5);
+    fork1("Block Migrator", blockMigratorMain, NULL, USLOSS_MIN_STACK, 5);
+}
+
+// ----- Syscall Handlers
+
+/**
+ * Reads or writes a run of logical blocks of a volume, or tells how many
+ * blocks it has.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void blockIOHandler(sysArgs* args) {
+    kernelCheck("blockIOHandler");
+
+    void* buffer = args->arg1;
+    int count = (int)(long) args->arg2;
+    int lba = (int)(long) args->arg3;
+    int vol = (int)(long) args->arg4;
+    int op = (int)(long) args->arg5;
+
+    if (vol < 0 || vol >= BLOCK_NVOLS) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    if (op == BLOCK_OP_SIZE) {
+        args->arg1 = (void*)(long) blockVolumeSize(vol);
+        args->arg4 = (void*)(long)0;
+        return;
+    }
+
+    // written so a huge count cannot wrap round past the end
+    if ((op != BLOCK_OP_READ && op != BLOCK_OP_WRITE) || count <= 0 || lba < 0
+        || count > blockVolumeSize(vol) - lba) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    int diskOp = op == BLOCK_OP_READ ? USLOSS_DISK_READ : USLOSS_DISK_WRITE;
+    int status = blockTransfer(vol, lba, count, buffer, diskOp);
+
+    if (status < 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    args->arg1 = (void*)(long) status;
+    args->arg4 = (void*)(long)0;
+}
+
+// ----- Helpers
+
+/**
+ * Tells how many blocks a volume has. The striped volume only uses as
+ * much of each disk as the smaller one has.
+ *
+ * @param vol, int representing the volume
+ *
+ * @return int the number of blocks
+ */
+int blockVolumeSize(int vol) {
+    int trackBlocks = USLOSS_DISK_TRACK_SIZE;
+
+    switch (vol) {
+        case BLOCK_VOL_DISK0:
+            return diskUserTracks(0) * trackBlocks;
+        case BLOCK_VOL_DISK1:
+            return diskUserTracks(1) * trackBlocks;
+        case BLOCK_VOL_STRIPE: {
+            int tracks = diskUserTracks(0);
+            if (diskUserTracks(1) < tracks) {
+                tracks = diskUserTracks(1);
+            }
+            return USLOSS_DISK_UNITS * tracks * trackBlocks;
+        }
+        case BLOCK_VOL_MIRROR: {
+            int tracks = diskUserTracks(0);
+            if (diskUserTracks(1) < tracks) {
+                tracks = diskUserTracks(1);
+            }
+            return tracks * trackBlocks;
+        }
+        case BLOCK_VOL_LOG0:
+        case BLOCK_VOL_LOG1: {
+            int tracks = diskUserTracks(vol - BLOCK_VOL_LOG0);
+            if (tracks > DISK_MAXTRACKS) {
+                tracks = DISK_MAXTRACKS;
+            }
+            return (tracks - BLOCK_LOG_RESERVE) * BLOCK_LOG_SEG;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Maps a logical block of a volume to the disk holding it. The striped
+ * volume deals out one track worth of blocks to each disk in turn. A
+ * mirrored block is at the same place on both disks, unit 0 is reported.
+ *
+ * @param vol, int representing the volume
+ * @param lba, int representing the logical block
+ * @param *unit, int pointer filled in with the disk unit
+ *
+ * @return int the block on that disk, track * USLOSS_DISK_TRACK_SIZE +
+ * sector
+ */
+int blockMap(int vol, int lba, int* unit) {
+    if (vol == BLOCK_VOL_STRIPE) {
+        int chunk = lba / USLOSS_DISK_TRACK_SIZE;
+        *unit = chunk % USLOSS_DISK_UNITS;
+        return (chunk / USLOSS_DISK_UNITS) * USLOSS_DISK_TRACK_SIZE + lba % USLOSS_DISK_TRACK_SIZE;
+    }
+
+    *unit = vol == BLOCK_VOL_DISK1 ? 1 : 0;
+    return lba;
+}
+
+/**
+ * Moves a run of logical blocks. A read of the mirrored volume goes to
+ * the disk the driver finds less busy, and if that disk fails it, to the
+ * other copy. Log volumes go through the log.
+ *
+ * @param vol, int representing the volume
+ * @param lba, int representing the first logical block
+ * @param count, int representing the number of blocks
+ * @param buffer, void* representing the buffer to read into/write from
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ *
+ * @return int the completion status, or -1 if the driver ran out of
+ * request slots
+ */
+int blockTransfer(int vol, int lba, int count, void* buffer, int op) {
+    if (vol == BLOCK_VOL_LOG0 || vol == BLOCK_VOL_LOG1) {
+        int unit = vol - BLOCK_VOL_LOG0;
+        if (blockRemaps[unit].on) {
+            return -1;
+        }
+        if (op == USLOSS_DISK_READ) {
+            return blockLogRead(unit, lba, count, buffer);
+        }
+        return blockLogWrite(unit, lba, count, buffer);
+    }
+
+    if (vol != BLOCK_VOL_MIRROR || op != USLOSS_DISK_READ) {
+        return blockTransferOnce(vol, lba, count, buffer, op, 0);
+    }
+
+    // where each disk keeps the block now; only a hint, so no remap lock
+    int tracks[USLOSS_DISK_UNITS];
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        blockRemapLoad(unit);
+        tracks[unit] = blockRemapBlock(unit, lba) / USLOSS_DISK_TRACK_SIZE;
+    }
+
+    // counted once the disk is done with it, so a failover counts on both
+    int unit = diskPickMirror(tracks);
+    int status = blockTransferOnce(vol, lba, count, buffer, op, unit);
+    if (status >= 0) {
+        diskCountMirror(unit);
+    }
+    if (status > 0) {
+        status = blockTransferOnce(vol, lba, count, buffer, op, !unit);
+        if (status >= 0) {
+            diskCountMirror(!unit);
+        }
+    }
+    return status;
+}
+
+/**
+ * Moves a run of logical blocks once. Blocks that sit next to each other
+ * on the same disk are gathered into segments, and each disk gets
+ * vectored requests of up to DISK_MAXSEGS segments, all queued before any
+ * is waited for, so the disks work in parallel. A write of the mirrored
+ * volume is gathered for both disks. The remapping tables of the disks
+ * cannot change until the transfer is done.
+ *
+ * @param vol, int representing the volume
+ * @param lba, int representing the first logical block
+ * @param count, int representing the number of blocks
+ * @param buffer, void* representing the buffer to read into/write from
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ * @param readUnit, int representing the disk a mirrored read comes from
+ *
+ * @return int the completion status, or -1 if the driver ran out of
+ * request slots
+ */
+int blockTransferOnce(int vol, int lba, int count, void* buffer, int op, int readUnit) {
+    blockIO io;
+    memset(&io, 0, sizeof(io));
+    io.op = op;
+
+    // always in unit order, so two transfers never wait on each other
+    int firstUnit = vol == BLOCK_VOL_DISK1 ? 1 : 0;
+    int lastUnit = vol == BLOCK_VOL_DISK0 ? 0 : vol == BLOCK_VOL_DISK1 ? 1 : USLOSS_DISK_UNITS - 1;
+    for (int unit = firstUnit; unit <= lastUnit; unit++) {
+        blockRemapEnter(unit);
+    }
+
+    for (int i = 0; i < count; i++) {
+        int unit;
+        int block = blockMap(vol, lba + i, &unit);
+        void* data = buffer + i * USLOSS_DISK_SECTOR_SIZE;
+
+        if (vol != BLOCK_VOL_MIRROR) {
+            blockAdd(&io, unit, blockRemapBlock(unit, block), data);
+        } else if (op == USLOSS_DISK_READ) {
+            blockAdd(&io, readUnit, blockRemapBlock(readUnit, block), data);
+        } else {
+            for (unit = 0; unit < USLOSS_DISK_UNITS && io.status >= 0; unit++) {
+                blockAdd(&io, unit, blockRemapBlock(unit, block), data);
+            }
+        }
+
+        if (io.status < 0) {
+            break;
+        }
+    }
+
+    for (int unit = 0; unit < USLOSS_DISK_UNITS && io.status >= 0; unit++) {
+        blockFlush(&io, unit);
+    }
+
+    blockReapAll(&io);
+
+    for (int unit = firstUnit; unit <= lastUnit; unit++) {
+        blockRemapLeave(unit);
+    }
+    return io.status;
+}
+
+/**
+ * Adds one block to what is gathered for a disk, growing the last
+ * segment if the block follows it both on the disk and in the buffer.
+ *
+ * @param io, blockIO* representing the transfer
+ * @param unit, int representing the disk unit
+ * @param block, int representing the block on that disk
+ * @param buffer, void* representing the block sized buffer
+ */
+void blockAdd(blockIO* io, int unit, int block, void* buffer) {
+    int n = io->nsegs[unit];
+
+    if (n > 0) {
+        diskSegment* last = &io->segs[unit][n - 1];
+        int lastEnd = last->track * USLOSS_DISK_TRACK_SIZE + last->first + last->count;
+        if (lastEnd == block && last->buffer + last->count * USLOSS_DISK_SECTOR_SIZE == buffer) {
+            last->count++;
+            return;
+        }
+    }
+
+    // no room for another segment, send what we have
+    if (n == DISK_MAXSEGS) {
+        if (blockFlush(io, unit) < 0) {
+            return;
+        }
+        n = 0;
+    }
+
+    diskSegment* seg = &io->segs[unit][n];
+    seg->track = block / USLOSS_DISK_TRACK_SIZE;
+    seg->first = block % USLOSS_DISK_TRACK_SIZE;
+    seg->count = 1;
+    seg->buffer = buffer;
+    io->nsegs[unit] = n + 1;
+}
+
+/**
+ * Queues what is gathered for a disk as one vectored request. If every
+ * request slot is busy, the ones this transfer holds are reaped first.
+ *
+ * @param io, blockIO* representing the transfer
+ * @param unit, int representing the disk unit
+ *
+ * @return int 0 on success, -1 if no request slot could be had
+ */
+int blockFlush(blockIO* io, int unit) {
+    if (io->nsegs[unit] == 0) {
+        return 0;
+    }
+
+    if (io->ninflight == BLOCK_INFLIGHT) {
+        blockReapAll(io);
+    }
+
+    diskRequest* req = diskSubmitV(unit, io->segs[unit], io->nsegs[unit], io->op, 0);
+    if (req == NULL && io->ninflight > 0) {
+        blockReapAll(io);
+        req = diskSubmitV(unit, io->segs[unit], io->nsegs[unit], io->op, 0);
+    }
+    if (req == NULL) {
+        io->status = -1;
+        return -1;
+    }
+
+    io->inflight[io->ninflight++] = req;
+    io->nsegs[unit] = 0;
+    return 0;
+}
+
+/**
+ * Waits for every request of a transfer that is still out, keeping the
+ * first error.
+ *
+ * @param io, blockIO* representing the transfer
+ */
+void blockReapAll(blockIO* io) {
+    for (int i = 0; i < io->ninflight; i++) {
+        int status = diskReap(io->inflight[i]);
+        if (io->status == 0 && status != 0) {
+            io->status = status;
+        }
+    }
+    io->ninflight = 0;
+}
+
+/**
+ * Sets up the log of a disk the first time it is used: every segment but
+ * the head is free and no logical block is mapped. Called with the log
+ * lock held.
+ *
+ * @param unit, int representing the disk unit
+ */
+void blockLogSetup(int unit) {
+    blockLog* log = &blockLogs[unit];
+
+    if (log->ready) {
+        return;
+    }
+
+    log->tracks = diskUserTracks(unit);
+    if (log->tracks > DISK_MAXTRACKS) {
+        log->tracks = DISK_MAXTRACKS;
+    }
+    for (int i = 0; i < log->tracks * BLOCK_LOG_SEG; i++) {
+        log->map[i] = -1;
+        log->owner[i] = -1;
+    }
+    for (int t = 0; t < log->tracks; t++) {
+        log->live[t] = 0;
+        log->isFree[t] = t != 0;
+    }
+    log->head = 0;
+    log->headUsed = 0;
+    log->freeSegs = log->tracks - 1;
+    log->ready = 1;
+}
+
+/**
+ * Reads a run of blocks of a log volume from wherever their latest
+ * copies are. Blocks never written read as zeros.
+ *
+ * @param unit, int representing the disk unit
+ * @param lba, int representing the first logical block
+ * @param count, int representing the number of blocks
+ * @param buffer, void* representing the buffer to read into
+ *
+ * @return int the completion status, or -1 if the driver ran out of
+ * request slots
+ */
+int blockLogRead(int unit, int lba, int count, void* buffer) {
+    blockLog* log = &blockLogs[unit];
+    blockIO io;
+    memset(&io, 0, sizeof(io));
+    io.op = USLOSS_DISK_READ;
+
+    // the cleaner must not move the blocks while we read them
+    MboxSend(log->mutex, NULL, 0);
+    blockLogSetup(unit);
+
+    for (int i = 0; i < count && io.status >= 0; i++) {
+        void* data = buffer + i * USLOSS_DISK_SECTOR_SIZE;
+        int block = log->map[lba + i];
+
+        if (block < 0) {
+            memset(data, 0, USLOSS_DISK_SECTOR_SIZE);
+        } else {
+            blockAdd(&io, unit, block, data);
+        }
+    }
+    if (io.status >= 0) {
+        blockFlush(&io, unit);
+    }
+    blockReapAll(&io);
+
+    MboxRecv(log->mutex, NULL, 0);
+    return io.status;
+}
+
+/**
+ * Appends a run of blocks to a log volume. If that leaves too few free
+ * segments the writer cleans until there are enough again, and either way
+ * the cleaner is woken to clean further in idle time.
+ *
+ * @param unit, int representing the disk unit
+ * @param lba, int representing the first logical block
+ * @param count, int representing the number of blocks
+ * @param buffer, void* representing the buffer to write from
+ *
+ * @return int the completion status, or -1 if the driver ran out of
+ * request slots or the log had no room
+ */
+int blockLogWrite(int unit, int lba, int count, void* buffer) {
+    blockLog* log = &blockLogs[unit];
+
+    MboxSend(log->mutex, NULL, 0);
+    blockLogSetup(unit);
+
+    int status = blockLogAppend(unit, lba, NULL, count, buffer);
+    while (status == 0 && log->freeSegs < BLOCK_LOG_MINFREE &&
+           blockLogClean(unit, BLOCK_LOG_SEG - 1) == 0) {
+    }
+
+    MboxRecv(log->mutex, NULL, 0);
+
+    MboxCondSend(blockCleanMbox, NULL, 0);
+    return status;
+}
+
+/**
+ * Writes blocks at the head of the log, one request per segment they
+ * touch, and maps each to its new copy once it is on the disk. Called
+ * with the log lock held.
+ *
+ * @param unit, int representing the disk unit
+ * @param lba, int representing the first logical block, if lbas is NULL
+ * @param lbas, int* representing the logical block of each, or NULL if
+ * they run from lba
+ * @param count, int representing the number of blocks
+ * @param buffer, void* representing the blocks, one after the other
+ *
+ * @return int the completion status, or -1 if the driver ran out of
+ * request slots or the log had no room
+ */
+int blockLogAppend(int unit, int lba, int* lbas, int count, void* buffer) {
+    blockLog* log = &blockLogs[unit];
+    int done = 0;
+
+    while (done < count) {
+        if (log->headUsed == BLOCK_LOG_SEG && blockLogAdvance(log) < 0) {
+            return -1;
+        }
+
+        int n = count - done;
+        if (n > BLOCK_LOG_SEG - log->headUsed) {
+            n = BLOCK_LOG_SEG - log->headUsed;
+        }
+        int first = log->headUsed;
+        log->headUsed += n;
+
+        diskRequest* req = diskSubmit(unit, log->head, first, n,
+                                      buffer + done * USLOSS_DISK_SECTOR_SIZE, USLOSS_DISK_WRITE, 0);
+        if (req == NULL) {
+            return -1;
+        }
+        int status = diskReap(req);
+        if (status != 0) {
+            return status;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int logical = lbas != NULL ? lbas[done + i] : lba + done + i;
+            blockLogRemap(log, logical, log->head * BLOCK_LOG_SEG + first + i);
+        }
+        done += n;
+    }
+
+    return 0;
+}
+
+/**
+ * Moves the head of the log to the next free segment after it, so a log
+ * with room keeps moving the same way across the disk.
+ *
+ * @param log, blockLog* representing the log
+ *
+ * @return int 0 on success, -1 if no segment is free
+ */
+int blockLogAdvance(blockLog* log) {
+    int old = log->head;
+
+    for (int i = 1; i < log->tracks; i++) {
+        int seg = (old + i) % log->tracks;
+        if (log->isFree[seg]) {
+            log->isFree[seg] = 0;
+            log->freeSegs--;
+            log->head = seg;
+            log->headUsed = 0;
+
+            // everything written to the old head may already be dead
+            if (log->live[old] == 0) {
+                log->isFree[old] = 1;
+                log->freeSegs++;
+            }
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Points a logical block at a new copy. The old copy, if any, is dead,
+ * and a segment left with no live blocks is free again.
+ *
+ * @param log, blockLog* representing the log
+ * @param lba, int representing the logical block
+ * @param block, int representing the block on the disk
+ */
+void blockLogRemap(blockLog* log, int lba, int block) {
+    int old = log->map[lba];
+
+    if (old >= 0) {
+        int seg = old / BLOCK_LOG_SEG;
+        log->owner[old] = -1;
+        log->live[seg]--;
+        if (log->live[seg] == 0 && seg != log->head) {
+            log->isFree[seg] = 1;
+            log->freeSegs++;
+        }
+    }
+
+    log->map[lba] = block;
+    log->owner[block] = lba;
+    log->live[block / BLOCK_LOG_SEG]++;
+}
+
+/**
+ * Cleans the segment with the fewest live blocks: reads it, and appends
+ * its live blocks to the head of the log, which frees it. Called with
+ * the log lock held.
+ *
+ * @param unit, int representing the disk unit
+ * @param maxLive, int representing the most live blocks worth moving
+ *
+ * @return int 0 if a segment was cleaned, -1 if none was worth it or the
+ * disk failed
+ */
+int blockLogClean(int unit, int maxLive) {
+    blockLog* log = &blockLogs[unit];
+    int victim = -1;
+
+    for (int seg = 0; seg < log->tracks; seg++) {
+        if (seg == log->head || log->isFree[seg] || log->live[seg] > maxLive) {
+            continue;
+        }
+        if (victim < 0 || log->live[seg] < log->live[victim]) {
+            victim = seg;
+        }
+    }
+    if (victim < 0) {
+        return -1;
+    }
+
+    diskRequest* req = diskSubmit(unit, victim, 0, BLOCK_LOG_SEG, log->cleanBuf, USLOSS_DISK_READ, 0);
+    if (req == NULL || diskReap(req) != 0) {
+        return -1;
+    }
+
+    // pack the live blocks at the front of the buffer
+    int lbas[BLOCK_LOG_SEG];
+    int n = 0;
+    for (int s = 0; s < BLOCK_LOG_SEG; s++) {
+        int lba = log->owner[victim * BLOCK_LOG_SEG + s];
+        if (lba >= 0) {
+            memmove(log->cleanBuf + n * USLOSS_DISK_SECTOR_SIZE,
+                    log->cleanBuf + s * USLOSS_DISK_SECTOR_SIZE, USLOSS_DISK_SECTOR_SIZE);
+            lbas[n++] = lba;
+        }
+    }
+
+    return blockLogAppend(unit, 0, lbas, n, log->cleanBuf) == 0 ? 0 : -1;
+}
+
+/**
+ * Log cleaner daemon. Woken after log writes, it cleans mostly dead
+ * segments until each log has a few free ones, one segment per turn so
+ * writers are not held up long. Its disk requests are in the idle class.
+ *
+ * @param arg, char* unused
+ *
+ * @return int never returns
+ */
+int blockCleanerMain(char* arg) {
+    diskSetClass(DISK_CLASS_IDLE);
+
+    while (1) {
+        MboxRecv(blockCleanMbox, NULL, 0);
+
+        for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+            blockLog* log = &blockLogs[unit];
+            int more = 1;
+
+            while (more) {
+                MboxSend(log->mutex, NULL, 0);
+                more = log->ready && log->freeSegs < BLOCK_LOG_IDLEFREE &&
+                       blockLogClean(unit, BLOCK_LOG_IDLELIVE) == 0;
+                MboxRecv(log->mutex, NULL, 0);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Turns track migration on or off for a disk. The disk must only be used
+ * through the plain, striped and mirrored volumes, never by its log
+ * volume or directly, since the migrator moves whole tracks under them.
+ * Turning it on saves the table first, so the sector it is kept in is
+ * out of the volumes before any track moves. Turning it off moves every
+ * track home and then gives the sector back; if that fails the table
+ * stays saved, and turning it off again carries on.
+ *
+ * @param unit, int representing the disk unit
+ * @param on, int representing 1 to turn it on, 0 to turn it off
+ *
+ * @return int 0 on success, -1 if the log volume of the disk is in use,
+ * otherwise the disk status
+ */
+int blockMigrateEnable(int unit, int on) {
+    blockRemap* r = &blockRemaps[unit];
+
+    if (on && blockLogs[unit].ready) {
+        return -1;
+    }
+    blockRemapLoad(unit);
+
+    // the migrator is not half way through a turn
+    MboxSend(r->moveMutex, NULL, 0);
+    int status = 0;
+
+    if (on && !r->on) {
+        if (!r->saved) {
+            // the volumes shrink before the table covers them
+            r->saved = 1;
+            r->tracks = diskUserTracks(unit);
+            if (r->tracks > DISK_MAXTRACKS) {
+                r->tracks = DISK_MAXTRACKS;
+            }
+            status = blockRemapSave(unit, r->map);
+            if (status != 0) {
+                r->saved = 0;
+            }
+        }
+        if (status == 0) {
+            memset(r->heat, 0, sizeof(r->heat));
+            diskHeat(unit, r->seen, DISK_MAXTRACKS);
+            r->transfers = 0;
+            r->on = 1;
+        }
+    } else if (!on) {
+        r->on = 0;
+        if (r->saved) {
+            status = blockMigrateHome(unit);
+        }
+    }
+    MboxRecv(r->moveMutex, NULL, 0);
+
+    return status;
+}
+
+/**
+ * Tells how many tracks at the end of a disk the block layer keeps from
+ * its users: if the disk has a saved table, the track it shares with the
+ * cache list and the journal's after it. The table is read the first
+ * time this is asked.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the number of tracks, 0 if no table is saved
+ */
+int blockReserved(int unit) {
+    blockRemapLoad(unit);
+    return blockRemaps[unit].saved ? DISK_META_TRACKS : 0;
+}
+
+/**
+ * Reads the saved remapping table of a disk the first time it is needed.
+ * A disk with no valid table keeps the identity.
+ *
+ * @param unit, int representing the disk unit
+ */
+void blockRemapLoad(int unit) {
+    blockRemap* r = &blockRemaps[unit];
+
+    if (r->loaded) {
+        return;
+    }
+
+    MboxSend(r->loadMutex, NULL, 0);
+    if (!r->loaded && diskGetTracks(unit) > DISK_META_TRACKS) {
+        blockRemapSaved* saved = (blockRemapSaved*) r->sector;
+        int track = diskGetTracks(unit) - DISK_META_TRACKS;
+
+        diskRequest* req = diskSubmitRaw(unit, track, BLOCK_REMAP_SECTOR, 1, r->sector, USLOSS_DISK_READ);
+        int status = req == NULL ? -1 : diskReap(req);
+
+        int ok = status == 0 && saved->magic == BLOCK_REMAP_MAGIC && saved->sum == blockRemapSum(saved) &&
+                 saved->tracks > 0 && saved->tracks <= track && saved->tracks <= DISK_MAXTRACKS;
+        int used[DISK_MAXTRACKS];
+        memset(used, 0, sizeof(used));
+        for (int t = 0; ok && t < saved->tracks; t++) {
+            ok = saved->map[t] < saved->tracks && !used[saved->map[t]]++;
+        }
+        if (ok) {
+            r->tracks = saved->tracks;
+            for (int t = 0; t < r->tracks; t++) {
+                r->map[t] = saved->map[t];
+                r->where[saved->map[t]] = t;
+            }
+            r->saved = 1;
+        }
+    }
+    r->loaded = 1;
+    MboxRecv(r->loadMutex, NULL, 0);
+}
+
+/**
+ * Writes a remapping table of a disk to its sector. The journal is
+ * synced over the sector first, since it may hold a write from before
+ * the sector was set aside.
+ *
+ * @param unit, int representing the disk unit
+ * @param map, int* representing the table, logical -> disk track, or
+ * NULL to erase the saved one
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int blockRemapSave(int unit, int* map) {
+    blockRemap* r = &blockRemaps[unit];
+    blockRemapSaved* saved = (blockRemapSaved*) r->sector;
+
+    memset(r->sector, 0, sizeof(r->sector));
+    if (map != NULL) {
+        saved->magic = BLOCK_REMAP_MAGIC;
+        saved->tracks = r->tracks;
+        for (int t = 0; t < r->tracks; t++) {
+            saved->map[t] = map[t];
+        }
+        saved->sum = blockRemapSum(saved);
+    }
+
+    diskSegment seg = { diskGetTracks(unit) - DISK_META_TRACKS, BLOCK_REMAP_SECTOR, 1, r->sector };
+    journalSyncOverlap(unit, &seg, 1);
+    diskRequest* req = diskSubmitRawV(unit, &seg, 1, USLOSS_DISK_WRITE);
+    return req == NULL ? -1 : diskReap(req);
+}
+
+/**
+ * Checksums a saved remapping table, leaving out the checksum itself.
+ *
+ * @param saved, blockRemapSaved* representing the table
+ *
+ * @return int the checksum
+ */
+int blockRemapSum(blockRemapSaved* saved) {
+    unsigned int sum = (unsigned int) saved->magic * 31 + (unsigned int) saved->tracks;
+
+    for (int t = 0; t < DISK_MAXTRACKS; t++) {
+        sum = sum * 31 + saved->map[t];
+    }
+    return (int) sum;
+}
+
+/**
+ * Moves every track of a disk back home, one swap at a time, and erases
+ * the saved table once they all are. Called with the move lock held and
+ * migration off.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int 0 on success, otherwise the status of the swap or write
+ * that failed
+ */
+int blockMigrateHome(int unit) {
+    blockRemap* r = &blockRemaps[unit];
+
+    for (int t = 0; t < r->tracks; t++) {
+        if (r->map[t] != t) {
+            int status = blockMigrateSwap(unit, t, r->where[t]);
+            if (status != 0) {
+                return status;
+            }
+        }
+    }
+
+    int status = blockRemapSave(unit, NULL);
+    if (status == 0) {
+        r->saved = 0;
+    }
+    return status;
+}
+
+/**
+ * Starts using the remapping table of a disk for a transfer, waiting
+ * first if the migrator is swapping two tracks.
+ *
+ * @param unit, int representing the disk unit
+ */
+void blockRemapEnter(int unit) {
+    blockRemap* r = &blockRemaps[unit];
+
+    blockRemapLoad(unit);
+    MboxSend(r->mutex, NULL, 0);
+    while (r->moving) {
+        r->waiters++;
+        MboxRecv(r->mutex, NULL, 0);
+        MboxRecv(r->gate, NULL, 0);
+        MboxSend(r->mutex, NULL, 0);
+    }
+    r->users++;
+    MboxRecv(r->mutex, NULL, 0);
+}
+
+/**
+ * Stops using the remapping table of a disk. The last transfer out lets
+ * a waiting migrator go ahead, and every so many transfers on a
+ * migrating disk the migrator gets a turn.
+ *
+ * @param unit, int representing the disk unit
+ */
+void blockRemapLeave(int unit) {
+    blockRemap* r = &blockRemaps[unit];
+
+    MboxSend(r->mutex, NULL, 0);
+    r->users--;
+    int drained = r->moving && r->users == 0;
+    int turn = r->on && ++r->transfers >= BLOCK_MIGRATE_PERIOD;
+    if (turn) {
+        r->transfers = 0;
+    }
+    MboxRecv(r->mutex, NULL, 0);
+
+    if (drained) {
+        MboxSend(r->drained, NULL, 0);
+    }
+    if (turn) {
+        MboxCondSend(blockMigrateMbox, NULL, 0);
+    }
+}
+
+/**
+ * Maps a block of a disk to where its track is now.
+ *
+ * @param unit, int representing the disk unit
+ * @param block, int representing track * USLOSS_DISK_TRACK_SIZE + sector
+ *
+ * @return int the block where it really is
+ */
+int blockRemapBlock(int unit, int block) {
+    int track = block / USLOSS_DISK_TRACK_SIZE;
+
+    if (track >= DISK_MAXTRACKS) {
+        return block;
+    }
+    return blockRemaps[unit].map[track] * USLOSS_DISK_TRACK_SIZE + block % USLOSS_DISK_TRACK_SIZE;
+}
+
+/**
+ * One turn of the migrator on a disk. The accesses since the last turn
+ * are added to the heat of the logical tracks, after halving it so old
+ * accesses fade. Then the swap that gains the most is done, if any: a
+ * track moves closer to the middle of the disk in place of one that is
+ * much colder. Only the migrator changes the heat, and the table only
+ * changes under the move lock. Called with it held.
+ *
+ * @param unit, int representing the disk unit
+ */
+void blockMigrateTurn(int unit) {
+    blockRemap* r = &blockRemaps[unit];
+    int mid = r->tracks / 2;
+
+    diskHeat(unit, r->now, DISK_MAXTRACKS);
+    for (int t = 0; t < r->tracks; t++) {
+        int l = r->where[t];
+        r->heat[l] = r->heat[l] / 2 + r->now[t] - r->seen[t];
+        r->seen[t] = r->now[t];
+    }
+
+    int hot = -1;
+    int cold = -1;
+    int gain = 0;
+    int coldDist = 0;
+    for (int h = 0; h < r->tracks; h++) {
+        int hotDist = r->map[h] > mid ? r->map[h] - mid : mid - r->map[h];
+
+        for (int c = 0; c < r->tracks; c++) {
+            int dist = r->map[c] > mid ? r->map[c] - mid : mid - r->map[c];
+            int g = r->heat[h] - r->heat[c];
+
+            if (dist >= hotDist || r->heat[h] < 2 * r->heat[c] + BLOCK_MIGRATE_MIN) {
+                continue;
+            }
+            if (g > gain || (g == gain && dist < coldDist)) {
+                hot = h;
+                cold = c;
+                gain = g;
+                coldDist = dist;
+            }
+        }
+    }
+
+    if (hot >= 0) {
+        blockMigrateSwap(unit, hot, cold);
+    }
+}
+
+/**
+ * Swaps the disk tracks of two logical tracks. Transfers on the disk are
+ * held off, and the ones already out are waited for, while the data
+ * moves. Once it has, the new table is saved before the one in memory
+ * changes; if it cannot be, the data is moved back. Whatever fails, the
+ * table ends up saying where the data really is. Called with the move
+ * lock held.
+ *
+ * @param unit, int representing the disk unit
+ * @param a, int representing one logical track
+ * @param b, int representing the other
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int blockMigrateSwap(int unit, int a, int b) {
+    blockRemap* r = &blockRemaps[unit];
+    int pa = r->map[a];
+    int pb = r->map[b];
+    int swapped = 0;
+
+    MboxSend(r->mutex, NULL, 0);
+    r->moving = 1;
+    int busy = r->users > 0;
+    MboxRecv(r->mutex, NULL, 0);
+    if (busy) {
+        MboxRecv(r->drained, NULL, 0);
+    }
+
+    int status = blockMigrateCopy(unit, pa, pb, &swapped);
+    if (swapped) {
+        int map[DISK_MAXTRACKS];
+        memcpy(map, r->map, sizeof(map));
+        map[a] = pb;
+        map[b] = pa;
+
+        int saved = blockRemapSave(unit, map);
+        if (saved != 0 && status == 0 &&
+            blockMigrateWrite(unit, pa, r->buf[0]) == 0 && blockMigrateWrite(unit, pb, r->buf[1]) == 0) {
+            // both tracks are home again, as the saved table says
+            swapped = 0;
+        }
+        if (status == 0) {
+            status = saved;
+        }
+    }
+    if (swapped) {
+        r->map[a] = pb;
+        r->map[b] = pa;
+        r->where[pa] = b;
+        r->where[pb] = a;
+    }
+
+    // the copy itself is not an access
+    diskHeat(unit, r->now, DISK_MAXTRACKS);
+    r->seen[pa] = r->now[pa];
+    r->seen[pb] = r->now[pb];
+
+    MboxSend(r->mutex, NULL, 0);
+    r->moving = 0;
+    int waiters = r->waiters;
+    r->waiters = 0;
+    MboxRecv(r->mutex, NULL, 0);
+
+    for (int i = 0; i < waiters; i++) {
+        MboxSend(r->gate, NULL, 0);
+    }
+    return status;
+}
+
+/**
+ * Exchanges the contents of two tracks of a disk: both are read, then
+ * each is written where the other was, one after the other. If the
+ * second write fails the first is undone from the buffer still held; if
+ * even that fails, the first track holds the second's data and the swap
+ * has to stand. The buffers keep what was read.
+ *
+ * @param unit, int representing the disk unit
+ * @param ta, int representing one track
+ * @param tb, int representing the other
+ * @param swapped, int* set to 1 if the data of the tracks changed places
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int blockMigrateCopy(int unit, int ta, int tb, int* swapped) {
+    blockRemap* r = &blockRemaps[unit];
+    diskRequest* reqs[2];
+    int status = 0;
+
+    *swapped = 0;
+    reqs[0] = diskSubmit(unit, ta, 0, USLOSS_DISK_TRACK_SIZE, r->buf[0], USLOSS_DISK_READ, 0);
+    reqs[1] = diskSubmit(unit, tb, 0, USLOSS_DISK_TRACK_SIZE, r->buf[1], USLOSS_DISK_READ, 0);
+    for (int i = 0; i < 2; i++) {
+        int done = reqs[i] == NULL ? -1 : diskReap(reqs[i]);
+        if (status == 0 && done != 0) {
+            status = done;
+        }
+    }
+    if (status != 0) {
+        return status;
+    }
+
+    status = blockMigrateWrite(unit, ta, r->buf[1]);
+    if (status != 0) {
+        return status;
+    }
+    // undone if it can be, otherwise the swap stands
+    status = blockMigrateWrite(unit, tb, r->buf[0]);
+    *swapped = status == 0 || blockMigrateWrite(unit, ta, r->buf[0]) != 0;
+    return status;
+}
+
+/**
+ * Writes a whole track of a disk and waits for it.
+ *
+ * @param unit, int representing the disk unit
+ * @param track, int representing the track
+ * @param buffer, void* representing the data
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int blockMigrateWrite(int unit, int track, void* buffer) {
+    diskRequest* req = diskSubmit(unit, track, 0, USLOSS_DISK_TRACK_SIZE, buffer, USLOSS_DISK_WRITE, 0);
+    return req == NULL ? -1 : diskReap(req);
+}
+
+/**
+ * Track migrator daemon. Woken every BLOCK_MIGRATE_PERIOD transfers on a
+ * migrating disk, it does a turn on each such disk. Its disk requests are
+ * in the idle class.
+ *
+ * @param arg, char* unused
+ *
+ * @return int never returns
+ */
+int blockMigratorMain(char* arg) {
+    diskSetClass(DISK_CLASS_IDLE);
+
+    while (1) {
+        MboxRecv(blockMigrateMbox, NULL, 0);
+
+        for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+            MboxSend(blockRemaps[unit].moveMutex, NULL, 0);
+            if (blockRemaps[unit].on) {
+                blockMigrateTurn(unit);
+            }
+            MboxRecv(blockRemaps[unit].moveMutex, NULL, 0);
+        }
+    }
+
+    return 0;
+}
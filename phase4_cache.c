@@ -0,0 +1,592 @@
+/**
+ * Sector cache for synchronous DiskReads, turned on per disk with
+ * DiskControl. A read whose sectors are all in the cache is copied out
+ * without going to the disk; otherwise it is read as usual and, if it is
+ * small, kept, least recently used going first. Any write to a disk drops
+ * its sectors from the cache, and a read that had a write to its disk
+ * start while it was out is not kept, so the cache never holds older data
+ * than the disk.
+ *
+ * A disk with the cache on also keeps a list of its sectors that were hit
+ * the most, in one sector on the track below the journal's; that track
+ * and the journal's are no longer part of the disk its users see. The
+ * list is written every CACHE_SAVE_PERIOD lookups, and whenever
+ * DiskControl turns the cache on again, so a caller can save it just
+ * before shutting down. When the system comes up the warmer daemon reads
+ * the lists back, which also turns the cache back on, and then reads the
+ * listed sectors into the cache in track order at idle priority, so the
+ * first reads after a restart already hit.
+ */
+
+// ----- Constants
+#define CACHE_SECTORS 128
+#define CACHE_MAXFILL 8                 // longest read that is kept
+#define CACHE_SAVE_PERIOD 256           // lookups between saves of the lists
+#define CACHE_LIST_TRACKS DISK_META_TRACKS // the list's track and the journal's
+#define CACHE_LIST_MAX 125              // blocks that fit in the list sector
+#define CACHE_MAGIC 0x484f5421
+#define CACHE_SECTOR USLOSS_DISK_SECTOR_SIZE
+
+// ----- Includes
+#include <phase1.h>
+#include <phase2.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+#include "phase4_internal.h"
+#include <usloss.h>
+#include <usyscall.h>
+#include <string.h>
+
+// ----- typedefs
+typedef struct cacheEntry cacheEntry;
+typedef struct cacheList cacheList;
+typedef struct cache cache;
+
+// ----- Structs
+
+struct cacheEntry {
+    int unit;                       // -1 if the entry is free
+    int block;                      // track * USLOSS_DISK_TRACK_SIZE + sector
+    int lastUse;
+    int hits;                       // reads it served
+    char data[CACHE_SECTOR];
+};
+
+struct cacheList {
+    int magic;                      // CACHE_MAGIC while the disk has a list
+    int count;
+    int sum;                        // checksum of the blocks
+    int blocks[CACHE_LIST_MAX];     // hottest first
+};
+
+struct cache {
+    int mutex;                      // guards the entries and counters
+    int readyMbox;                  // token passed around once lists are read
+    int ready;                      // the lists are read
+    int saveMbox;                   // wakes the warmer to save the lists
+    int saveMutex;                  // held while a list is written
+    int clock;
+    int lookups;                    // since the lists were last saved
+    int on[USLOSS_DISK_UNITS];      // the disk is cached and keeps a list
+    int gen[USLOSS_DISK_UNITS];     // bumped by every write to the disk
+    int hits[USLOSS_DISK_UNITS];
+    int misses[USLOSS_DISK_UNITS];
+    int prefetched[USLOSS_DISK_UNITS];
+    cacheEntry entries[CACHE_SECTORS];
+    cacheList lists[USLOSS_DISK_UNITS]; // as read when the system came up
+    cacheList saveBuf;              // the list being written
+    char buf[USLOSS_DISK_TRACK_SIZE * CACHE_SECTOR]; // the warmer's reads
+};
+
+// ----- Function Prototypes
+
+void cacheInit(void);
+void cacheStartDaemons(void);
+int cacheWarmerMain(char*);
+int cacheReserved(int);
+int cacheRead(int, int, int, int, void*);
+int cacheGen(int);
+void cacheFill(int, int, int, int, void*, int);
+int cacheKeep(int, int, int, void*, int, int);
+void cacheInvalidate(int, diskSegment*, int);
+int cacheEnable(int, int);
+void cacheStats(int, diskStats*);
+void cacheWaitReady(void);
+cacheEntry* cacheFind(int, int);
+int cacheSave(int);
+int cacheErase(int);
+void cacheLoadList(int);
+void cachePrefetch(int);
+int cacheListTrack(int);
+int cacheSum(cacheList*);
+
+// ----- Global data structures/vars
+cache blockCache;
+
+// ----- Phase 4 Bootload
+
+/**
+ * Called from phase4_init. Makes the locks; which disks are cached is
+ * only known once the warmer has read their lists.
+ */
+void cacheInit(void) {
+    blockCache.mutex = MboxCreate(1, 0);
+    blockCache.readyMbox = MboxCreate(1, 0);
+    blockCache.saveMbox = MboxCreate(1, 0);
+    blockCache.saveMutex = MboxCreate(1, 0);
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        blockCache.entries[i].unit = -1;
+    }
+}
+
+/**
+ * Called from phase4_start_service_processes, starts the warmer.
+ */
+void cacheStartDaemons(void) {
+    fork1("Cache Warmer", cacheWarmerMain, NULL, USLOSS_MIN_STACK, 2);
+}
+
+// ----- Daemon
+
+/**
+ * Cache warmer daemon. Reads the list of every disk and lets through
+ * whoever waited for them, then prefetches the listed sectors at idle
+ * priority. After that it saves the lists whenever it is woken.
+ *
+ * @param arg, char* unused
+ *
+ * @return int never returns
+ */
+int cacheWarmerMain(char* arg) {
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        cacheLoadList(unit);
+    }
+
+    blockCache.ready = 1;
+    MboxSend(blockCache.readyMbox, NULL, 0);
+
+    diskSetClass(DISK_CLASS_IDLE);
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        cachePrefetch(unit);
+    }
+
+    while (1) {
+        MboxRecv(blockCache.saveMbox, NULL, 0);
+
+        for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+            if (blockCache.on[unit]) {
+                cacheSave(unit);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// ----- Helpers
+
+/**
+ * Tells how many tracks at the end of a disk the cache keeps from its
+ * users. The journal's tracks are among them.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the number of tracks
+ */
+int cacheReserved(int unit) {
+    cacheWaitReady();
+    return blockCache.on[unit] ? CACHE_LIST_TRACKS : 0;
+}
+
+/**
+ * Serves a read from the cache if every sector of it is there. Every
+ * CACHE_SAVE_PERIOD lookups the warmer is woken to save the lists.
+ *
+ * @param unit, int representing the disk unit
+ * @param track, int representing the first track
+ * @param first, int representing the first sector
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing where to copy them
+ *
+ * @return int 1 if the read was served, 0 if it has to go to the disk
+ */
+int cacheRead(int unit, int track, int first, int sectors, void* buffer) {
+    int start = track * USLOSS_DISK_TRACK_SIZE + first;
+
+    if (!blockCache.on[unit] || start + sectors > diskUserTracks(unit) * USLOSS_DISK_TRACK_SIZE) {
+        return 0;
+    }
+
+    MboxSend(blockCache.mutex, NULL, 0);
+    int hit = 1;
+    for (int i = 0; i < sectors && hit; i++) {
+        hit = cacheFind(unit, start + i) != NULL;
+    }
+
+    if (hit) {
+        for (int i = 0; i < sectors; i++) {
+            cacheEntry* e = cacheFind(unit, start + i);
+            memcpy(buffer + i * CACHE_SECTOR, e->data, CACHE_SECTOR);
+            e->lastUse = ++blockCache.clock;
+            e->hits++;
+        }
+        blockCache.hits[unit]++;
+    } else {
+        blockCache.misses[unit]++;
+    }
+
+    int save = ++blockCache.lookups >= CACHE_SAVE_PERIOD;
+    if (save) {
+        blockCache.lookups = 0;
+    }
+    MboxRecv(blockCache.mutex, NULL, 0);
+
+    if (save) {
+        MboxCondSend(blockCache.saveMbox, NULL, 0);
+    }
+    return hit;
+}
+
+/**
+ * Tells how many writes a disk has had, for cacheFill to check.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the count
+ */
+int cacheGen(int unit) {
+    return blockCache.gen[unit];
+}
+
+/**
+ * Keeps what a read that missed brought in, if the disk is cached, the
+ * read was small, and no write to the disk started since it did.
+ *
+ * @param unit, int representing the disk unit
+ * @param track, int representing the first track
+ * @param first, int representing the first sector
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the data read
+ * @param gen, int representing cacheGen before the read was queued
+ */
+void cacheFill(int unit, int track, int first, int sectors, void* buffer, int gen) {
+    if (!blockCache.on[unit] || sectors > CACHE_MAXFILL) {
+        return;
+    }
+    cacheKeep(unit, track * USLOSS_DISK_TRACK_SIZE + first, sectors, buffer, gen, 0);
+}
+
+/**
+ * Puts sectors in the cache in place of the ones used longest ago,
+ * unless a write to the disk started since they were read.
+ *
+ * @param unit, int representing the disk unit
+ * @param start, int representing the first block
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the data
+ * @param gen, int representing cacheGen before the read was queued
+ * @param hits, int representing the hits a sector new to the cache starts
+ * with
+ *
+ * @return int the number of sectors kept
+ */
+int cacheKeep(int unit, int start, int sectors, void* buffer, int gen, int hits) {
+    int kept = 0;
+
+    MboxSend(blockCache.mutex, NULL, 0);
+
+    for (int i = 0; i < sectors && gen == blockCache.gen[unit]; i++) {
+        cacheEntry* e = cacheFind(unit, start + i);
+
+        if (e == NULL) {
+            e = &blockCache.entries[0];
+            for (int j = 1; j < CACHE_SECTORS && e->unit >= 0; j++) {
+                cacheEntry* cand = &blockCache.entries[j];
+                if (cand->unit < 0 || cand->lastUse < e->lastUse) {
+                    e = cand;
+                }
+            }
+            e->unit = unit;
+            e->block = start + i;
+            e->hits = hits;
+        }
+
+        memcpy(e->data, buffer + i * CACHE_SECTOR, CACHE_SECTOR);
+        e->lastUse = ++blockCache.clock;
+        kept++;
+    }
+
+    MboxRecv(blockCache.mutex, NULL, 0);
+    return kept;
+}
+
+/**
+ * Drops the sectors a write is about to change. Called for every write
+ * before it can reach the disk.
+ *
+ * @param unit, int representing the disk unit
+ * @param segs, diskSegment* representing the segments written
+ * @param nsegs, int representing the number of segments
+ */
+void cacheInvalidate(int unit, diskSegment* segs, int nsegs) {
+    MboxSend(blockCache.mutex, NULL, 0);
+
+    blockCache.gen[unit]++;
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        cacheEntry* e = &blockCache.entries[i];
+        if (e->unit != unit) {
+            continue;
+        }
+
+        for (int s = 0; s < nsegs; s++) {
+            int start = segs[s].track * USLOSS_DISK_TRACK_SIZE + segs[s].first;
+            if (e->block >= start && e->block < start + segs[s].count) {
+                e->unit = -1;
+                break;
+            }
+        }
+    }
+
+    MboxRecv(blockCache.mutex, NULL, 0);
+}
+
+/**
+ * Turns the cache of a disk on, which saves its list right away, or off,
+ * which erases the list and empties the cache of the disk. A disk that
+ * had it off already keeps its list track as it is, since that track is
+ * its users'.
+ *
+ * @param unit, int representing the disk unit
+ * @param on, int representing 1 to turn it on, 0 to turn it off
+ *
+ * @return int 0 on success, otherwise the disk status
+ */
+int cacheEnable(int unit, int on) {
+    cacheWaitReady();
+
+    if (diskGetTracks(unit) <= CACHE_LIST_TRACKS) {
+        return -1;
+    }
+
+    MboxSend(blockCache.mutex, NULL, 0);
+    int wasOn = blockCache.on[unit];
+    if (on) {
+        blockCache.on[unit] = 1;
+    }
+    MboxRecv(blockCache.mutex, NULL, 0);
+
+    if (on) {
+        return cacheSave(unit);
+    }
+    return wasOn ? cacheErase(unit) : 0;
+}
+
+/**
+ * Fills in the cache counters of a disk.
+ *
+ * @param unit, int representing the disk unit
+ * @param out, diskStats* representing where to put them
+ */
+void cacheStats(int unit, diskStats* out) {
+    out->cacheHits = blockCache.hits[unit];
+    out->cacheMisses = blockCache.misses[unit];
+    out->cachePrefetched = blockCache.prefetched[unit];
+}
+
+/**
+ * Blocks until the warmer has read the lists. Once it has this is a plain
+ * read; a caller that waits hands the token right back so every one of
+ * them gets through.
+ */
+void cacheWaitReady(void) {
+    if (blockCache.ready) {
+        return;
+    }
+
+    MboxRecv(blockCache.readyMbox, NULL, 0);
+    MboxSend(blockCache.readyMbox, NULL, 0);
+}
+
+/**
+ * Finds a sector in the cache. Called with the cache lock held.
+ *
+ * @param unit, int representing the disk unit
+ * @param block, int representing the sector
+ *
+ * @return cacheEntry* its entry, or NULL if it is not cached
+ */
+cacheEntry* cacheFind(int unit, int block) {
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        cacheEntry* e = &blockCache.entries[i];
+        if (e->unit == unit && e->block == block) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Writes the list of a disk: its cached sectors that were hit, hottest
+ * first. Nothing is written if the cache of the disk is off, as the list
+ * track is then its users'.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int cacheSave(int unit) {
+    cacheList* list = &blockCache.saveBuf;
+
+    MboxSend(blockCache.saveMutex, NULL, 0);
+    memset(list, 0, sizeof(*list));
+
+    MboxSend(blockCache.mutex, NULL, 0);
+    if (!blockCache.on[unit]) {
+        MboxRecv(blockCache.mutex, NULL, 0);
+        MboxRecv(blockCache.saveMutex, NULL, 0);
+        return 0;
+    }
+
+    list->magic = CACHE_MAGIC;
+
+    // insertion sort by hits, keeping the hottest CACHE_LIST_MAX
+    int hits[CACHE_LIST_MAX];
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        cacheEntry* e = &blockCache.entries[i];
+        if (e->unit != unit || e->hits == 0) {
+            continue;
+        }
+
+        int pos = list->count < CACHE_LIST_MAX ? list->count++ : CACHE_LIST_MAX;
+        while (pos > 0 && hits[pos - 1] < e->hits) {
+            if (pos < CACHE_LIST_MAX) {
+                hits[pos] = hits[pos - 1];
+                list->blocks[pos] = list->blocks[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < CACHE_LIST_MAX) {
+            hits[pos] = e->hits;
+            list->blocks[pos] = e->block;
+        }
+    }
+    list->sum = cacheSum(list);
+    MboxRecv(blockCache.mutex, NULL, 0);
+
+    diskRequest* req = diskSubmitRaw(unit, cacheListTrack(unit), 0, 1, list, USLOSS_DISK_WRITE);
+    int status = req == NULL ? -1 : diskReap(req);
+
+    MboxRecv(blockCache.saveMutex, NULL, 0);
+    return status;
+}
+
+/**
+ * Turns the cache of a disk off. The list is blanked while its track is
+ * still the cache's, so the cache stays off after a restart and no write
+ * of the disk's users is ever overwritten, then the cache of the disk is
+ * emptied.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int cacheErase(int unit) {
+    cacheList* list = &blockCache.saveBuf;
+
+    MboxSend(blockCache.saveMutex, NULL, 0);
+    memset(list, 0, sizeof(*list));
+
+    diskRequest* req = diskSubmitRaw(unit, cacheListTrack(unit), 0, 1, list, USLOSS_DISK_WRITE);
+    int status = req == NULL ? -1 : diskReap(req);
+
+    MboxSend(blockCache.mutex, NULL, 0);
+    blockCache.on[unit] = 0;
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        if (blockCache.entries[i].unit == unit) {
+            blockCache.entries[i].unit = -1;
+        }
+    }
+    MboxRecv(blockCache.mutex, NULL, 0);
+
+    MboxRecv(blockCache.saveMutex, NULL, 0);
+    return status;
+}
+
+/**
+ * Reads the list of a disk when the system comes up. A disk with a good
+ * list has its cache turned on.
+ *
+ * @param unit, int representing the disk unit
+ */
+void cacheLoadList(int unit) {
+    cacheList* list = &blockCache.lists[unit];
+
+    if (diskGetTracks(unit) <= CACHE_LIST_TRACKS) {
+        return;
+    }
+
+    diskRequest* req = diskSubmitRaw(unit, cacheListTrack(unit), 0, 1, list, USLOSS_DISK_READ);
+    int status = req == NULL ? -1 : diskReap(req);
+
+    if (status != 0 || list->magic != CACHE_MAGIC || list->count < 0 ||
+        list->count > CACHE_LIST_MAX || list->sum != cacheSum(list)) {
+        memset(list, 0, sizeof(*list));
+        return;
+    }
+
+    blockCache.on[unit] = 1;
+}
+
+/**
+ * Reads the sectors on the list of a disk into the cache. They are read
+ * in track order, and sectors next to each other on a track in one
+ * request. They count as hit once, so the next save keeps them listed.
+ *
+ * @param unit, int representing the disk unit
+ */
+void cachePrefetch(int unit) {
+    cacheList* list = &blockCache.lists[unit];
+    int end = diskUserTracks(unit) * USLOSS_DISK_TRACK_SIZE;
+
+    for (int i = 1; i < list->count; i++) {
+        int block = list->blocks[i];
+        int j = i;
+        while (j > 0 && list->blocks[j - 1] > block) {
+            list->blocks[j] = list->blocks[j - 1];
+            j--;
+        }
+        list->blocks[j] = block;
+    }
+
+    for (int i = 0; i < list->count; ) {
+        int start = list->blocks[i];
+        int n = 1;
+        while (i + n < list->count && list->blocks[i + n] == start + n &&
+               (start + n) % USLOSS_DISK_TRACK_SIZE != 0) {
+            n++;
+        }
+        i += n;
+
+        if (start < 0 || start + n > end) {
+            continue;
+        }
+
+        int gen = cacheGen(unit);
+        diskRequest* req = diskSubmit(unit, start / USLOSS_DISK_TRACK_SIZE,
+                                      start % USLOSS_DISK_TRACK_SIZE, n, blockCache.buf,
+                                      USLOSS_DISK_READ, 0);
+        if (req == NULL || diskReap(req) != 0) {
+            continue;
+        }
+
+        // a listed sector stays on the list until something hotter comes
+        blockCache.prefetched[unit] += cacheKeep(unit, start, n, blockCache.buf, gen, 1);
+    }
+}
+
+/**
+ * Tells which track of a disk holds its list.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the track
+ */
+int cacheListTrack(int unit) {
+    return diskGetTracks(unit) - CACHE_LIST_TRACKS;
+}
+
+/**
+ * Checksums the blocks of a list.
+ *
+ * @param list, cacheList* representing the list
+ *
+ * @return int the checksum
+ */
+int cacheSum(cacheList* list) {
+    unsigned int sum = list->count;
+
+    for (int i = 0; i < list->count && i < CACHE_LIST_MAX; i++) {
+        sum = sum * 31 + (unsigned int) list->blocks[i];
+    }
+    return (int) sum;
+}
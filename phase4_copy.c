@@ -0,0 +1,591 @@
+/**
+ * Copies between devices done inside the kernel, so the data never goes
+ * through a user buffer.
+ *
+ * DiskCopy moves a run of sectors from one disk to another, or within one
+ * disk, a track's worth at a time through a ring of kernel buffers. Reads
+ * of the next chunks are queued on the source daemon while the chunk
+ * before is being written by the destination daemon, so with two disks
+ * both arms are kept busy. A copy within one disk whose destination
+ * overlaps the source after its start is done from the end backwards, so
+ * every sector is read before it is written over.
+ *
+ * A splice moves bytes between a disk and a terminal. Each terminal has
+ * two workers, one sending disk data to its output and one storing its
+ * input lines on disk, so a splice returns at once with a handle and
+ * SpliceWait reports when it is over. A job slot is given back as soon
+ * as its splice is over and nobody is waiting for it, so an owner that
+ * never waits does not keep it; what it did can still be asked for until
+ * the slot is taken again. Both sides go a sector at a time
+ * through two buffers: the output worker reads the next sector while it
+ * types out the one before, and the input worker writes a sector out
+ * while it collects the lines of the next.
+ */
+
+// ----- Constants
+#define COPY_CHUNK USLOSS_DISK_TRACK_SIZE   // sectors per request
+#define COPY_BUFS 4                         // chunks in flight at once
+#define COPY_SECTOR USLOSS_DISK_SECTOR_SIZE
+#define SPLICE_MAXJOBS 16                   // splices going on at once
+#define SPLICE_GEN_MASK 0xfffff             // keeps gen * SPLICE_MAXJOBS + slot positive
+
+// ----- Includes
+#include <phase1.h>
+#include <phase2.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+#include "phase4_internal.h"
+#include <usloss.h>
+#include <usyscall.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// ----- typedefs
+typedef USLOSS_Sysargs sysArgs;
+typedef struct copyState copyState;
+typedef struct spliceJob spliceJob;
+typedef struct spliceWorker spliceWorker;
+typedef struct spliceState spliceState;
+
+// ----- Structs
+
+struct copyState {
+    int mutex;                          // one copy uses the buffers at a time
+    char buf[COPY_BUFS][COPY_CHUNK * COPY_SECTOR];
+};
+
+struct spliceJob {
+    int busy;                           // taken until the splice is over
+    int waiting;                        // the owner is blocked in SpliceWait
+    int pid;                            // owner
+    int gen;                            // bumped every time the slot is taken
+    int unit;
+    int track;
+    int first;
+    int bytes;
+    int term;
+    int count;                          // bytes moved
+    int status;
+    int doneMbox;                       // wakes the owner if it is waiting
+};
+
+struct spliceWorker {
+    int jobMbox;                        // slots of the jobs queued for it
+    char buf[2][COPY_SECTOR];
+};
+
+struct spliceState {
+    int mutex;                          // guards the job slots
+    int next;                           // where the search for a slot starts
+    spliceJob jobs[SPLICE_MAXJOBS];
+    spliceWorker out[USLOSS_TERM_UNITS];
+    spliceWorker in[USLOSS_TERM_UNITS];
+};
+
+// ----- Function Prototypes
+void copyInit(void);
+void diskCopyHandler(sysArgs*);
+int copyRun(diskCopyArgs*);
+int copyFits(int, int, int, int);
+diskRequest* copyChunk(int, int, int, int, int, int, int);
+void spliceStartDaemons(void);
+void spliceOutHandler(sysArgs*);
+void spliceInHandler(sysArgs*);
+void spliceWaitHandler(sysArgs*);
+void spliceStart(sysArgs*, int, int, int, int, int, int);
+int spliceWorkerMain(char*);
+void spliceOut(spliceWorker*, spliceJob*);
+void spliceIn(spliceWorker*, spliceJob*);
+int spliceFlush(spliceJob*, diskRequest**, char*, int);
+
+// ----- Global data structures/vars
+copyState copy;
+spliceState splice;
+
+// ----- Phase 4 Bootload
+
+/**
+ * Called from phase4_init.
+ */
+void copyInit(void) {
+    copy.mutex = MboxCreate(1, 0);
+
+    splice.mutex = MboxCreate(1, 0);
+    splice.next = 0;
+    for (int i = 0; i < SPLICE_MAXJOBS; i++) {
+        splice.jobs[i].busy = 0;
+        splice.jobs[i].waiting = 0;
+        splice.jobs[i].pid = -1;
+        splice.jobs[i].gen = 0;
+        splice.jobs[i].doneMbox = MboxCreate(1, 0);
+    }
+    for (int i = 0; i < USLOSS_TERM_UNITS; i++) {
+        splice.out[i].jobMbox = MboxCreate(SPLICE_MAXJOBS, sizeof(int));
+        splice.in[i].jobMbox = MboxCreate(SPLICE_MAXJOBS, sizeof(int));
+    }
+}
+
+/**
+ * Called from phase4_start_service_processes, starts the output and the
+ * input splice worker of every terminal.
+ */
+void spliceStartDaemons(void) {
+    for (int i = 0; i < 2 * USLOSS_TERM_UNITS; i++) {
+        char id[10];
+        sprintf(id, "%d", i);
+
+        char name[20];
+        sprintf(name, "Splice %s %d", i < USLOSS_TERM_UNITS ? "Out" : "In",
+                i % USLOSS_TERM_UNITS);
+
+        fork1(name, spliceWorkerMain, id, USLOSS_MIN_STACK, 2);
+    }
+}
+
+// ----- Syscall Handlers
+
+/**
+ * Copies count sectors from (srcUnit, srcTrack, srcSector) to (dstUnit,
+ * dstTrack, dstSector). The arguments come in a diskCopyArgs, as there
+ * are more of them than fit in the syscall. The status is that of the
+ * first request that failed, or 0.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void diskCopyHandler(sysArgs* args) {
+    kernelCheck("diskCopyHandler");
+
+    diskCopyArgs* copyArgs = args->arg1;
+
+    if (copyArgs == NULL || copyArgs->count <= 0 ||
+        !copyFits(copyArgs->srcUnit, copyArgs->srcTrack, copyArgs->srcSector, copyArgs->count) ||
+        !copyFits(copyArgs->dstUnit, copyArgs->dstTrack, copyArgs->dstSector, copyArgs->count)) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    MboxSend(copy.mutex, NULL, 0);
+    args->arg1 = (void*)(long)copyRun(copyArgs);
+    MboxRecv(copy.mutex, NULL, 0);
+
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Starts a splice of bytes from the disk, starting at (unit, track,
+ * first), to a terminal. Returns a handle for SpliceWait.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void spliceOutHandler(sysArgs* args) {
+    kernelCheck("spliceOutHandler");
+    spliceStart(args, 0, (int)(long)args->arg1, (int)(long)args->arg2, (int)(long)args->arg3,
+                (int)(long)args->arg4, (int)(long)args->arg5);
+}
+
+/**
+ * Starts a splice of bytes of input lines from a terminal to the disk,
+ * starting at (unit, track, first). A line that does not fit is cut
+ * short, and the last sector is padded with zeros. Returns a handle for
+ * SpliceWait.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void spliceInHandler(sysArgs* args) {
+    kernelCheck("spliceInHandler");
+    spliceStart(args, 1, (int)(long)args->arg1, (int)(long)args->arg2, (int)(long)args->arg3,
+                (int)(long)args->arg4, (int)(long)args->arg5);
+}
+
+/**
+ * Blocks until a splice the caller started is over, then gives back the
+ * bytes it moved and the status of its disk requests. A splice that is
+ * already over answers at once, as long as its slot was not taken again.
+ * Each splice can be waited for once.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void spliceWaitHandler(sysArgs* args) {
+    kernelCheck("spliceWaitHandler");
+
+    int handle = (int)(long)args->arg1;
+    spliceJob* job = &splice.jobs[(handle < 0 ? 0 : handle) % SPLICE_MAXJOBS];
+
+    MboxSend(splice.mutex, NULL, 0);
+    if (handle < 0 || job->pid != getpid() || job->gen != handle / SPLICE_MAXJOBS) {
+        MboxRecv(splice.mutex, NULL, 0);
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    // the worker posts here once it is done with the job, and leaves the
+    // slot to us to give back
+    if (job->busy) {
+        job->waiting = 1;
+        MboxRecv(splice.mutex, NULL, 0);
+        MboxRecv(job->doneMbox, NULL, 0);
+        MboxSend(splice.mutex, NULL, 0);
+        job->waiting = 0;
+        job->busy = 0;
+    }
+
+    args->arg1 = (void*)(long)job->count;
+    args->arg2 = (void*)(long)job->status;
+    args->arg4 = (void*)(long)0;
+
+    // a splice is waited for once
+    job->pid = -1;
+    MboxRecv(splice.mutex, NULL, 0);
+}
+
+// ----- Daemon
+
+/**
+ * Splice worker of one terminal and direction. Takes the jobs queued for
+ * it one after the other. A job whose owner is waiting is handed over to
+ * it once it is over, any other job gives its slot back right away.
+ *
+ * @param arg, char* representing the worker, the terminal for the output
+ * workers and USLOSS_TERM_UNITS more for the input ones
+ *
+ * @return int never returns
+ */
+int spliceWorkerMain(char* arg) {
+    int id = atoi(arg);
+    int in = id >= USLOSS_TERM_UNITS;
+    spliceWorker* worker = in ? &splice.in[id % USLOSS_TERM_UNITS] : &splice.out[id];
+
+    while (1) {
+        int slot;
+        MboxRecv(worker->jobMbox, &slot, sizeof(int));
+
+        spliceJob* job = &splice.jobs[slot];
+        if (in) {
+            spliceIn(worker, job);
+        } else {
+            spliceOut(worker, job);
+        }
+
+        MboxSend(splice.mutex, NULL, 0);
+        if (job->waiting) {
+            MboxSend(job->doneMbox, NULL, 0);
+        } else {
+            job->busy = 0;
+        }
+        MboxRecv(splice.mutex, NULL, 0);
+    }
+
+    return 0;
+}
+
+// ----- Helpers
+
+/**
+ * Runs a copy through the buffer ring. Chunk i always goes through buffer
+ * i % COPY_BUFS; before the read of a chunk is queued the write that last
+ * used its buffer is collected, and a chunk is written as soon as its
+ * read is back. The copy stops queueing at the first failure, but every
+ * request already queued is still collected.
+ *
+ * @param a, diskCopyArgs* representing the copy, already checked
+ *
+ * @return int the status of the first failed request, 0 if none failed
+ */
+int copyRun(diskCopyArgs* a) {
+    diskRequest* reads[COPY_BUFS];
+    diskRequest* writes[COPY_BUFS];
+    int src = a->srcTrack * USLOSS_DISK_TRACK_SIZE + a->srcSector;
+    int dst = a->dstTrack * USLOSS_DISK_TRACK_SIZE + a->dstSector;
+    int chunks = (a->count + COPY_CHUNK - 1) / COPY_CHUNK;
+    int backwards = a->srcUnit == a->dstUnit && dst > src && dst < src + a->count;
+    int status = 0;
+    int next = 0;
+    int done = 0;
+
+    for (int b = 0; b < COPY_BUFS; b++) {
+        reads[b] = NULL;
+        writes[b] = NULL;
+    }
+
+    while (done < chunks && status == 0) {
+        // keep the source busy with reads of the chunks ahead
+        while (next < chunks && next - done < COPY_BUFS && status == 0) {
+            int b = next % COPY_BUFS;
+
+            if (writes[b] != NULL) {
+                status = diskReap(writes[b]);
+                writes[b] = NULL;
+                if (status != 0) {
+                    break;
+                }
+            }
+
+            reads[b] = copyChunk(a->srcUnit, src, a->count, chunks, next, backwards, USLOSS_DISK_READ);
+            if (reads[b] == NULL) {
+                status = -1;
+                break;
+            }
+            next++;
+        }
+
+        if (status != 0) {
+            break;
+        }
+
+        // hand the oldest chunk to the destination once it is in
+        int b = done % COPY_BUFS;
+        status = diskReap(reads[b]);
+        reads[b] = NULL;
+        if (status != 0) {
+            break;
+        }
+
+        writes[b] = copyChunk(a->dstUnit, dst, a->count, chunks, done, backwards, USLOSS_DISK_WRITE);
+        if (writes[b] == NULL) {
+            status = -1;
+            break;
+        }
+        done++;
+    }
+
+    // collect whatever is still out
+    for (int b = 0; b < COPY_BUFS; b++) {
+        if (reads[b] != NULL) {
+            diskReap(reads[b]);
+        }
+        if (writes[b] != NULL) {
+            int st = diskReap(writes[b]);
+            if (status == 0) {
+                status = st;
+            }
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Queues the transfer of the i-th chunk of a copy on one side, to or from
+ * the buffer it goes through. Going backwards the first chunk is the one
+ * at the end of the run, which may be short.
+ *
+ * @param unit, int representing the disk of this side
+ * @param start, int representing the first sector of the run on that disk
+ * @param count, int representing the length of the run
+ * @param chunks, int representing the number of chunks in the run
+ * @param i, int representing the chunk, in the order they are copied
+ * @param backwards, int representing if the copy goes from the end
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ *
+ * @return diskRequest* the queued request, or NULL if no slot was free
+ */
+diskRequest* copyChunk(int unit, int start, int count, int chunks, int i, int backwards, int op) {
+    int index = backwards ? chunks - 1 - i : i;
+    int offset = index * COPY_CHUNK;
+    int sectors = count - offset < COPY_CHUNK ? count - offset : COPY_CHUNK;
+    int block = start + offset;
+
+    return diskSubmit(unit, block / USLOSS_DISK_TRACK_SIZE, block % USLOSS_DISK_TRACK_SIZE,
+                      sectors, copy.buf[i % COPY_BUFS], op, 0);
+}
+
+/**
+ * Tells if a run of sectors is a valid place on a disk and lies within
+ * the tracks its users may reach.
+ *
+ * @param unit, int representing the disk
+ * @param track, int representing the first track
+ * @param first, int representing the first sector on that track
+ * @param count, int representing the number of sectors
+ *
+ * @return int 1 if it fits, 0 otherwise
+ */
+int copyFits(int unit, int track, int first, int count) {
+    if (diskCheckArgs(unit, track, first) < 0) {
+        return 0;
+    }
+
+    long end = (long) track * USLOSS_DISK_TRACK_SIZE + first + count;
+    return end <= (long) diskUserTracks(unit) * USLOSS_DISK_TRACK_SIZE;
+}
+
+/**
+ * Checks the arguments of a splice, takes a job slot for it and queues it
+ * for the worker of its terminal and direction.
+ *
+ * @param args, sysArgs* representing the syscall, to return the handle in
+ * @param in, int representing if it goes from the terminal to the disk
+ * @param unit, int representing the disk
+ * @param track, int representing the first track on the disk
+ * @param first, int representing the first sector on that track
+ * @param bytes, int representing how many bytes to move
+ * @param term, int representing the terminal
+ */
+void spliceStart(sysArgs* args, int in, int unit, int track, int first, int bytes, int term) {
+    if (bytes <= 0 || !copyFits(unit, track, first, (bytes + COPY_SECTOR - 1) / COPY_SECTOR) ||
+        term < 0 || term >= USLOSS_TERM_UNITS) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    // slots are taken in turn, so what a finished splice did stays around
+    // for as long as possible
+    MboxSend(splice.mutex, NULL, 0);
+    int slot = -1;
+    for (int i = 0; i < SPLICE_MAXJOBS && slot < 0; i++) {
+        int s = (splice.next + i) % SPLICE_MAXJOBS;
+        if (!splice.jobs[s].busy) {
+            slot = s;
+        }
+    }
+    if (slot < 0) {
+        MboxRecv(splice.mutex, NULL, 0);
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+    splice.next = (slot + 1) % SPLICE_MAXJOBS;
+
+    spliceJob* job = &splice.jobs[slot];
+    job->busy = 1;
+    job->waiting = 0;
+    job->pid = getpid();
+    job->gen = (job->gen + 1) & SPLICE_GEN_MASK;
+    job->unit = unit;
+    job->track = track;
+    job->first = first;
+    job->bytes = bytes;
+    job->term = term;
+    job->count = 0;
+    job->status = 0;
+    int handle = job->gen * SPLICE_MAXJOBS + slot;
+    MboxRecv(splice.mutex, NULL, 0);
+
+    MboxSend(in ? splice.in[term].jobMbox : splice.out[term].jobMbox, &slot, sizeof(int));
+
+    args->arg1 = (void*)(long)handle;
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Sends the bytes of a job from the disk to its terminal. The terminal's
+ * output is held the whole time, so the bytes come out together as with
+ * a TermWrite.
+ *
+ * @param worker, spliceWorker* representing the output worker
+ * @param job, spliceJob* representing the splice
+ */
+void spliceOut(spliceWorker* worker, spliceJob* job) {
+    int block = job->track * USLOSS_DISK_TRACK_SIZE + job->first;
+    int sectors = (job->bytes + COPY_SECTOR - 1) / COPY_SECTOR;
+
+    termWriteLock(job->term);
+
+    diskRequest* req = diskSubmit(job->unit, block / USLOSS_DISK_TRACK_SIZE,
+                                  block % USLOSS_DISK_TRACK_SIZE, 1, worker->buf[0], USLOSS_DISK_READ, 0);
+    for (int i = 0; i < sectors; i++) {
+        job->status = req == NULL ? -1 : diskReap(req);
+        req = NULL;
+        if (job->status != 0) {
+            break;
+        }
+
+        // read the next sector while this one is typed out
+        if (i + 1 < sectors) {
+            int next = block + i + 1;
+            req = diskSubmit(job->unit, next / USLOSS_DISK_TRACK_SIZE, next % USLOSS_DISK_TRACK_SIZE,
+                             1, worker->buf[(i + 1) % 2], USLOSS_DISK_READ, 0);
+        }
+
+        int len = job->bytes - job->count < COPY_SECTOR ? job->bytes - job->count : COPY_SECTOR;
+        termWriteChars(job->term, worker->buf[i % 2], len);
+        job->count += len;
+    }
+
+    termWriteUnlock(job->term);
+}
+
+/**
+ * Stores input lines of a job's terminal on the disk until it has its
+ * bytes. Each sector is written once it is full, while the lines of the
+ * next one are collected in the other buffer.
+ *
+ * @param worker, spliceWorker* representing the input worker
+ * @param job, spliceJob* representing the splice
+ */
+void spliceIn(spliceWorker* worker, spliceJob* job) {
+    int block = job->track * USLOSS_DISK_TRACK_SIZE + job->first;
+    diskRequest* req = NULL;
+    char line[MAXLINE];
+    int cur = 0;
+    int fill = 0;
+
+    while (job->count < job->bytes && job->status == 0) {
+        int len = termReadLine(job->term, line);
+        if (len > job->bytes - job->count) {
+            len = job->bytes - job->count;
+        }
+
+        for (int i = 0; i < len && job->status == 0; ) {
+            int n = len - i < COPY_SECTOR - fill ? len - i : COPY_SECTOR - fill;
+            memcpy(worker->buf[cur] + fill, line + i, n);
+            fill += n;
+            i += n;
+
+            if (fill == COPY_SECTOR) {
+                job->status = spliceFlush(job, &req, worker->buf[cur], block++);
+                cur = 1 - cur;
+                fill = 0;
+            }
+        }
+        job->count += len;
+    }
+
+    if (job->status == 0 && fill > 0) {
+        memset(worker->buf[cur] + fill, 0, COPY_SECTOR - fill);
+        job->status = spliceFlush(job, &req, worker->buf[cur], block);
+    }
+
+    if (req != NULL) {
+        int status = diskReap(req);
+        if (job->status == 0) {
+            job->status = status;
+        }
+    }
+}
+
+/**
+ * Queues the write of a full buffer of an input splice, after collecting
+ * the write before it, whose buffer is the one filled next.
+ *
+ * @param job, spliceJob* representing the splice
+ * @param req, diskRequest** representing the write in flight, replaced
+ * @param buffer, char* representing the sector to write
+ * @param block, int representing where it goes on the disk
+ *
+ * @return int the status of the write before, or -1 if no slot was free
+ */
+int spliceFlush(spliceJob* job, diskRequest** req, char* buffer, int block) {
+    int status = *req == NULL ? 0 : diskReap(*req);
+
+    *req = NULL;
+    if (status != 0) {
+        return status;
+    }
+
+    *req = diskSubmit(job->unit, block / USLOSS_DISK_TRACK_SIZE, block % USLOSS_DISK_TRACK_SIZE,
+                      1, buffer, USLOSS_DISK_WRITE, 0);
+    return *req == NULL ? -1 : 0;
+}
@@ -0,0 +1,738 @@
+/**
+ * Flat file store on disk FILE_UNIT. DiskControl sets aside a region of
+ * tracks for it right below the journal's and the cache list's, which the
+ * disk's users no longer see. Every file is one extent, a run of
+ * consecutive sectors, so reading a file front to back is a single sweep
+ * of the head and one disk request per call. The last FILE_META sectors
+ * of the region hold the superblock, which gives the size of the region,
+ * and the inode table; since the region ends at the same place whatever
+ * its size, they are found again when the system comes up. Both are kept
+ * in memory and written through whenever they change.
+ *
+ * A file is created with the room its caller expects it to need. A write
+ * past that grows the extent in place if the sectors after it are free,
+ * and otherwise moves the file to a free run twice as long.
+ */
+
+// ----- Constants
+#define FILE_UNIT 1
+#define FILE_META 3                 // superblock, then the inode table
+#define FILE_MAXBLOCKS 2048
+#define FILE_MAGIC 0x46494c45
+#define FILE_SECTOR USLOSS_DISK_SECTOR_SIZE
+
+// ----- Includes
+#include <phase1.h>
+#include <phase2.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+#include "phase4_internal.h"
+#include <usloss.h>
+#include <usyscall.h>
+#include <string.h>
+
+// ----- typedefs
+typedef USLOSS_Sysargs sysArgs;
+typedef struct fileSuper fileSuper;
+typedef struct fileInode fileInode;
+typedef struct fileStore fileStore;
+
+// ----- Structs
+
+struct fileSuper {
+    int magic;                      // FILE_MAGIC once formatted
+    int nblocks;                    // sectors in the region, metadata included
+    int sum;                        // checksum of all metadata sectors
+    unsigned char bitmap[FILE_MAXBLOCKS / 8]; // set for a used sector
+};
+
+struct fileInode {
+    char name[FILE_NAMELEN];
+    int used;
+    int start;                      // first sector of the extent
+    int blocks;                     // sectors in the extent
+    int size;                       // bytes written so far
+};
+
+struct fileStore {
+    int mutex;                      // held for the whole of any call
+    int probeMutex;                 // held while the metadata is first read
+    int probed;                     // metadata read
+    int present;                    // the region is set aside
+    char meta[FILE_META * FILE_SECTOR]; // superblock and inodes, as on disk
+    fileSuper* super;
+    fileInode* inodes;
+    char bounce[2][FILE_SECTOR];    // partial sectors at either end
+    char moveBuf[USLOSS_DISK_TRACK_SIZE * FILE_SECTOR];
+};
+
+// ----- Function Prototypes
+
+void fileInit(void);
+void fileCreateHandler(sysArgs*);
+void fileOpenHandler(sysArgs*);
+void fileIOHandler(sysArgs*);
+int fileReserved(int);
+int fileEnable(int, int);
+int fileProbe(void);
+int fileSetup(void);
+int fileLookup(char*);
+int fileNameOk(char*);
+int fileAlloc(int);
+void fileMark(int, int, int);
+int fileIsFree(int, int);
+int fileGrow(fileInode*, int);
+int fileIO(fileInode*, int, int, void*, int);
+int fileRun(diskSegment*, int, int);
+int fileMetaSeg(diskSegment*);
+int fileWriteMeta(void);
+int fileSum(void);
+int fileTop(void);
+int fileDisk(diskSegment*, int, int);
+
+// ----- Global data structures/vars
+fileStore files;
+
+// ----- Phase 4 Bootload
+
+/**
+ * Called from phase4_init. The metadata is loaded on first use, once the
+ * geometry of the disk is known.
+ */
+void fileInit(void) {
+    files.mutex = MboxCreate(1, 0);
+    files.probeMutex = MboxCreate(1, 0);
+    files.super = (fileSuper*) files.meta;
+    files.inodes = (fileInode*)(files.meta + FILE_SECTOR);
+}
+
+// ----- Syscall Handlers
+
+/**
+ * Creates a file with room for a given number of bytes, in one extent. An
+ * existing file of the same name is emptied and gets a new extent.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void fileCreateHandler(sysArgs* args) {
+    kernelCheck("fileCreateHandler");
+
+    char* name = args->arg1;
+    int bytes = (int)(long) args->arg2;
+
+    if (!fileNameOk(name) || bytes < 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    MboxSend(files.mutex, NULL, 0);
+    if (fileSetup() != 0) {
+        MboxRecv(files.mutex, NULL, 0);
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    int fd = fileLookup(name);
+    if (fd >= 0) {
+        fileMark(files.inodes[fd].start, files.inodes[fd].blocks, 0);
+    } else {
+        for (int i = 0; i < FILE_MAXFILES && fd < 0; i++) {
+            if (!files.inodes[i].used) {
+                fd = i;
+            }
+        }
+    }
+
+    int blocks = (bytes + FILE_SECTOR - 1) / FILE_SECTOR;
+    int start = blocks > 0 ? fileAlloc(blocks) : 0;
+    if (fd < 0 || start < 0) {
+        // a file that was there keeps its name but not its old extent
+        if (fd >= 0 && files.inodes[fd].used) {
+            files.inodes[fd].blocks = 0;
+            files.inodes[fd].size = 0;
+            fileWriteMeta();
+        }
+        MboxRecv(files.mutex, NULL, 0);
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    fileInode* ino = &files.inodes[fd];
+    memset(ino, 0, sizeof(*ino));
+    strcpy(ino->name, name);
+    ino->used = 1;
+    ino->start = start;
+    ino->blocks = blocks;
+    ino->size = 0;
+    fileMark(start, blocks, 1);
+
+    int status = fileWriteMeta();
+    MboxRecv(files.mutex, NULL, 0);
+
+    args->arg1 = (void*)(long) fd;
+    args->arg4 = (void*)(long)(status == 0 ? 0 : -1);
+}
+
+/**
+ * Looks a file up by name.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void fileOpenHandler(sysArgs* args) {
+    kernelCheck("fileOpenHandler");
+
+    char* name = args->arg1;
+
+    if (!fileNameOk(name)) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    MboxSend(files.mutex, NULL, 0);
+    int fd = fileSetup() == 0 ? fileLookup(name) : -1;
+    int size = fd >= 0 ? files.inodes[fd].size : 0;
+    MboxRecv(files.mutex, NULL, 0);
+
+    if (fd < 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    args->arg1 = (void*)(long) fd;
+    args->arg2 = (void*)(long) size;
+    args->arg4 = (void*)(long)0;
+}
+
+/**
+ * Reads or writes bytes of a file at an offset. A read stops at the end
+ * of the file; a write past it makes the file longer.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void fileIOHandler(sysArgs* args) {
+    kernelCheck("fileIOHandler");
+
+    void* buffer = args->arg1;
+    int bytes = (int)(long) args->arg2;
+    int offset = (int)(long) args->arg3;
+    int fd = (int)(long) args->arg4;
+    int op = (int)(long) args->arg5;
+
+    // in long, so a huge count cannot wrap round past the store
+    if (fd < 0 || fd >= FILE_MAXFILES || bytes < 0 || offset < 0 ||
+        (op != FILE_OP_READ && op != FILE_OP_WRITE) ||
+        (op == FILE_OP_WRITE && (long) offset + bytes > (long) FILE_MAXBLOCKS * FILE_SECTOR)) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    MboxSend(files.mutex, NULL, 0);
+    fileInode* ino = &files.inodes[fd];
+    if (fileSetup() != 0 || !ino->used) {
+        MboxRecv(files.mutex, NULL, 0);
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    int status = 0;
+    if (op == FILE_OP_READ) {
+        if (offset >= ino->size) {
+            bytes = 0;
+        } else if ((long) offset + bytes > ino->size) {
+            bytes = ino->size - offset;
+        }
+        if (bytes > 0) {
+            status = fileIO(ino, offset, bytes, buffer, USLOSS_DISK_READ);
+        }
+    } else if (bytes > 0) {
+        int blocks = (offset + bytes + FILE_SECTOR - 1) / FILE_SECTOR;
+        status = blocks > ino->blocks ? fileGrow(ino, blocks) : 0;
+        if (status == 0) {
+            status = fileIO(ino, offset, bytes, buffer, USLOSS_DISK_WRITE);
+        }
+    }
+    MboxRecv(files.mutex, NULL, 0);
+
+    if (status != 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    args->arg1 = (void*)(long) bytes;
+    args->arg4 = (void*)(long)0;
+}
+
+// ----- Helpers
+
+/**
+ * Tells how many tracks at the end of a disk the store keeps from its
+ * users, counting the journal's and the cache list's below which it sits.
+ * The metadata is read the first time this is asked; after that it is a
+ * plain read.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the number of tracks, 0 if the disk has no store
+ */
+int fileReserved(int unit) {
+    if (unit != FILE_UNIT) {
+        return 0;
+    }
+
+    if (!files.probed) {
+        MboxSend(files.probeMutex, NULL, 0);
+        if (!files.probed) {
+            fileProbe();
+        }
+        MboxRecv(files.probeMutex, NULL, 0);
+    }
+
+    if (!files.present) {
+        return 0;
+    }
+    return DISK_META_TRACKS + files.super->nblocks / USLOSS_DISK_TRACK_SIZE;
+}
+
+/**
+ * Sets aside a region of tracks for the store, or gives it back. A new
+ * region is formatted empty; one that is already there is kept if it has
+ * the size asked for. Giving it back erases the superblock, so every file
+ * is gone for good, and the tracks are the users' again.
+ *
+ * @param unit, int representing the disk unit, only FILE_UNIT has a store
+ * @param tracks, int representing the size of the region, 0 to give it back
+ *
+ * @return int 0 on success, -1 if the size does not fit or differs from
+ * the region already there, otherwise the disk status
+ */
+int fileEnable(int unit, int tracks) {
+    if (unit != FILE_UNIT) {
+        return -1;
+    }
+    fileReserved(unit);
+
+    MboxSend(files.mutex, NULL, 0);
+    int status = 0;
+    int nblocks = tracks * USLOSS_DISK_TRACK_SIZE;
+
+    if (tracks == 0) {
+        if (files.present) {
+            // erased while the region is still ours, then handed back
+            memset(files.meta, 0, sizeof(files.meta));
+            status = fileWriteMeta();
+            files.present = 0;
+        }
+    } else if (files.present) {
+        status = files.super->nblocks == nblocks ? 0 : -1;
+    } else if (nblocks > FILE_MAXBLOCKS || tracks + DISK_META_TRACKS >= diskGetTracks(unit) ||
+               blockReserved(unit) > 0) {
+        // the migrator may have moved tracks of the volumes there
+        status = -1;
+    } else {
+        // users are kept out of the region before it is written
+        memset(files.meta, 0, sizeof(files.meta));
+        files.super->magic = FILE_MAGIC;
+        files.super->nblocks = nblocks;
+        fileMark(nblocks - FILE_META, FILE_META, 1);
+        files.present = 1;
+
+        status = fileWriteMeta();
+        if (status != 0) {
+            files.present = 0;
+        }
+    }
+    MboxRecv(files.mutex, NULL, 0);
+
+    return status;
+}
+
+/**
+ * Reads the metadata of the store's region, if the disk has one. A disk
+ * whose metadata cannot be read has no store.
+ *
+ * @return int 0 on success, otherwise the disk status
+ */
+int fileProbe(void) {
+    diskSegment seg;
+    int top = fileTop();
+    int status = -1;
+
+    if (top >= FILE_META) {
+        fileMetaSeg(&seg);
+        status = fileDisk(&seg, 1, USLOSS_DISK_READ);
+    }
+
+    int nblocks = files.super->nblocks;
+    files.present = status == 0 && files.super->magic == FILE_MAGIC && files.super->sum == fileSum() &&
+                    nblocks > FILE_META && nblocks <= FILE_MAXBLOCKS && nblocks <= top &&
+                    nblocks % USLOSS_DISK_TRACK_SIZE == 0;
+    files.probed = 1;
+
+    return status;
+}
+
+/**
+ * Makes sure the metadata is loaded before the store is used. Called with
+ * the store lock held.
+ *
+ * @return int 0 on success, -1 if the disk has no store
+ */
+int fileSetup(void) {
+    return fileReserved(FILE_UNIT) > 0 ? 0 : -1;
+}
+
+/**
+ * Finds a file by name.
+ *
+ * @param name, char* representing the name
+ *
+ * @return int the inode number, or -1 if there is no such file
+ */
+int fileLookup(char* name) {
+    for (int i = 0; i < FILE_MAXFILES; i++) {
+        if (files.inodes[i].used && strcmp(files.inodes[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Checks a file name: not empty, and short enough to fit an inode.
+ *
+ * @param name, char* representing the name
+ *
+ * @return int 1 if it is usable, else 0
+ */
+int fileNameOk(char* name) {
+    return name != NULL && name[0] != '\0' && strlen(name) < FILE_NAMELEN;
+}
+
+/**
+ * Finds the smallest run of free sectors that holds a number of them, so
+ * the big runs stay whole for big files.
+ *
+ * @param blocks, int representing how many sectors are needed
+ *
+ * @return int the first sector of the run, or -1 if no run is long enough
+ */
+int fileAlloc(int blocks) {
+    int best = -1;
+    int bestLen = 0;
+    int nblocks = files.super->nblocks;
+
+    for (int b = 0; b < nblocks; ) {
+        if (!fileIsFree(b, 1)) {
+            b++;
+            continue;
+        }
+
+        int len = 0;
+        while (b + len < nblocks && fileIsFree(b + len, 1)) {
+            len++;
+        }
+        if (len >= blocks && (best < 0 || len < bestLen)) {
+            best = b;
+            bestLen = len;
+        }
+        b += len;
+    }
+
+    return best;
+}
+
+/**
+ * Marks a run of sectors used or free in the bitmap.
+ *
+ * @param start, int representing the first sector
+ * @param blocks, int representing the number of sectors
+ * @param used, int representing if they are used
+ */
+void fileMark(int start, int blocks, int used) {
+    for (int b = start; b < start + blocks; b++) {
+        if (used) {
+            files.super->bitmap[b / 8] |= 1 << (b % 8);
+        } else {
+            files.super->bitmap[b / 8] &= ~(1 << (b % 8));
+        }
+    }
+}
+
+/**
+ * Tells if every sector of a run is free and on the store.
+ *
+ * @param start, int representing the first sector
+ * @param blocks, int representing the number of sectors
+ *
+ * @return int 1 if they are all free, else 0
+ */
+int fileIsFree(int start, int blocks) {
+    if (start + blocks > files.super->nblocks) {
+        return 0;
+    }
+    for (int b = start; b < start + blocks; b++) {
+        if (files.super->bitmap[b / 8] & (1 << (b % 8))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Makes the extent of a file at least a number of sectors long. It grows
+ * in place if it can; otherwise the file moves, a track at a time, to a
+ * free run twice as long as it was so it does not have to move again
+ * soon.
+ *
+ * @param ino, fileInode* representing the file
+ * @param blocks, int representing the sectors it needs
+ *
+ * @return int 0 on success, -1 if the disk is too full, otherwise the
+ * disk status
+ */
+int fileGrow(fileInode* ino, int blocks) {
+    int extra = blocks - ino->blocks;
+
+    if (fileIsFree(ino->start + ino->blocks, extra)) {
+        fileMark(ino->start + ino->blocks, extra, 1);
+        ino->blocks = blocks;
+        return fileWriteMeta();
+    }
+
+    int want = blocks > 2 * ino->blocks ? blocks : 2 * ino->blocks;
+    int start = fileAlloc(want);
+    if (start < 0) {
+        want = blocks;
+        start = fileAlloc(want);
+    }
+    if (start < 0) {
+        return -1;
+    }
+
+    // only the part holding data has to move
+    int used = (ino->size + FILE_SECTOR - 1) / FILE_SECTOR;
+    for (int done = 0; done < used; done += USLOSS_DISK_TRACK_SIZE) {
+        int n = used - done < USLOSS_DISK_TRACK_SIZE ? used - done : USLOSS_DISK_TRACK_SIZE;
+        diskSegment seg;
+
+        fileRun(&seg, ino->start + done, n);
+        seg.buffer = files.moveBuf;
+        int status = fileDisk(&seg, 1, USLOSS_DISK_READ);
+        if (status == 0) {
+            fileRun(&seg, start + done, n);
+            seg.buffer = files.moveBuf;
+            status = fileDisk(&seg, 1, USLOSS_DISK_WRITE);
+        }
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    fileMark(ino->start, ino->blocks, 0);
+    fileMark(start, want, 1);
+    ino->start = start;
+    ino->blocks = want;
+    return fileWriteMeta();
+}
+
+/**
+ * Moves bytes between a buffer and a file whose extent already covers
+ * them. Whole sectors go straight to or from the caller's buffer, partial
+ * ones at either end through a bounce sector, and everything is one
+ * vectored request over consecutive sectors. A write of partial sectors
+ * reads them first, and a write that makes the file longer carries the
+ * inode table along in the same request.
+ *
+ * @param ino, fileInode* representing the file
+ * @param offset, int representing the first byte
+ * @param bytes, int representing the number of bytes, at least one
+ * @param buffer, void* representing the caller's buffer
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ *
+ * @return int 0 on success, otherwise the disk status
+ */
+int fileIO(fileInode* ino, int offset, int bytes, void* buffer, int op) {
+    int first = offset / FILE_SECTOR;
+    int last = (offset + bytes - 1) / FILE_SECTOR;
+    int headOff = offset % FILE_SECTOR;
+    int tailLen = offset + bytes - last * FILE_SECTOR;
+
+    int headPartial = headOff != 0 || (first == last && tailLen != FILE_SECTOR);
+    int tailPartial = last != first && tailLen != FILE_SECTOR;
+
+    diskSegment segs[4];
+    diskSegment partial[2];
+    int nsegs = 0;
+    int npartial = 0;
+
+    int b = first;
+    if (headPartial) {
+        fileRun(&segs[nsegs], ino->start + b, 1);
+        segs[nsegs].buffer = files.bounce[0];
+        partial[npartial++] = segs[nsegs++];
+        b++;
+    }
+
+    int middle = (tailPartial ? last : last + 1) - b;
+    if (middle > 0) {
+        fileRun(&segs[nsegs], ino->start + b, middle);
+        segs[nsegs++].buffer = buffer + (b * FILE_SECTOR - offset);
+    }
+
+    if (tailPartial) {
+        fileRun(&segs[nsegs], ino->start + last, 1);
+        segs[nsegs].buffer = files.bounce[1];
+        partial[npartial++] = segs[nsegs++];
+    }
+
+    int headLen = first == last ? bytes : FILE_SECTOR - headOff;
+
+    if (op == USLOSS_DISK_READ) {
+        int status = fileDisk(segs, nsegs, USLOSS_DISK_READ);
+        if (status != 0) {
+            return status;
+        }
+        if (headPartial) {
+            memcpy(buffer, files.bounce[0] + headOff, headLen);
+        }
+        if (tailPartial) {
+            memcpy(buffer + bytes - tailLen, files.bounce[1], tailLen);
+        }
+        return 0;
+    }
+
+    // keep what the partial sectors already hold
+    if (npartial > 0) {
+        int status = fileDisk(partial, npartial, USLOSS_DISK_READ);
+        if (status != 0) {
+            return status;
+        }
+    }
+    if (headPartial) {
+        memcpy(files.bounce[0] + headOff, buffer, headLen);
+    }
+    if (tailPartial) {
+        memcpy(files.bounce[1], buffer + bytes - tailLen, tailLen);
+    }
+
+    int oldSize = ino->size;
+    if (offset + bytes > ino->size) {
+        ino->size = offset + bytes;
+        files.super->sum = fileSum();
+        nsegs += fileMetaSeg(&segs[nsegs]);
+    }
+
+    int status = fileDisk(segs, nsegs, USLOSS_DISK_WRITE);
+    if (status != 0) {
+        ino->size = oldSize;
+        files.super->sum = fileSum();
+    }
+    return status;
+}
+
+/**
+ * Fills in the disk position of a run of sectors of the store, which
+ * counts them from the start of its region.
+ *
+ * @param seg, diskSegment* representing the segment to fill in
+ * @param start, int representing the first sector
+ * @param blocks, int representing the number of sectors
+ *
+ * @return int 1, the number of segments filled in
+ */
+int fileRun(diskSegment* seg, int start, int blocks) {
+    int sector = fileTop() - files.super->nblocks + start;
+
+    seg->track = sector / USLOSS_DISK_TRACK_SIZE;
+    seg->first = sector % USLOSS_DISK_TRACK_SIZE;
+    seg->count = blocks;
+    return 1;
+}
+
+/**
+ * Fills in a segment covering the metadata sectors, the last of the
+ * region, which are found without knowing its size.
+ *
+ * @param seg, diskSegment* representing the segment to fill in
+ *
+ * @return int 1, the number of segments filled in
+ */
+int fileMetaSeg(diskSegment* seg) {
+    int sector = fileTop() - FILE_META;
+
+    seg->track = sector / USLOSS_DISK_TRACK_SIZE;
+    seg->first = sector % USLOSS_DISK_TRACK_SIZE;
+    seg->count = FILE_META;
+    seg->buffer = files.meta;
+    return 1;
+}
+
+/**
+ * Writes the superblock and the inode table.
+ *
+ * @return int the completion status
+ */
+int fileWriteMeta(void) {
+    diskSegment seg;
+
+    files.super->sum = fileSum();
+    fileMetaSeg(&seg);
+    return fileDisk(&seg, 1, USLOSS_DISK_WRITE);
+}
+
+/**
+ * Checksums the metadata sectors, leaving out the checksum itself.
+ *
+ * @return int the checksum
+ */
+int fileSum(void) {
+    int saved = files.super->sum;
+    unsigned int sum = 0;
+
+    files.super->sum = 0;
+    for (int i = 0; i < (int) sizeof(files.meta); i++) {
+        sum = sum * 31 + (unsigned char) files.meta[i];
+    }
+    files.super->sum = saved;
+
+    return (int) sum;
+}
+
+/**
+ * Finds the end of the store's region: the first sector of the tracks the
+ * journal and the cache list may take.
+ *
+ * @return int the sector, which the region ends just before
+ */
+int fileTop(void) {
+    return (diskGetTracks(FILE_UNIT) - DISK_META_TRACKS) * USLOSS_DISK_TRACK_SIZE;
+}
+
+/**
+ * Sends a list of segments to the store's region and waits for them. The
+ * region is out of its users' reach, so this goes around that check.
+ *
+ * @param segs, diskSegment* representing the segments
+ * @param nsegs, int representing how many there are
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int fileDisk(diskSegment* segs, int nsegs, int op) {
+    // a journal may still hold writes from before the region was set aside
+    journalSyncOverlap(FILE_UNIT, segs, nsegs);
+    diskRequest* req = diskSubmitRawV(FILE_UNIT, segs, nsegs, op);
+    if (req == NULL) {
+        return -1;
+    }
+    return diskReap(req);
+}
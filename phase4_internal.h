@@ -0,0 +1,94 @@
+/*
+ * Kernel-only interfaces shared between the phase 4 source files. Nothing
+ * here is visible to user code.
+ */
+
+#ifndef _PHASE4_INTERNAL_H
+#define _PHASE4_INTERNAL_H
+
+#include <usyscall.h>
+#include "phase4_usermode.h"
+
+#define DISK_MAXTRACKS 256
+#define DISK_META_TRACKS 3      // the journal's and the cache list's, which
+                                // also holds the saved remapping table, at the
+                                // end of every disk; a store sits below them
+
+typedef struct diskRequest diskRequest;
+
+// disk driver, phase4.c
+extern void         kernelCheck(char *func);
+extern int          diskGetTracks(int unit);
+extern int          diskUserTracks(int unit);
+extern diskRequest *diskSubmit(int unit, int track, int first, int sectors,
+                               void *buffer, int op, int async);
+extern diskRequest *diskSubmitV(int unit, diskSegment *segs, int nsegs,
+                                int op, int async);
+extern diskRequest *diskSubmitRaw(int unit, int track, int first,
+                                  int sectors, void *buffer, int op);
+extern diskRequest *diskSubmitRawV(int unit, diskSegment *segs, int nsegs,
+                                   int op);
+extern int          diskReap(diskRequest *req);
+extern int          diskCheckArgs(int unit, int track, int first);
+extern int          diskPickMirror(int *tracks);
+extern void         diskCountMirror(int unit);
+extern void         diskSetClass(int ioClass);
+extern int          diskHeat(int unit, int *counts, int max);
+extern int          termReadLine(int termUnit, char *line);
+extern void         termWriteLock(int termUnit);
+extern void         termWriteUnlock(int termUnit);
+extern void         termWriteChars(int termUnit, char *buffer, int len);
+
+// block layer, phase4_block.c
+extern void blockInit(void);
+extern void blockStartDaemons(void);
+extern int  blockReserved(int unit);
+extern void blockIOHandler(USLOSS_Sysargs *args);
+extern int  blockMigrateEnable(int unit, int on);
+
+// journal, phase4_journal.c
+extern void journalInit(void);
+extern void journalStartDaemons(void);
+extern int  journalReserved(int unit);
+extern int  journalWrite(int unit, int track, int first, int sectors,
+                         void *buffer, int *status);
+extern void journalSyncOverlap(int unit, diskSegment *segs, int nsegs);
+extern int  journalEnable(int unit, int on);
+extern void journalStats(int unit, diskStats *out);
+
+// file store, phase4_file.c
+extern void fileInit(void);
+extern void fileCreateHandler(USLOSS_Sysargs *args);
+extern void fileOpenHandler(USLOSS_Sysargs *args);
+extern void fileIOHandler(USLOSS_Sysargs *args);
+extern int  fileReserved(int unit);
+extern int  fileEnable(int unit, int tracks);
+
+// key-value store, phase4_kv.c
+extern void kvInit(void);
+extern void kvHandler(USLOSS_Sysargs *args);
+extern int  kvReserved(int unit);
+extern int  kvEnable(int unit, int tracks);
+
+// in-kernel copies and splices, phase4_copy.c
+extern void copyInit(void);
+extern void diskCopyHandler(USLOSS_Sysargs *args);
+extern void spliceStartDaemons(void);
+extern void spliceOutHandler(USLOSS_Sysargs *args);
+extern void spliceInHandler(USLOSS_Sysargs *args);
+extern void spliceWaitHandler(USLOSS_Sysargs *args);
+
+// read cache, phase4_cache.c
+extern void cacheInit(void);
+extern void cacheStartDaemons(void);
+extern int  cacheReserved(int unit);
+extern int  cacheRead(int unit, int track, int first, int sectors,
+                      void *buffer);
+extern int  cacheGen(int unit);
+extern void cacheFill(int unit, int track, int first, int sectors,
+                      void *buffer, int gen);
+extern void cacheInvalidate(int unit, diskSegment *segs, int nsegs);
+extern int  cacheEnable(int unit, int on);
+extern void cacheStats(int unit, diskStats *out);
+
+#endif /* _PHASE4_INTERNAL_H */
@@ -0,0 +1,661 @@
+/**
+ * Group commit journal for small synchronous disk writes. Once turned on
+ * with DiskControl, the last JOURNAL_TRACKS tracks of a disk hold the
+ * journal and are no longer part of the disk its users see. A DiskWrite
+ * of a few sectors is not sent home: it joins the batch being gathered,
+ * and the journal daemon of the unit writes the whole batch, a descriptor
+ * sector followed by the data, in one sequential request and acknowledges
+ * every writer in it at once. Writers that come in while a batch is on
+ * the disk gather into the next one.
+ *
+ * The committed sectors are written to their home locations later, in
+ * one elevator sorted pass, when the journal is half full, when it has
+ * no room for the next batch, or when some other request touches one of
+ * them. When the daemon starts it replays whatever the journal still
+ * holds from before, so an acknowledged write survives a crash.
+ *
+ * On the disk, journal sector 0 is the superblock and batches follow it.
+ * Every batch carries the epoch of the superblock and a checksum, and
+ * replay stops at the first batch that does not match; each checkpoint
+ * starts a new epoch, which drops all the batches before it.
+ */
+
+// ----- Constants
+#define JOURNAL_TRACKS 2
+#define JOURNAL_SECTORS (JOURNAL_TRACKS * USLOSS_DISK_TRACK_SIZE)
+#define JOURNAL_BATCH (USLOSS_DISK_TRACK_SIZE - 1)  // data sectors per batch
+#define JOURNAL_SMALL 4                             // largest journaled write
+#define JOURNAL_CKPT_AT (JOURNAL_SECTORS / 2)       // checkpoint when idle
+#define JOURNAL_MAGIC 0x4a524e4c
+#define JOURNAL_DESC_MAGIC 0x4a424154
+
+// ----- Includes
+#include <phase1.h>
+#include <phase2.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+#include "phase4_internal.h"
+#include <usloss.h>
+#include <usyscall.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// ----- typedefs
+typedef struct journalRec journalRec;
+typedef struct journalSuper journalSuper;
+typedef struct journalDesc journalDesc;
+typedef struct journal journal;
+
+// ----- Structs
+
+struct journalRec {
+    int track;
+    int sector;
+    char data[USLOSS_DISK_SECTOR_SIZE];
+};
+
+struct journalSuper {
+    int magic;                      // JOURNAL_MAGIC while the journal is on
+    int epoch;
+    int sum;                        // checksum of the superblock
+};
+
+struct journalDesc {
+    int magic;                      // JOURNAL_DESC_MAGIC
+    int epoch;                      // must match the superblock
+    int count;                      // data sectors after this one
+    int sum;                        // checksum of the data sectors
+    int home[JOURNAL_BATCH][2];     // track and sector of each
+};
+
+struct journal {
+    int mutex;                      // guards everything but buf
+    int wakeMbox;                   // wakes the daemon
+    int roomMbox;                   // writers waiting for room in the batch
+    int readyMbox;                  // token passed around after recovery
+    int ready;                      // recovery is done
+    int active;                     // journaling is on
+    int wantActive;                 // what DiskControl asked for
+    int base;                       // first track of the journal
+    int epoch;
+    int used;                       // journal sectors in use, superblock too
+    journalRec pending[JOURNAL_BATCH]; // the batch being gathered
+    int npending;
+    int writers[JOURNAL_BATCH];     // pids waiting for that batch
+    int nwriters;
+    int roomWaiters;
+    journalRec committed[JOURNAL_SECTORS]; // on the journal, not yet home
+    int ncommitted;
+    int syncers[MAXPROC];           // pids waiting for a checkpoint
+    int nsyncers;
+    int batches;
+    int records;
+    int checkpoints;
+    int replayed;
+    char buf[(JOURNAL_BATCH + 1) * USLOSS_DISK_SECTOR_SIZE]; // daemon's I/O
+};
+
+// ----- Function Prototypes
+
+void journalInit(void);
+void journalStartDaemons(void);
+int journalMain(char*);
+int journalReserved(int);
+int journalWrite(int, int, int, int, void*, int*);
+void journalSyncOverlap(int, diskSegment*, int);
+int journalEnable(int, int);
+void journalStats(int, diskStats*);
+void journalWaitReady(journal*);
+int journalWaitDaemon(journal*, int);
+void journalWakeAll(int*, int, int);
+void journalCommit(int);
+int journalCheckpoint(int);
+int journalWriteSuper(int, int);
+void journalRecover(int);
+int journalIO(int, int, int, void*, int);
+int journalSum(int, void*, int);
+int journalSuperSum(journalSuper*);
+
+// ----- Global data structures/vars
+journal journals[USLOSS_DISK_UNITS];
+int journalWake[MAXPROC];           // per process, carries a status
+
+// ----- Phase 4 Bootload
+
+/**
+ * Called from phase4_init. Makes the locks; whether a disk has a journal
+ * is only known once its daemon has read the superblock.
+ */
+void journalInit(void) {
+    for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+        journals[i].mutex = MboxCreate(1, 0);
+        journals[i].wakeMbox = MboxCreate(1, 0);
+        journals[i].roomMbox = MboxCreate(MAXPROC, 0);
+        journals[i].readyMbox = MboxCreate(1, 0);
+    }
+    for (int i = 0; i < MAXPROC; i++) {
+        journalWake[i] = MboxCreate(1, sizeof(int));
+    }
+}
+
+/**
+ * Called from phase4_start_service_processes, starts one journal daemon
+ * per disk.
+ */
+void journalStartDaemons(void) {
+    for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+        char unit[10];
+        sprintf(unit, "%d", i);
+
+        char name[20];
+        sprintf(name, "Journal %d", i);
+
+        fork1(name, journalMain, unit, USLOSS_MIN_STACK, 2);
+    }
+}
+
+// ----- Daemon
+
+/**
+ * Journal daemon of one disk. Replays the journal first, then commits
+ * batches as writers gather them, and checkpoints when asked to or when
+ * the journal is half full and nothing is waiting.
+ *
+ * @param arg, char* representing the disk unit
+ *
+ * @return int never returns
+ */
+int journalMain(char* arg) {
+    int unit = atoi(arg);
+    journal* j = &journals[unit];
+
+    journalRecover(unit);
+
+    // let through whoever asked before recovery was done
+    j->ready = 1;
+    MboxSend(j->readyMbox, NULL, 0);
+
+    while (1) {
+        MboxRecv(j->wakeMbox, NULL, 0);
+
+        MboxSend(j->mutex, NULL, 0);
+        while (j->npending > 0 || j->nsyncers > 0) {
+            if (j->npending > 0) {
+                journalCommit(unit);
+                continue;
+            }
+
+            int status = j->active ? journalCheckpoint(unit) : 0;
+            if (status == 0 && j->wantActive != j->active) {
+                status = journalWriteSuper(unit, j->wantActive);
+            }
+            journalWakeAll(j->syncers, j->nsyncers, status);
+            j->nsyncers = 0;
+        }
+
+        if (j->active && j->used >= JOURNAL_CKPT_AT) {
+            journalCheckpoint(unit);
+        }
+        MboxRecv(j->mutex, NULL, 0);
+    }
+
+    return 0;
+}
+
+/**
+ * Writes the batch gathered so far to the journal and acknowledges its
+ * writers. The lock is dropped while the batch is on the disk, so the
+ * next one can gather. Called with the journal lock held.
+ *
+ * @param unit, int representing the disk unit
+ */
+void journalCommit(int unit) {
+    journal* j = &journals[unit];
+    int n = j->npending;
+
+    // no room, the writers find out the batch failed
+    if (j->used + 1 + n > JOURNAL_SECTORS && journalCheckpoint(unit) != 0) {
+        journalWakeAll(j->writers, j->nwriters, USLOSS_DEV_ERROR);
+        j->npending = 0;
+        j->nwriters = 0;
+        while (j->roomWaiters > 0) {
+            MboxSend(j->roomMbox, NULL, 0);
+            j->roomWaiters--;
+        }
+        return;
+    }
+
+    journalDesc* desc = (journalDesc*) j->buf;
+    memset(desc, 0, USLOSS_DISK_SECTOR_SIZE);
+    desc->magic = JOURNAL_DESC_MAGIC;
+    desc->epoch = j->epoch;
+    desc->count = n;
+
+    // the records sit in the committed list already, but count only
+    // once the batch is on the disk
+    for (int i = 0; i < n; i++) {
+        journalRec* rec = &j->pending[i];
+        desc->home[i][0] = rec->track;
+        desc->home[i][1] = rec->sector;
+        memcpy(j->buf + (i + 1) * USLOSS_DISK_SECTOR_SIZE, rec->data, USLOSS_DISK_SECTOR_SIZE);
+        j->committed[j->ncommitted + i] = *rec;
+    }
+    desc->sum = journalSum(j->epoch, j->buf + USLOSS_DISK_SECTOR_SIZE, n);
+
+    int writers[JOURNAL_BATCH];
+    int nwriters = j->nwriters;
+    memcpy(writers, j->writers, nwriters * sizeof(int));
+
+    int pos = j->used;
+    j->used += 1 + n;
+    j->npending = 0;
+    j->nwriters = 0;
+
+    // the batch is free again
+    while (j->roomWaiters > 0) {
+        MboxSend(j->roomMbox, NULL, 0);
+        j->roomWaiters--;
+    }
+
+    MboxRecv(j->mutex, NULL, 0);
+    int status = journalIO(unit, pos, 1 + n, j->buf, USLOSS_DISK_WRITE);
+    MboxSend(j->mutex, NULL, 0);
+
+    if (status == 0) {
+        j->ncommitted += n;
+        j->batches++;
+        j->records += n;
+    } else {
+        j->used = pos;
+    }
+
+    journalWakeAll(writers, nwriters, status);
+}
+
+/**
+ * Writes every committed sector home, the latest copy of each, then
+ * starts a new epoch so the journal is empty. Called with the journal
+ * lock held.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int 0 on success, otherwise the first error
+ */
+int journalCheckpoint(int unit) {
+    journal* j = &journals[unit];
+    diskRequest* reqs[JOURNAL_SECTORS];
+    int nreqs = 0;
+    int status = 0;
+
+    // queue them all before waiting, so the daemon sorts them
+    for (int i = j->ncommitted - 1; i >= 0; i--) {
+        journalRec* rec = &j->committed[i];
+        int newer = 0;
+        for (int k = i + 1; k < j->ncommitted && !newer; k++) {
+            newer = j->committed[k].track == rec->track && j->committed[k].sector == rec->sector;
+        }
+        if (newer) {
+            continue;
+        }
+
+        diskRequest* req = diskSubmitRaw(unit, rec->track, rec->sector, 1, rec->data, USLOSS_DISK_WRITE);
+        if (req == NULL) {
+            status = -1;
+            break;
+        }
+        reqs[nreqs++] = req;
+    }
+
+    for (int i = 0; i < nreqs; i++) {
+        int reqStatus = diskReap(reqs[i]);
+        if (status == 0 && reqStatus != 0) {
+            status = reqStatus;
+        }
+    }
+    if (status != 0) {
+        return status;
+    }
+
+    j->checkpoints++;
+    return journalWriteSuper(unit, 1);
+}
+
+/**
+ * Writes a superblock with a new epoch, which empties the journal.
+ * Called with the journal lock held.
+ *
+ * @param unit, int representing the disk unit
+ * @param active, int representing if the journal stays on
+ *
+ * @return int the completion status
+ */
+int journalWriteSuper(int unit, int active) {
+    journal* j = &journals[unit];
+
+    memset(j->buf, 0, USLOSS_DISK_SECTOR_SIZE);
+    journalSuper* super = (journalSuper*) j->buf;
+    super->magic = active ? JOURNAL_MAGIC : 0;
+    super->epoch = j->epoch + 1;
+    super->sum = journalSuperSum(super);
+
+    int status = journalIO(unit, 0, 1, j->buf, USLOSS_DISK_WRITE);
+    if (status != 0) {
+        return status;
+    }
+
+    j->epoch++;
+    j->used = 1;
+    j->ncommitted = 0;
+    j->active = active;
+    return 0;
+}
+
+/**
+ * Reads the superblock and replays the batches of its epoch, stopping at
+ * the first that is torn or stale, then checkpoints them. A superblock
+ * whose checksum fails counts as a journal that is off.
+ *
+ * @param unit, int representing the disk unit
+ */
+void journalRecover(int unit) {
+    journal* j = &journals[unit];
+    journalDesc desc;
+
+    j->base = diskGetTracks(unit) - JOURNAL_TRACKS;
+
+    if (journalIO(unit, 0, 1, j->buf, USLOSS_DISK_READ) != 0) {
+        return;
+    }
+    journalSuper* super = (journalSuper*) j->buf;
+    j->epoch = super->epoch;
+    if (super->magic != JOURNAL_MAGIC || super->sum != journalSuperSum(super)) {
+        return;
+    }
+
+    j->active = 1;
+    j->wantActive = 1;
+    j->used = 1;
+
+    while (j->used < JOURNAL_SECTORS) {
+        if (journalIO(unit, j->used, 1, j->buf, USLOSS_DISK_READ) != 0) {
+            break;
+        }
+        memcpy(&desc, j->buf, sizeof(desc));
+        if (desc.magic != JOURNAL_DESC_MAGIC || desc.epoch != j->epoch || desc.count < 1 ||
+            desc.count > JOURNAL_BATCH || j->used + 1 + desc.count > JOURNAL_SECTORS) {
+            break;
+        }
+
+        if (journalIO(unit, j->used + 1, desc.count, j->buf, USLOSS_DISK_READ) != 0 ||
+            journalSum(j->epoch, j->buf, desc.count) != desc.sum) {
+            break;
+        }
+
+        for (int i = 0; i < desc.count; i++) {
+            journalRec* rec = &j->committed[j->ncommitted++];
+            rec->track = desc.home[i][0];
+            rec->sector = desc.home[i][1];
+            memcpy(rec->data, j->buf + i * USLOSS_DISK_SECTOR_SIZE, USLOSS_DISK_SECTOR_SIZE);
+        }
+        j->used += 1 + desc.count;
+        j->replayed += desc.count;
+    }
+
+    // nothing to put home; the superblock on disk is already right
+    if (j->ncommitted == 0) {
+        return;
+    }
+
+    MboxSend(j->mutex, NULL, 0);
+    journalCheckpoint(unit);
+    MboxRecv(j->mutex, NULL, 0);
+}
+
+// ----- Helpers
+
+/**
+ * Tells how many tracks at the end of a disk the journal takes. Waits for
+ * recovery, since until then nobody knows.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int JOURNAL_TRACKS if the disk has a journal, else 0
+ */
+int journalReserved(int unit) {
+    journal* j = &journals[unit];
+
+    journalWaitReady(j);
+    return j->active ? JOURNAL_TRACKS : 0;
+}
+
+/**
+ * Commits a synchronous write through the journal if it is small and the
+ * disk has one.
+ *
+ * @param unit, int representing the disk unit
+ * @param track, int representing the first track
+ * @param first, int representing the first sector
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the data
+ * @param status, int* filled in with the completion status
+ *
+ * @return int 0 if the journal took the write, -1 if the caller must
+ * write it home itself
+ */
+int journalWrite(int unit, int track, int first, int sectors, void* buffer, int* status) {
+    journal* j = &journals[unit];
+
+    if (sectors > JOURNAL_SMALL) {
+        return -1;
+    }
+    journalWaitReady(j);
+    int userTracks = diskUserTracks(unit);
+
+    // the whole write goes in one batch
+    MboxSend(j->mutex, NULL, 0);
+    while (j->active && j->npending + sectors > JOURNAL_BATCH) {
+        j->roomWaiters++;
+        MboxRecv(j->mutex, NULL, 0);
+        MboxRecv(j->roomMbox, NULL, 0);
+        MboxSend(j->mutex, NULL, 0);
+    }
+
+    if (!j->active) {
+        MboxRecv(j->mutex, NULL, 0);
+        return -1;
+    }
+
+    // past the end of what the users see fails, like any other request;
+    // that is below the cache's list track too if the disk has one
+    int start = track * USLOSS_DISK_TRACK_SIZE + first;
+    if (start + sectors > userTracks * USLOSS_DISK_TRACK_SIZE) {
+        MboxRecv(j->mutex, NULL, 0);
+        *status = USLOSS_DEV_ERROR;
+        return 0;
+    }
+
+    for (int i = 0; i < sectors; i++) {
+        journalRec* rec = &j->pending[j->npending++];
+        rec->track = (start + i) / USLOSS_DISK_TRACK_SIZE;
+        rec->sector = (start + i) % USLOSS_DISK_TRACK_SIZE;
+        memcpy(rec->data, buffer + i * USLOSS_DISK_SECTOR_SIZE, USLOSS_DISK_SECTOR_SIZE);
+    }
+    j->writers[j->nwriters++] = getpid();
+
+    *status = journalWaitDaemon(j, 0);
+    return 0;
+}
+
+/**
+ * Called before any other request is queued on a disk with a journal. If
+ * it touches a sector the journal holds, the journal is checkpointed
+ * first, so a read sees the latest data and a write is not overwritten
+ * by an older copy later.
+ *
+ * @param unit, int representing the disk unit
+ * @param segs, diskSegment* representing the sectors of the request
+ * @param nsegs, int representing the number of segments
+ */
+void journalSyncOverlap(int unit, diskSegment* segs, int nsegs) {
+    journal* j = &journals[unit];
+
+    journalWaitReady(j);
+
+    MboxSend(j->mutex, NULL, 0);
+    int overlap = 0;
+    for (int i = 0; i < j->ncommitted && !overlap; i++) {
+        int abs = j->committed[i].track * USLOSS_DISK_TRACK_SIZE + j->committed[i].sector;
+        for (int s = 0; s < nsegs && !overlap; s++) {
+            int start = segs[s].track * USLOSS_DISK_TRACK_SIZE + segs[s].first;
+            overlap = abs >= start && abs < start + segs[s].count;
+        }
+    }
+
+    if (!overlap) {
+        MboxRecv(j->mutex, NULL, 0);
+        return;
+    }
+    journalWaitDaemon(j, 1);
+}
+
+/**
+ * Turns the journal of a disk on or off. Turning it on takes the last
+ * JOURNAL_TRACKS tracks of the disk; turning it off writes everything
+ * home first.
+ *
+ * @param unit, int representing the disk unit
+ * @param on, int representing if the journal should be on
+ *
+ * @return int 0 on success, otherwise the disk status
+ */
+int journalEnable(int unit, int on) {
+    journal* j = &journals[unit];
+
+    journalWaitReady(j);
+
+    MboxSend(j->mutex, NULL, 0);
+    j->wantActive = on != 0;
+    return journalWaitDaemon(j, 1);
+}
+
+/**
+ * Fills in the journal counters of a disk.
+ *
+ * @param unit, int representing the disk unit
+ * @param out, diskStats* representing where to put them
+ */
+void journalStats(int unit, diskStats* out) {
+    journal* j = &journals[unit];
+
+    out->journalBatches = j->batches;
+    out->journalWrites = j->records;
+    out->journalCheckpoints = j->checkpoints;
+    out->journalReplayed = j->replayed;
+}
+
+/**
+ * Blocks until the daemon of a journal has finished recovery. Once it
+ * has this is a plain read; a caller that waits hands the token right
+ * back so every one of them gets through.
+ *
+ * @param j, journal* representing the journal
+ */
+void journalWaitReady(journal* j) {
+    if (j->ready) {
+        return;
+    }
+
+    MboxRecv(j->readyMbox, NULL, 0);
+    MboxSend(j->readyMbox, NULL, 0);
+}
+
+/**
+ * Queues the calling process for the next checkpoint or the next batch,
+ * releases the journal lock, wakes the daemon and waits for its answer.
+ * Called with the journal lock held.
+ *
+ * @param j, journal* representing the journal
+ * @param sync, int representing if the caller waits for a checkpoint
+ *
+ * @return int the status the daemon hands back
+ */
+int journalWaitDaemon(journal* j, int sync) {
+    int pid = getpid();
+    int status;
+
+    if (sync) {
+        j->syncers[j->nsyncers++] = pid;
+    }
+    MboxRecv(j->mutex, NULL, 0);
+
+    MboxCondSend(j->wakeMbox, NULL, 0);
+    MboxRecv(journalWake[pid % MAXPROC], &status, sizeof(int));
+
+    return status;
+}
+
+/**
+ * Hands a status to each of a list of waiting processes.
+ *
+ * @param pids, int* representing the processes
+ * @param n, int representing how many there are
+ * @param status, int representing the status to hand them
+ */
+void journalWakeAll(int* pids, int n, int status) {
+    for (int i = 0; i < n; i++) {
+        MboxSend(journalWake[pids[i] % MAXPROC], &status, sizeof(int));
+    }
+}
+
+/**
+ * Reads or writes sectors of the journal area and waits for them.
+ *
+ * @param unit, int representing the disk unit
+ * @param pos, int representing the first journal sector
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the buffer
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int journalIO(int unit, int pos, int sectors, void* buffer, int op) {
+    journal* j = &journals[unit];
+    int track = j->base + pos / USLOSS_DISK_TRACK_SIZE;
+
+    diskRequest* req = diskSubmitRaw(unit, track, pos % USLOSS_DISK_TRACK_SIZE, sectors, buffer, op);
+    if (req == NULL) {
+        return -1;
+    }
+    return diskReap(req);
+}
+
+/**
+ * Checksums the data sectors of a batch, salted with the epoch.
+ *
+ * @param epoch, int representing the epoch of the batch
+ * @param data, void* representing the sectors
+ * @param sectors, int representing how many there are
+ *
+ * @return int the checksum
+ */
+int journalSum(int epoch, void* data, int sectors) {
+    unsigned int sum = epoch;
+    unsigned int* word = data;
+
+    for (int i = 0; i < sectors * USLOSS_DISK_SECTOR_SIZE / (int)sizeof(int); i++) {
+        sum = sum * 31 + word[i];
+    }
+    return (int) sum;
+}
+
+/**
+ * Checksums a superblock, leaving out the checksum itself.
+ *
+ * @param super, journalSuper* representing the superblock
+ *
+ * @return int the checksum
+ */
+int journalSuperSum(journalSuper* super) {
+    return (int)((unsigned int) super->magic * 31 + (unsigned int) super->epoch);
+}
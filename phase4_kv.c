@@ -0,0 +1,772 @@
+/**
+ * Key-value store on disk KV_UNIT. DiskControl sets aside a region of
+ * tracks for it right below the journal's and the cache list's, which the
+ * disk's users no longer see. The last sector of the region is a header
+ * giving the size of the rest, so the region is found again when the
+ * system comes up. Every record takes one sector holding its key, its
+ * value and a sequence number, and records are appended one after the
+ * other round the region; an update or a delete appends a new record and
+ * leaves the old one behind as garbage. When the append point comes round
+ * again it steps over the sectors that still hold the newest record of a
+ * key and reuses the rest.
+ *
+ * A hash index in memory gives the sector of each key, so a lookup is at
+ * most one disk read, and the last few values looked up are kept in
+ * memory, so a hot lookup does not read the disk at all. The index is
+ * rebuilt on first use by reading the whole region and keeping the newest
+ * record of each key.
+ */
+
+// ----- Constants
+#define KV_UNIT 0
+#define KV_MAXSECTORS 1024
+#define KV_SLOTS (2 * KV_MAXSECTORS)  // hash slots, kept at most half full
+#define KV_CACHE 8                      // values kept in memory
+#define KV_MAGIC 0x4b565245
+#define KV_HEADMAGIC 0x4b564844
+#define KV_SECTOR USLOSS_DISK_SECTOR_SIZE
+
+#define KV_SLOT_EMPTY 0
+#define KV_SLOT_USED 1
+#define KV_SLOT_GONE 2                  // was used, keeps probe chains whole
+
+// ----- Includes
+#include <phase1.h>
+#include <phase2.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+#include "phase4_internal.h"
+#include <usloss.h>
+#include <usyscall.h>
+#include <string.h>
+
+// ----- typedefs
+typedef USLOSS_Sysargs sysArgs;
+typedef struct kvHeader kvHeader;
+typedef struct kvRecord kvRecord;
+typedef struct kvEntry kvEntry;
+typedef struct kvCached kvCached;
+typedef struct kvStore kvStore;
+
+// ----- Structs
+
+struct kvHeader {
+    int magic;                      // KV_HEADMAGIC while the region is set aside
+    int nsectors;                   // record sectors below the header
+    int sum;                        // checksum of the header
+};
+
+struct kvRecord {
+    int magic;                      // KV_MAGIC
+    int seq;                        // higher is newer
+    int len;                        // value bytes, -1 for a delete
+    int sum;                        // checksum of the record
+    char key[KV_KEYLEN];
+    char value[KV_MAXVALUE];
+};
+
+struct kvEntry {
+    int state;                      // KV_SLOT_*
+    char key[KV_KEYLEN];
+    int sector;                     // the newest record of the key
+    int seq;                        // and its sequence number
+    int deleted;                    // that record is a delete
+    int copies;                     // sectors holding any record of the key
+};
+
+struct kvCached {
+    int slot;                       // index entry, -1 if unused
+    int lastUse;
+    int len;
+    char value[KV_MAXVALUE];
+};
+
+struct kvStore {
+    int mutex;                      // held for the whole of any call
+    int probeMutex;                 // held while the header is first read
+    int probed;                     // header read
+    int present;                    // the region is set aside
+    int ready;                      // index built
+    int nsectors;
+    int head;                       // next sector to try appending at
+    int seq;
+    int clock;                      // for the cache's least recently used
+    kvEntry slots[KV_SLOTS];
+    short owner[KV_MAXSECTORS];     // slot whose record a sector holds, or -1
+    kvCached cache[KV_CACHE];
+    char buf[KV_SECTOR];
+    char scanBuf[USLOSS_DISK_TRACK_SIZE * KV_SECTOR];
+};
+
+// ----- Function Prototypes
+
+void kvInit(void);
+void kvHandler(sysArgs*);
+int kvReserved(int);
+int kvEnable(int, int);
+int kvProbe(void);
+int kvWriteHeader(int);
+int kvSetup(void);
+int kvPut(char*, void*, int);
+int kvGet(char*, void*, int, int*);
+int kvDelete(char*);
+int kvAppend(int, int, void*, int);
+int kvNextSector(void);
+void kvDrop(int);
+int kvFind(char*);
+int kvInsert(char*);
+int kvHash(char*);
+int kvKeyOk(char*);
+int kvSum(kvRecord*);
+int kvHeaderSum(kvHeader*);
+int kvTop(void);
+kvCached* kvCacheLookup(int);
+void kvCacheFill(int, void*, int);
+void kvCacheForget(int);
+int kvDisk(int, int, void*, int);
+
+// ----- Global data structures/vars
+kvStore kv;
+
+// ----- Phase 4 Bootload
+
+/**
+ * Called from phase4_init. The index is built on first use, once the
+ * geometry of the disk is known.
+ */
+void kvInit(void) {
+    kv.mutex = MboxCreate(1, 0);
+    kv.probeMutex = MboxCreate(1, 0);
+    for (int i = 0; i < KV_CACHE; i++) {
+        kv.cache[i].slot = -1;
+    }
+}
+
+// ----- Syscall Handlers
+
+/**
+ * Puts, gets or deletes the value of a key. A get copies as much of the
+ * value as fits and returns its full length; a get or a delete of a key
+ * that is not there fails.
+ *
+ * @param *args, USLOSS System args to receive and return
+ * params
+ *
+ * @return void
+ */
+void kvHandler(sysArgs* args) {
+    kernelCheck("kvHandler");
+
+    char* key = args->arg1;
+    void* value = args->arg2;
+    int len = (int)(long) args->arg3;
+    int op = (int)(long) args->arg5;
+
+    if (!kvKeyOk(key) || (op != KV_OP_PUT && op != KV_OP_GET && op != KV_OP_DELETE) ||
+        (op != KV_OP_DELETE && (len < 0 || (len > 0 && value == NULL))) ||
+        (op == KV_OP_PUT && len > KV_MAXVALUE)) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    MboxSend(kv.mutex, NULL, 0);
+    int status = kvSetup();
+    int length = 0;
+    if (status == 0) {
+        if (op == KV_OP_PUT) {
+            status = kvPut(key, value, len);
+        } else if (op == KV_OP_GET) {
+            status = kvGet(key, value, len, &length);
+        } else {
+            status = kvDelete(key);
+        }
+    }
+    MboxRecv(kv.mutex, NULL, 0);
+
+    if (status != 0) {
+        args->arg4 = (void*)(long)-1;
+        return;
+    }
+
+    args->arg1 = (void*)(long) length;
+    args->arg4 = (void*)(long)0;
+}
+
+// ----- Helpers
+
+/**
+ * Tells how many tracks at the end of a disk the store keeps from its
+ * users, counting the journal's and the cache list's below which it sits.
+ * The header is read the first time this is asked; after that it is a
+ * plain read.
+ *
+ * @param unit, int representing the disk unit
+ *
+ * @return int the number of tracks, 0 if the disk has no store
+ */
+int kvReserved(int unit) {
+    if (unit != KV_UNIT) {
+        return 0;
+    }
+
+    if (!kv.probed) {
+        MboxSend(kv.probeMutex, NULL, 0);
+        if (!kv.probed) {
+            kvProbe();
+        }
+        MboxRecv(kv.probeMutex, NULL, 0);
+    }
+
+    if (!kv.present) {
+        return 0;
+    }
+    return DISK_META_TRACKS + (kv.nsectors + 1 + USLOSS_DISK_TRACK_SIZE - 1) / USLOSS_DISK_TRACK_SIZE;
+}
+
+/**
+ * Sets aside a region of tracks for the store, or gives it back. A new
+ * region is wiped and gets its header; one that is already there is kept
+ * if it has the size asked for. Giving it back erases the header, so the
+ * store is gone for good, and the tracks are the users' again.
+ *
+ * @param unit, int representing the disk unit, only KV_UNIT has a store
+ * @param tracks, int representing the size of the region, 0 to give it back
+ *
+ * @return int 0 on success, -1 if the size does not fit or differs from
+ * the region already there, otherwise the disk status
+ */
+int kvEnable(int unit, int tracks) {
+    if (unit != KV_UNIT) {
+        return -1;
+    }
+    kvReserved(unit);
+
+    MboxSend(kv.mutex, NULL, 0);
+    int status = 0;
+    int nsectors = tracks * USLOSS_DISK_TRACK_SIZE - 1;
+
+    if (tracks == 0) {
+        if (kv.present) {
+            // erased while the region is still ours, then handed back
+            status = kvWriteHeader(0);
+            kv.present = 0;
+            kv.ready = 0;
+            for (int i = 0; i < KV_CACHE; i++) {
+                kv.cache[i].slot = -1;
+            }
+        }
+    } else if (kv.present) {
+        status = kv.nsectors == nsectors ? 0 : -1;
+    } else if (nsectors > KV_MAXSECTORS || tracks + DISK_META_TRACKS >= diskGetTracks(unit) ||
+               blockReserved(unit) > 0) {
+        // the migrator may have moved tracks of the volumes there
+        status = -1;
+    } else {
+        // users are kept out of the region before it is wiped
+        kv.nsectors = nsectors;
+        kv.present = 1;
+        kv.ready = 0;
+
+        memset(kv.scanBuf, 0, sizeof(kv.scanBuf));
+        for (int s = 0; s < nsectors && status == 0; s += USLOSS_DISK_TRACK_SIZE) {
+            int n = nsectors - s < USLOSS_DISK_TRACK_SIZE ? nsectors - s : USLOSS_DISK_TRACK_SIZE;
+            status = kvDisk(s, n, kv.scanBuf, USLOSS_DISK_WRITE);
+        }
+        if (status == 0) {
+            status = kvWriteHeader(1);
+        }
+        if (status != 0) {
+            kv.present = 0;
+        }
+    }
+    MboxRecv(kv.mutex, NULL, 0);
+
+    return status;
+}
+
+/**
+ * Reads the header of the store's region, if the disk has one. A disk
+ * whose header cannot be read has no store.
+ *
+ * @return int 0 on success, otherwise the disk status
+ */
+int kvProbe(void) {
+    kvHeader* head = (kvHeader*) kv.buf;
+    int top = kvTop();
+
+    int status = top <= 0 ? -1 : kvDisk(-1, 1, kv.buf, USLOSS_DISK_READ);
+    kv.present = status == 0 && head->magic == KV_HEADMAGIC && head->sum == kvHeaderSum(head) &&
+                 head->nsectors > 0 && head->nsectors <= KV_MAXSECTORS && head->nsectors < top;
+    if (kv.present) {
+        kv.nsectors = head->nsectors;
+    }
+    kv.probed = 1;
+
+    return status;
+}
+
+/**
+ * Writes the header of the store's region. Called with the store lock
+ * held.
+ *
+ * @param present, int representing if the region stays set aside, 0 to
+ * erase the header
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int kvWriteHeader(int present) {
+    kvHeader* head = (kvHeader*) kv.buf;
+
+    memset(kv.buf, 0, sizeof(kv.buf));
+    if (present) {
+        head->magic = KV_HEADMAGIC;
+        head->nsectors = kv.nsectors;
+        head->sum = kvHeaderSum(head);
+    }
+    return kvDisk(-1, 1, kv.buf, USLOSS_DISK_WRITE);
+}
+
+/**
+ * Builds the index the first time the store is used, by reading the
+ * region a track at a time and keeping the newest record of every key. A
+ * key whose newest record is a delete, with no older record of it left on
+ * the disk, is forgotten. Appending carries on after the newest record of
+ * all. Called with the store lock held.
+ *
+ * @return int 0 on success, -1 if the disk has no store, otherwise the
+ * disk status
+ */
+int kvSetup(void) {
+    if (kv.ready) {
+        return 0;
+    }
+    if (kvReserved(KV_UNIT) == 0) {
+        return -1;
+    }
+
+    int nsectors = kv.nsectors;
+
+    memset(kv.slots, 0, sizeof(kv.slots));
+    for (int s = 0; s < KV_MAXSECTORS; s++) {
+        kv.owner[s] = -1;
+    }
+    kv.head = 0;
+    kv.seq = 0;
+
+    for (int base = 0; base < nsectors; base += USLOSS_DISK_TRACK_SIZE) {
+        int n = nsectors - base < USLOSS_DISK_TRACK_SIZE ? nsectors - base : USLOSS_DISK_TRACK_SIZE;
+        int status = kvDisk(base, n, kv.scanBuf, USLOSS_DISK_READ);
+        if (status != 0) {
+            return status;
+        }
+
+        for (int i = 0; i < n; i++) {
+            kvRecord* rec = (kvRecord*)(kv.scanBuf + i * KV_SECTOR);
+            int sector = base + i;
+
+            if (rec->magic != KV_MAGIC || rec->sum != kvSum(rec) ||
+                rec->len < -1 || rec->len > KV_MAXVALUE ||
+                rec->key[KV_KEYLEN - 1] != '\0' || !kvKeyOk(rec->key)) {
+                continue;
+            }
+
+            int slot = kvFind(rec->key);
+            if (slot < 0) {
+                slot = kvInsert(rec->key);
+            }
+
+            kvEntry* e = &kv.slots[slot];
+            if (e->copies == 0 || rec->seq > e->seq) {
+                e->sector = sector;
+                e->seq = rec->seq;
+                e->deleted = rec->len < 0;
+            }
+            e->copies++;
+            kv.owner[sector] = slot;
+
+            if (rec->seq > kv.seq) {
+                kv.seq = rec->seq;
+                kv.head = (sector + 1) % nsectors;
+            }
+        }
+    }
+
+    for (int slot = 0; slot < KV_SLOTS; slot++) {
+        if (kv.slots[slot].state == KV_SLOT_USED && kv.slots[slot].deleted &&
+            kv.slots[slot].copies == 1) {
+            kvDrop(slot);
+        }
+    }
+
+    kv.ready = 1;
+    return 0;
+}
+
+/**
+ * Stores a value under a key, in place of any value it had.
+ *
+ * @param key, char* representing the key
+ * @param value, void* representing the value
+ * @param len, int representing its length in bytes
+ *
+ * @return int 0 on success, -1 if the disk is full, otherwise the disk
+ * status
+ */
+int kvPut(char* key, void* value, int len) {
+    int slot = kvFind(key);
+    if (slot < 0) {
+        slot = kvInsert(key);
+    }
+
+    int status = kvAppend(slot, len, value, len);
+    if (status == 0) {
+        kvCacheFill(slot, value, len);
+    } else if (kv.slots[slot].copies == 0) {
+        kvDrop(slot);
+    }
+    return status;
+}
+
+/**
+ * Looks up the value of a key: from the cache if it is there, otherwise
+ * with one read of the sector the index gives for it.
+ *
+ * @param key, char* representing the key
+ * @param value, void* representing the buffer for the value
+ * @param size, int representing the size of that buffer
+ * @param len, int* representing where to put the length of the value
+ *
+ * @return int 0 on success, -1 if the key is not there or its record is
+ * bad, otherwise the disk status
+ */
+int kvGet(char* key, void* value, int size, int* len) {
+    int slot = kvFind(key);
+    if (slot < 0 || kv.slots[slot].deleted) {
+        return -1;
+    }
+
+    kvCached* c = kvCacheLookup(slot);
+    if (c == NULL) {
+        int status = kvDisk(kv.slots[slot].sector, 1, kv.buf, USLOSS_DISK_READ);
+        if (status != 0) {
+            return status;
+        }
+
+        kvRecord* rec = (kvRecord*) kv.buf;
+        if (rec->magic != KV_MAGIC || rec->sum != kvSum(rec) || rec->seq != kv.slots[slot].seq) {
+            return -1;
+        }
+        kvCacheFill(slot, rec->value, rec->len);
+        c = kvCacheLookup(slot);
+    }
+
+    memcpy(value, c->value, c->len < size ? c->len : size);
+    *len = c->len;
+    return 0;
+}
+
+/**
+ * Deletes a key by appending a record that says so.
+ *
+ * @param key, char* representing the key
+ *
+ * @return int 0 on success, -1 if the key is not there or the disk is
+ * full, otherwise the disk status
+ */
+int kvDelete(char* key) {
+    int slot = kvFind(key);
+    if (slot < 0 || kv.slots[slot].deleted) {
+        return -1;
+    }
+
+    kvCacheForget(slot);
+    return kvAppend(slot, -1, NULL, 0);
+}
+
+/**
+ * Writes the newest record of a key at the append point and makes the
+ * index point at it. The record it writes over was garbage; if that was
+ * the last old record of a deleted key, the delete is not needed any more
+ * and the key is forgotten.
+ *
+ * @param slot, int representing the index entry of the key
+ * @param len, int representing the value length, -1 for a delete
+ * @param value, void* representing the value
+ * @param bytes, int representing how many bytes of it to write
+ *
+ * @return int 0 on success, -1 if the disk is full, otherwise the disk
+ * status
+ */
+int kvAppend(int slot, int len, void* value, int bytes) {
+    kvEntry* e = &kv.slots[slot];
+
+    int sector = kvNextSector();
+    if (sector < 0) {
+        return -1;
+    }
+
+    kvRecord* rec = (kvRecord*) kv.buf;
+    memset(kv.buf, 0, sizeof(kv.buf));
+    rec->magic = KV_MAGIC;
+    rec->seq = kv.seq + 1;
+    rec->len = len;
+    strcpy(rec->key, e->key);
+    if (bytes > 0) {
+        memcpy(rec->value, value, bytes);
+    }
+    rec->sum = kvSum(rec);
+
+    int status = kvDisk(sector, 1, kv.buf, USLOSS_DISK_WRITE);
+    if (status != 0) {
+        return status;
+    }
+
+    kv.seq++;
+    kv.head = (sector + 1) % kv.nsectors;
+
+    int old = kv.owner[sector];
+    if (old >= 0) {
+        kv.slots[old].copies--;
+    }
+
+    e->sector = sector;
+    e->seq = kv.seq;
+    e->deleted = len < 0;
+    e->copies++;
+    kv.owner[sector] = slot;
+
+    if (old >= 0 && old != slot && kv.slots[old].deleted && kv.slots[old].copies == 1) {
+        kvDrop(old);
+    }
+    return 0;
+}
+
+/**
+ * Finds where the next record goes: the first sector from the append
+ * point on that does not hold the newest record of some key.
+ *
+ * @return int the sector, or -1 if every sector is in use
+ */
+int kvNextSector(void) {
+    for (int i = 0; i < kv.nsectors; i++) {
+        int sector = (kv.head + i) % kv.nsectors;
+        int slot = kv.owner[sector];
+
+        if (slot < 0 || kv.slots[slot].sector != sector) {
+            return sector;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Forgets a key whose only record on the disk is its delete, or that has
+ * no record at all. The sector of the delete is free again.
+ *
+ * @param slot, int representing the index entry of the key
+ */
+void kvDrop(int slot) {
+    kvEntry* e = &kv.slots[slot];
+
+    if (e->copies > 0 && kv.owner[e->sector] == slot) {
+        kv.owner[e->sector] = -1;
+    }
+    kvCacheForget(slot);
+    memset(e, 0, sizeof(*e));
+    e->state = KV_SLOT_GONE;
+}
+
+/**
+ * Finds the index entry of a key.
+ *
+ * @param key, char* representing the key
+ *
+ * @return int the slot, or -1 if the key is not in the index
+ */
+int kvFind(char* key) {
+    int slot = kvHash(key);
+
+    for (int i = 0; i < KV_SLOTS; i++) {
+        kvEntry* e = &kv.slots[slot];
+        if (e->state == KV_SLOT_EMPTY) {
+            return -1;
+        }
+        if (e->state == KV_SLOT_USED && strcmp(e->key, key) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) % KV_SLOTS;
+    }
+    return -1;
+}
+
+/**
+ * Adds a key that is not in the index yet, with no record. There are
+ * twice as many slots as sectors, so there is always one to be had.
+ *
+ * @param key, char* representing the key
+ *
+ * @return int the slot
+ */
+int kvInsert(char* key) {
+    int slot = kvHash(key);
+
+    while (kv.slots[slot].state == KV_SLOT_USED) {
+        slot = (slot + 1) % KV_SLOTS;
+    }
+
+    kvEntry* e = &kv.slots[slot];
+    memset(e, 0, sizeof(*e));
+    e->state = KV_SLOT_USED;
+    strcpy(e->key, key);
+    return slot;
+}
+
+/**
+ * Hashes a key to the slot its probe starts at.
+ *
+ * @param key, char* representing the key
+ *
+ * @return int the slot
+ */
+int kvHash(char* key) {
+    unsigned int hash = 5381;
+
+    for (int i = 0; key[i] != '\0'; i++) {
+        hash = hash * 33 + (unsigned char) key[i];
+    }
+    return hash % KV_SLOTS;
+}
+
+/**
+ * Checks a key: not empty, and short enough to fit a record.
+ *
+ * @param key, char* representing the key
+ *
+ * @return int 1 if it is usable, else 0
+ */
+int kvKeyOk(char* key) {
+    return key != NULL && key[0] != '\0' && strlen(key) < KV_KEYLEN;
+}
+
+/**
+ * Checksums a record, leaving out the checksum itself.
+ *
+ * @param rec, kvRecord* representing the record
+ *
+ * @return int the checksum
+ */
+int kvSum(kvRecord* rec) {
+    int saved = rec->sum;
+    unsigned int sum = 0;
+
+    rec->sum = 0;
+    for (int i = 0; i < (int) sizeof(*rec); i++) {
+        sum = sum * 31 + ((unsigned char*) rec)[i];
+    }
+    rec->sum = saved;
+
+    return (int) sum;
+}
+
+/**
+ * Checksums a header, leaving out the checksum itself.
+ *
+ * @param head, kvHeader* representing the header
+ *
+ * @return int the checksum
+ */
+int kvHeaderSum(kvHeader* head) {
+    return (int)((unsigned int) head->magic * 31 + (unsigned int) head->nsectors);
+}
+
+/**
+ * Finds the end of the store's region: the first sector of the tracks the
+ * journal and the cache list may take.
+ *
+ * @return int the sector, which the region ends just before
+ */
+int kvTop(void) {
+    return (diskGetTracks(KV_UNIT) - DISK_META_TRACKS) * USLOSS_DISK_TRACK_SIZE;
+}
+
+/**
+ * Finds the cached value of a key and marks it as just used.
+ *
+ * @param slot, int representing the index entry of the key
+ *
+ * @return kvCached* the cached value, or NULL if it is not cached
+ */
+kvCached* kvCacheLookup(int slot) {
+    for (int i = 0; i < KV_CACHE; i++) {
+        if (kv.cache[i].slot == slot) {
+            kv.cache[i].lastUse = ++kv.clock;
+            return &kv.cache[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Caches the value of a key, in place of the one used longest ago.
+ *
+ * @param slot, int representing the index entry of the key
+ * @param value, void* representing the value
+ * @param len, int representing its length in bytes
+ */
+void kvCacheFill(int slot, void* value, int len) {
+    kvCached* c = &kv.cache[0];
+
+    for (int i = 0; i < KV_CACHE; i++) {
+        if (kv.cache[i].slot == slot) {
+            c = &kv.cache[i];
+            break;
+        }
+        if (kv.cache[i].lastUse < c->lastUse) {
+            c = &kv.cache[i];
+        }
+    }
+
+    c->slot = slot;
+    c->lastUse = ++kv.clock;
+    c->len = len;
+    memcpy(c->value, value, len);
+}
+
+/**
+ * Drops the cached value of a key, if there is one.
+ *
+ * @param slot, int representing the index entry of the key
+ */
+void kvCacheForget(int slot) {
+    for (int i = 0; i < KV_CACHE; i++) {
+        if (kv.cache[i].slot == slot) {
+            kv.cache[i].slot = -1;
+            kv.cache[i].lastUse = 0;
+        }
+    }
+}
+
+/**
+ * Reads or writes sectors of the store's region and waits for them. The
+ * region is out of its users' reach, so this goes around that check.
+ *
+ * @param sector, int representing the first record sector, -1 for the
+ * header
+ * @param sectors, int representing the number of sectors
+ * @param buffer, void* representing the data
+ * @param op, int representing USLOSS_DISK_READ or USLOSS_DISK_WRITE
+ *
+ * @return int the completion status, or -1 if no request slot was free
+ */
+int kvDisk(int sector, int sectors, void* buffer, int op) {
+    int block = sector < 0 ? kvTop() - 1 : kvTop() - 1 - kv.nsectors + sector;
+    diskSegment seg = { block / USLOSS_DISK_TRACK_SIZE, block % USLOSS_DISK_TRACK_SIZE, sectors, buffer };
+
+    // a journal may still hold writes from before the region was set aside
+    journalSyncOverlap(KV_UNIT, &seg, 1);
+    diskRequest* req = diskSubmitRawV(KV_UNIT, &seg, 1, op);
+    if (req == NULL) {
+        return -1;
+    }
+    return diskReap(req);
+}
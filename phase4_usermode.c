@@ -8,6 +8,7 @@
 #include <usloss.h>
 #include <usyscall.h>
 
+#include "phase4.h"
 #include "phase4_usermode.h"
 
 #define CHECKMODE { \
@@ -201,4 +202,789 @@ int DiskSize(int unit, int *sector, int *track, int *disk)
     return (long) sysArg.arg4;
 } /* end of DiskSize */
 
+
+/*
+ *  Routine:  DiskReadAsync
+ *
+ *  Description: This is the call entry point for queueing a disk read
+ *               without waiting for it.  The buffer must not be touched
+ *               until the request is collected with DiskWait/DiskWaitAny.
+ *
+ *  Arguments:    void* diskBuffer  -- pointer to the input buffer
+ *                int   unit -- which disk to read
+ *                int   track  -- first track to read
+ *                int   first -- first sector to read
+ *                int   sectors -- number of sectors to read
+ *                int   *handle    -- pointer to output value
+ *                (output value: handle of the queued request)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskReadAsync(void *diskBuffer, int unit, int track, int first,
+                  int sectors, int *handle)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKREADASYNC;
+    sysArg.arg1 = diskBuffer;
+    sysArg.arg2 = (void *) ( (long) sectors);
+    sysArg.arg3 = (void *) ( (long) track);
+    sysArg.arg4 = (void *) ( (long) first);
+    sysArg.arg5 = (void *) ( (long) unit);
+
+    USLOSS_Syscall(&sysArg);
+
+    *handle = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskReadAsync */
+
+
+/*
+ *  Routine:  DiskWriteAsync
+ *
+ *  Description: This is the call entry point for queueing a disk write
+ *               without waiting for it.  The buffer must not be touched
+ *               until the request is collected with DiskWait/DiskWaitAny.
+ *
+ *  Arguments:    void *diskBuffer -- pointer to the output buffer
+ *                int   unit       -- which disk to write
+ *                int   track      -- first track to write
+ *                int   first      -- first sector to write
+ *                int   sectors    -- number of sectors to write
+ *                int  *handle     -- pointer to output value
+ *                (output value: handle of the queued request)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskWriteAsync(void *diskBuffer, int unit, int track, int first,
+                   int sectors, int *handle)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKWRITEASYNC;
+    sysArg.arg1 = diskBuffer;
+    sysArg.arg2 = (void *) ( (long) sectors);
+    sysArg.arg3 = (void *) ( (long) track);
+    sysArg.arg4 = (void *) ( (long) first);
+    sysArg.arg5 = (void *) ( (long) unit);
+
+    USLOSS_Syscall(&sysArg);
+
+    *handle = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskWriteAsync */
+
+
+/*
+ *  Routine:  DiskWait
+ *
+ *  Description: This is the call entry point for collecting one async
+ *               disk request.
+ *
+ *  Arguments:    int   handle  -- request returned by DiskRead/WriteAsync
+ *                int  *status  -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskWait(int handle, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    if (handle < 0)
+        return -1;
+
+    sysArg.number = SYS_DISKWAIT;
+    sysArg.arg1 = (void *) ( (long) handle);
+
+    USLOSS_Syscall(&sysArg);
+
+    *status = (long) sysArg.arg2;
+    return (long) sysArg.arg4;
+} /* end of DiskWait */
+
+
+/*
+ *  Routine:  DiskWaitAny
+ *
+ *  Description: This is the call entry point for collecting whichever
+ *               async disk request of the caller completes first.
+ *
+ *  Arguments:    int  *handle  -- pointer to output value
+ *                (output value: handle of the completed request)
+ *                int  *status  -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means nothing is outstanding
+ */
+int DiskWaitAny(int *handle, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKWAIT;
+    sysArg.arg1 = (void *) ( (long) -1);
+
+    USLOSS_Syscall(&sysArg);
+
+    *handle = (long) sysArg.arg1;
+    *status = (long) sysArg.arg2;
+    return (long) sysArg.arg4;
+} /* end of DiskWaitAny */
+
+
+/*
+ *  Routine:  DiskReadV
+ *
+ *  Description: This is the call entry point for scatter-gather disk
+ *               input; every segment is read in a single daemon pass.
+ *
+ *  Arguments:    diskSegment *segs  -- segments to read
+ *                int   nsegs -- number of segments (at most DISK_MAXSEGS)
+ *                int   unit -- which disk to read
+ *                int   *status    -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskReadV(diskSegment *segs, int nsegs, int unit, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKREADV;
+    sysArg.arg1 = (void *) segs;
+    sysArg.arg2 = (void *) ( (long) nsegs);
+    sysArg.arg3 = (void *) ( (long) unit);
+
+    USLOSS_Syscall(&sysArg);
+
+    *status = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskReadV */
+
+
+/*
+ *  Routine:  DiskWriteV
+ *
+ *  Description: This is the call entry point for scatter-gather disk
+ *               output; every segment is written in a single daemon pass.
+ *
+ *  Arguments:    diskSegment *segs  -- segments to write
+ *                int   nsegs -- number of segments (at most DISK_MAXSEGS)
+ *                int   unit -- which disk to write
+ *                int   *status    -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskWriteV(diskSegment *segs, int nsegs, int unit, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKWRITEV;
+    sysArg.arg1 = (void *) segs;
+    sysArg.arg2 = (void *) ( (long) nsegs);
+    sysArg.arg3 = (void *) ( (long) unit);
+
+    USLOSS_Syscall(&sysArg);
+
+    *status = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskWriteV */
+
+
+/*
+ *  Routine:  DiskStats
+ *
+ *  Description: This is the call entry point for reading the I/O
+ *               counters and latency histograms of a disk unit.
+ *
+ *  Arguments:    int   unit -- which disk to look at
+ *                diskStats *stats -- filled in with a snapshot
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskStats(int unit, diskStats *stats)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKSTATS;
+    sysArg.arg1 = (void *) ( (long) unit);
+    sysArg.arg2 = (void *) stats;
+
+    USLOSS_Syscall(&sysArg);
+
+    return (long) sysArg.arg4;
+} /* end of DiskStats */
+
+
+/*
+ *  Routine:  DiskHeat
+ *
+ *  Description: This is the call entry point for reading how often each
+ *               track of a disk unit was accessed.
+ *
+ *  Arguments:    int   unit -- which disk to look at
+ *                int   *counts -- filled in with one count per track
+ *                int   size -- how many counts fit
+ *                int   *tracks -- pointer to output value
+ *                (output value: tracks on the disk)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskHeat(int unit, int *counts, int size, int *tracks)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKHEAT;
+    sysArg.arg1 = (void *) ( (long) unit);
+    sysArg.arg2 = (void *) counts;
+    sysArg.arg3 = (void *) ( (long) size);
+
+    USLOSS_Syscall(&sysArg);
+
+    *tracks = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskHeat */
+
+
+/*
+ *  Routine:  DiskSetPriority
+ *
+ *  Description: This is the call entry point for setting the I/O
+ *               priority class of the calling process.
+ *
+ *  Arguments:    int   ioClass -- DISK_CLASS_RT, DISK_CLASS_BE or
+ *                                 DISK_CLASS_IDLE
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskSetPriority(int ioClass)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKSETPRIO;
+    sysArg.arg1 = (void *) ( (long) ioClass);
+
+    USLOSS_Syscall(&sysArg);
+
+    return (long) sysArg.arg4;
+} /* end of DiskSetPriority */
+
+
+/*
+ *  Routine:  DiskControl
+ *
+ *  Description: This is the call entry point for changing a tunable of
+ *               a disk unit, like its scheduler.
+ *
+ *  Arguments:    int   unit -- which disk to tune
+ *                int   ctl -- which tunable, one of DISK_CTL_*
+ *                int   value -- its new value
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskControl(int unit, int ctl, int value)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKCONTROL;
+    sysArg.arg1 = (void *) ( (long) unit);
+    sysArg.arg2 = (void *) ( (long) ctl);
+    sysArg.arg3 = (void *) ( (long) value);
+
+    USLOSS_Syscall(&sysArg);
+
+    return (long) sysArg.arg4;
+} /* end of DiskControl */
+
+
+/*
+ *  Routine:  DiskProcTime
+ *
+ *  Description: This is the call entry point for reading how much disk
+ *               time the requests of a process have used.
+ *
+ *  Arguments:    int   pid -- which process
+ *                int   *usecs -- pointer to output value
+ *                (output value: microseconds of disk time)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskProcTime(int pid, int *usecs)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_DISKPROCTIME;
+    sysArg.arg1 = (void *) ( (long) pid);
+
+    USLOSS_Syscall(&sysArg);
+
+    *usecs = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskProcTime */
+
+/*
+ *  Routine:  BlockRead
+ *
+ *  Description: This is the call entry point for reading logical blocks
+ *               of a volume.
+ *
+ *  Arguments:    void  *buffer -- pointer to the input buffer
+ *                int   vol -- which volume, one of BLOCK_VOL_*
+ *                int   lba -- first logical block to read
+ *                int   count -- number of blocks to read
+ *                int   *status -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int BlockRead(void *buffer, int vol, int lba, int count, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_BLOCKIO;
+    sysArg.arg1 = buffer;
+    sysArg.arg2 = (void *) ( (long) count);
+    sysArg.arg3 = (void *) ( (long) lba);
+    sysArg.arg4 = (void *) ( (long) vol);
+    sysArg.arg5 = (void *) ( (long) BLOCK_OP_READ);
+
+    USLOSS_Syscall(&sysArg);
+
+    *status = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of BlockRead */
+
+
+/*
+ *  Routine:  BlockWrite
+ *
+ *  Description: This is the call entry point for writing logical blocks
+ *               of a volume.
+ *
+ *  Arguments:    void  *buffer -- pointer to the output buffer
+ *                int   vol -- which volume, one of BLOCK_VOL_*
+ *                int   lba -- first logical block to write
+ *                int   count -- number of blocks to write
+ *                int   *status -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int BlockWrite(void *buffer, int vol, int lba, int count, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_BLOCKIO;
+    sysArg.arg1 = buffer;
+    sysArg.arg2 = (void *) ( (long) count);
+    sysArg.arg3 = (void *) ( (long) lba);
+    sysArg.arg4 = (void *) ( (long) vol);
+    sysArg.arg5 = (void *) ( (long) BLOCK_OP_WRITE);
+
+    USLOSS_Syscall(&sysArg);
+
+    *status = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of BlockWrite */
+
+
+/*
+ *  Routine:  BlockSize
+ *
+ *  Description: This is the call entry point for the size of a volume.
+ *
+ *  Arguments:    int   vol -- which volume, one of BLOCK_VOL_*
+ *                int   *blocks -- pointer to output value
+ *                (output value: number of logical blocks)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int BlockSize(int vol, int *blocks)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_BLOCKIO;
+    sysArg.arg4 = (void *) ( (long) vol);
+    sysArg.arg5 = (void *) ( (long) BLOCK_OP_SIZE);
+
+    USLOSS_Syscall(&sysArg);
+
+    *blocks = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of BlockSize */
+
+/*
+ *  Routine:  FileCreate
+ *
+ *  Description: This is the call entry point for creating a file, with
+ *               room for size bytes in one extent. A file of the same
+ *               name is emptied.
+ *
+ *  Arguments:    char  *name -- name of the file
+ *                int   size -- bytes to make room for
+ *                int   *fd -- pointer to output value
+ *                (output value: the file descriptor)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int FileCreate(char *name, int size, int *fd)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_FILECREATE;
+    sysArg.arg1 = name;
+    sysArg.arg2 = (void *) ( (long) size);
+
+    USLOSS_Syscall(&sysArg);
+
+    *fd = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of FileCreate */
+
+
+/*
+ *  Routine:  FileOpen
+ *
+ *  Description: This is the call entry point for looking up a file.
+ *
+ *  Arguments:    char  *name -- name of the file
+ *                int   *fd -- pointer to output value
+ *                (output value: the file descriptor)
+ *                int   *size -- pointer to output value
+ *                (output value: bytes in the file)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int FileOpen(char *name, int *fd, int *size)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_FILEOPEN;
+    sysArg.arg1 = name;
+
+    USLOSS_Syscall(&sysArg);
+
+    *fd = (long) sysArg.arg1;
+    *size = (long) sysArg.arg2;
+    return (long) sysArg.arg4;
+} /* end of FileOpen */
+
+
+/*
+ *  Routine:  FileRead
+ *
+ *  Description: This is the call entry point for reading from a file.
+ *
+ *  Arguments:    int   fd -- the file descriptor
+ *                void  *buffer -- pointer to the input buffer
+ *                int   offset -- first byte to read
+ *                int   bytes -- number of bytes to read
+ *                int   *count -- pointer to output value
+ *                (output value: bytes read, less at the end of the file)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int FileRead(int fd, void *buffer, int offset, int bytes, int *count)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_FILEIO;
+    sysArg.arg1 = buffer;
+    sysArg.arg2 = (void *) ( (long) bytes);
+    sysArg.arg3 = (void *) ( (long) offset);
+    sysArg.arg4 = (void *) ( (long) fd);
+    sysArg.arg5 = (void *) ( (long) FILE_OP_READ);
+
+    USLOSS_Syscall(&sysArg);
+
+    *count = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of FileRead */
+
+
+/*
+ *  Routine:  FileWrite
+ *
+ *  Description: This is the call entry point for writing to a file.
+ *
+ *  Arguments:    int   fd -- the file descriptor
+ *                void  *buffer -- pointer to the output buffer
+ *                int   offset -- first byte to write
+ *                int   bytes -- number of bytes to write
+ *                int   *count -- pointer to output value
+ *                (output value: bytes written)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int FileWrite(int fd, void *buffer, int offset, int bytes, int *count)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_FILEIO;
+    sysArg.arg1 = buffer;
+    sysArg.arg2 = (void *) ( (long) bytes);
+    sysArg.arg3 = (void *) ( (long) offset);
+    sysArg.arg4 = (void *) ( (long) fd);
+    sysArg.arg5 = (void *) ( (long) FILE_OP_WRITE);
+
+    USLOSS_Syscall(&sysArg);
+
+    *count = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of FileWrite */
+
+
+/*
+ *  Routine:  KVPut
+ *
+ *  Description: This is the call entry point for storing a value under
+ *               a key, in place of any value it had.
+ *
+ *  Arguments:    char  *key -- the key
+ *                void  *value -- pointer to the value
+ *                int   len -- length of the value in bytes
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int KVPut(char *key, void *value, int len)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_KV;
+    sysArg.arg1 = key;
+    sysArg.arg2 = value;
+    sysArg.arg3 = (void *) ( (long) len);
+    sysArg.arg5 = (void *) ( (long) KV_OP_PUT);
+
+    USLOSS_Syscall(&sysArg);
+
+    return (long) sysArg.arg4;
+} /* end of KVPut */
+
+
+/*
+ *  Routine:  KVGet
+ *
+ *  Description: This is the call entry point for looking up the value
+ *               of a key. As much of it as fits is copied.
+ *
+ *  Arguments:    char  *key -- the key
+ *                void  *value -- pointer to the input buffer
+ *                int   size -- size of the buffer
+ *                int   *len -- pointer to output value
+ *                (output value: length of the whole value)
+ *
+ *  Return Value: 0 means success, -1 means error occurs or no such key
+ */
+int KVGet(char *key, void *value, int size, int *len)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_KV;
+    sysArg.arg1 = key;
+    sysArg.arg2 = value;
+    sysArg.arg3 = (void *) ( (long) size);
+    sysArg.arg5 = (void *) ( (long) KV_OP_GET);
+
+    USLOSS_Syscall(&sysArg);
+
+    *len = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of KVGet */
+
+
+/*
+ *  Routine:  KVDelete
+ *
+ *  Description: This is the call entry point for deleting a key.
+ *
+ *  Arguments:    char  *key -- the key
+ *
+ *  Return Value: 0 means success, -1 means error occurs or no such key
+ */
+int KVDelete(char *key)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_KV;
+    sysArg.arg1 = key;
+    sysArg.arg3 = (void *) ( (long) 0);
+    sysArg.arg5 = (void *) ( (long) KV_OP_DELETE);
+
+    USLOSS_Syscall(&sysArg);
+
+    return (long) sysArg.arg4;
+} /* end of KVDelete */
+
+
+/*
+ *  Routine:  DiskCopy
+ *
+ *  Description: This is the call entry point for copying sectors from
+ *               one place on the disks to another inside the kernel.
+ *
+ *  Arguments:    int   srcUnit   -- which disk to copy from
+ *                int   srcTrack  -- first track to copy from
+ *                int   srcSector -- first sector to copy from
+ *                int   dstUnit   -- which disk to copy to
+ *                int   dstTrack  -- first track to copy to
+ *                int   dstSector -- first sector to copy to
+ *                int   count     -- number of sectors to copy
+ *                int   *status   -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int DiskCopy(int srcUnit, int srcTrack, int srcSector, int dstUnit,
+    int dstTrack, int dstSector, int count, int *status)
+{
+    USLOSS_Sysargs sysArg;
+    diskCopyArgs   copyArgs;
+
+    CHECKMODE;
+    copyArgs.srcUnit = srcUnit;
+    copyArgs.srcTrack = srcTrack;
+    copyArgs.srcSector = srcSector;
+    copyArgs.dstUnit = dstUnit;
+    copyArgs.dstTrack = dstTrack;
+    copyArgs.dstSector = dstSector;
+    copyArgs.count = count;
+
+    sysArg.number = SYS_DISKCOPY;
+    sysArg.arg1 = &copyArgs;
+
+    USLOSS_Syscall(&sysArg);
+
+    *status = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of DiskCopy */
+
+
+/*
+ *  Routine:  SpliceDiskToTerm
+ *
+ *  Description: This is the call entry point for sending bytes from a
+ *               disk to a terminal inside the kernel. It returns at once;
+ *               SpliceWait tells when the bytes are out.
+ *
+ *  Arguments:    int   unit    -- which disk to read
+ *                int   track   -- first track to read
+ *                int   first   -- first sector to read
+ *                int   bytes   -- number of bytes to send
+ *                int   term    -- which terminal to write
+ *                int   *handle -- pointer to output value
+ *                (output value: handle for SpliceWait)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int SpliceDiskToTerm(int unit, int track, int first, int bytes, int term,
+    int *handle)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_SPLICEOUT;
+    sysArg.arg1 = (void *) ( (long) unit);
+    sysArg.arg2 = (void *) ( (long) track);
+    sysArg.arg3 = (void *) ( (long) first);
+    sysArg.arg4 = (void *) ( (long) bytes);
+    sysArg.arg5 = (void *) ( (long) term);
+
+    USLOSS_Syscall(&sysArg);
+
+    *handle = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of SpliceDiskToTerm */
+
+
+/*
+ *  Routine:  SpliceTermToDisk
+ *
+ *  Description: This is the call entry point for storing input lines of
+ *               a terminal on a disk inside the kernel. It returns at
+ *               once; SpliceWait tells when the bytes are on the disk.
+ *
+ *  Arguments:    int   term    -- which terminal to read
+ *                int   unit    -- which disk to write
+ *                int   track   -- first track to write
+ *                int   first   -- first sector to write
+ *                int   bytes   -- number of bytes to store
+ *                int   *handle -- pointer to output value
+ *                (output value: handle for SpliceWait)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int SpliceTermToDisk(int term, int unit, int track, int first, int bytes,
+    int *handle)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_SPLICEIN;
+    sysArg.arg1 = (void *) ( (long) unit);
+    sysArg.arg2 = (void *) ( (long) track);
+    sysArg.arg3 = (void *) ( (long) first);
+    sysArg.arg4 = (void *) ( (long) bytes);
+    sysArg.arg5 = (void *) ( (long) term);
+
+    USLOSS_Syscall(&sysArg);
+
+    *handle = (long) sysArg.arg1;
+    return (long) sysArg.arg4;
+} /* end of SpliceTermToDisk */
+
+
+/*
+ *  Routine:  SpliceWait
+ *
+ *  Description: This is the call entry point for waiting for a splice
+ *               to be over.
+ *
+ *  Arguments:    int   handle  -- the splice, from SpliceDiskToTerm or
+ *                                 SpliceTermToDisk
+ *                int   *count  -- pointer to output value
+ *                (output value: bytes moved)
+ *                int   *status -- pointer to output value
+ *                (output value: completion status)
+ *
+ *  Return Value: 0 means success, -1 means error occurs
+ */
+int SpliceWait(int handle, int *count, int *status)
+{
+    USLOSS_Sysargs sysArg;
+
+    CHECKMODE;
+    sysArg.number = SYS_SPLICEWAIT;
+    sysArg.arg1 = (void *) ( (long) handle);
+
+    USLOSS_Syscall(&sysArg);
+
+    *count = (long) sysArg.arg1;
+    *status = (long) sysArg.arg2;
+    return (long) sysArg.arg4;
+} /* end of SpliceWait */
+
+
 /* end libuser.c */
@@ -5,6 +5,211 @@
 #ifndef _PHASE4_USERMODE_H
 #define _PHASE4_USERMODE_H
 
+/*
+ * Largest number of segments in a single DiskReadV/DiskWriteV.
+ */
+#define DISK_MAXSEGS    16
+
+/*
+ * One extent of a vectored disk transfer: count sectors starting at
+ * (track, first), to or from buffer.
+ */
+typedef struct diskSegment {
+    int   track;
+    int   first;
+    int   count;
+    void *buffer;
+} diskSegment;
+
+/*
+ * Arguments of a DiskCopy: count sectors from (srcUnit, srcTrack,
+ * srcSector) to (dstUnit, dstTrack, dstSector). The two runs may be on the
+ * same disk and may overlap.
+ */
+typedef struct diskCopyArgs {
+    int srcUnit;
+    int srcTrack;
+    int srcSector;
+    int dstUnit;
+    int dstTrack;
+    int dstSector;
+    int count;
+} diskCopyArgs;
+
+/*
+ * I/O priority classes for DiskSetPriority. Real-time requests are served
+ * first, best-effort ones (the default) next, and idle ones only when
+ * nothing else is waiting; a class passed over for too long still gets a
+ * turn.
+ */
+#define DISK_CLASS_RT   0
+#define DISK_CLASS_BE   1
+#define DISK_CLASS_IDLE 2
+#define DISK_NCLASSES   3
+
+/*
+ * Tunables for DiskControl. Each takes the unit and a value.
+ */
+
+/* The scheduler of the disk, one of DISK_SCHED_*. */
+#define DISK_CTL_SCHED       0
+
+/* Sectors a CFQ sub-queue is served per turn. */
+#define DISK_CTL_CFQSLICE    1
+
+/*
+ * Microseconds AS waits, after a synchronous read, for the same process
+ * to read nearby again; rounded up to a clock tick.
+ */
+#define DISK_CTL_ANTICWINDOW 2
+
+/*
+ * Outside CFQ reads are served ahead of writes, until this many reads
+ * went ahead of waiting writes.
+ */
+#define DISK_CTL_WRITESTARVE 3
+
+/* Writes that then go in one sweep, once reads held them back that long. */
+#define DISK_CTL_WRITEBATCH  4
+
+/*
+ * 1 turns on a journal in the last two tracks of the disk, which DiskSize
+ * then leaves out: small DiskWrites are committed to it in batches and
+ * written home later. 0 turns it off again.
+ */
+#define DISK_CTL_JOURNAL     5
+
+/*
+ * 1 lets the block layer move hot tracks of the disk towards its middle;
+ * only for a disk used through the plain, striped and mirrored block
+ * volumes. Where the tracks went is kept on the cache list's track,
+ * which DiskSize then leaves out. 0 moves them all home again.
+ * DiskHeat shows the accesses per track.
+ */
+#define DISK_CTL_MIGRATE     6
+
+/*
+ * 1 caches the DiskReads of the disk and keeps a list of its hottest
+ * sectors on the track below the journal's, which DiskSize then leaves
+ * out too; the list is read back in when the system comes up. Turning it
+ * on again saves the list right away, 0 turns it off.
+ */
+#define DISK_CTL_CACHE       7
+
+/*
+ * n sets aside n tracks of disk 0 for the key-value store, right below
+ * the cache list's track, which DiskSize then leaves out; the store is
+ * kept when the system comes up again. 0 gives the tracks back and drops
+ * every key.
+ */
+#define DISK_CTL_KV          8
+
+/* The same on disk 1 for the file store; 0 drops every file. */
+#define DISK_CTL_FILES       9
+
+/*
+ * Schedulers for DISK_CTL_SCHED. C-LOOK runs one elevator per class; CFQ
+ * gives each process its own sub-queue and serves them round robin; AS
+ * is C-LOOK that waits a little after a synchronous read for the same
+ * process to read nearby again.
+ */
+#define DISK_SCHED_CLOOK    0
+#define DISK_SCHED_CFQ      1
+#define DISK_SCHED_AS       2
+
+/*
+ * Volumes for the block calls, addressed by logical block of one sector.
+ * The first two are the plain disks; BLOCK_VOL_STRIPE deals out one track
+ * worth of blocks to each disk in turn; BLOCK_VOL_MIRROR keeps a copy on
+ * both disks, writing both and reading whichever disk is less busy.
+ * BLOCK_VOL_LOG0 and BLOCK_VOL_LOG1 store their blocks log structured on
+ * one disk: every write is appended where the last one ended, so random
+ * writes cost no seeks. Their index lives in memory only, and a disk
+ * holds either plain or log data, never both.
+ */
+#define BLOCK_VOL_DISK0  0
+#define BLOCK_VOL_DISK1  1
+#define BLOCK_VOL_STRIPE 2
+#define BLOCK_VOL_MIRROR 3
+#define BLOCK_VOL_LOG0   4
+#define BLOCK_VOL_LOG1   5
+#define BLOCK_NVOLS      6
+
+#define BLOCK_OP_READ  0
+#define BLOCK_OP_WRITE 1
+#define BLOCK_OP_SIZE  2
+
+/*
+ * Flat file store on disk 1, in the tracks DISK_CTL_FILES sets aside.
+ * Each file is kept in one run of consecutive sectors, so a file is read
+ * in a single sweep. Names are shorter than FILE_NAMELEN; reads and
+ * writes give their offset in bytes.
+ */
+#define FILE_NAMELEN  16
+#define FILE_MAXFILES 32
+
+#define FILE_OP_READ  0
+#define FILE_OP_WRITE 1
+
+/*
+ * Key-value store on disk 0, in the tracks DISK_CTL_KV sets aside. A
+ * record takes one sector, so keys are shorter than KV_KEYLEN and values
+ * at most KV_MAXVALUE bytes.
+ */
+#define KV_KEYLEN   32
+#define KV_MAXVALUE 464
+
+#define KV_OP_PUT    0
+#define KV_OP_GET    1
+#define KV_OP_DELETE 2
+
+/*
+ * Buckets in the DiskStats latency histograms. Bucket b counts requests
+ * that took [2^b, 2^(b+1)) microseconds; bucket 0 also takes 0 and 1, the
+ * last one takes everything longer.
+ */
+#define DISK_HISTBUCKETS 24
+
+/*
+ * Counters for one disk unit, filled in by DiskStats. Percentiles are the
+ * upper bound of the histogram bucket they fall in, in microseconds.
+ */
+typedef struct diskStats {
+    int reads;              /* read requests serviced by the device */
+    int writes;             /* write requests serviced by the device */
+    int sectorsRead;
+    int sectorsWritten;
+    int seeks;              /* seeks sent to the device */
+    int seekDistance;       /* tracks travelled by all of them */
+    int queueDepth;         /* requests waiting right now */
+    int peakQueueDepth;     /* most requests ever waiting at once */
+    int merged;             /* requests that rode along in a merged pass */
+    int sharedReads;        /* reads served by another pending read */
+    int absorbedWrites;     /* writes superseded by a newer pending write */
+    int anticipations;      /* times the head waited for a follow-up read */
+    int anticipationHits;   /* times the follow-up came in time */
+    int mirrorReads;        /* mirrored volume reads this disk finished */
+    int journalWrites;      /* sectors committed to the journal */
+    int journalBatches;     /* journal writes they went out in */
+    int journalCheckpoints; /* times the journal was written home */
+    int journalReplayed;    /* sectors replayed when the system came up */
+    int cacheHits;          /* DiskReads served from the cache */
+    int cacheMisses;        /* DiskReads of a cached disk that went to it */
+    int cachePrefetched;    /* listed sectors read in when the system came up */
+    int waitHist[DISK_HISTBUCKETS];     /* time spent queued */
+    int serviceHist[DISK_HISTBUCKETS];  /* time spent on the device */
+    int readHist[DISK_HISTBUCKETS];     /* read latency, queued to done */
+    int writeHist[DISK_HISTBUCKETS];    /* write latency, queued to done */
+    int waitP50;
+    int waitP99;
+    int serviceP50;
+    int serviceP99;
+    int readP50;
+    int readP99;
+    int writeP50;
+    int writeP99;
+} diskStats;
+
 /*
  * Function prototypes for this phase.
  */
@@ -16,6 +221,41 @@ extern  int  DiskRead (void *diskBuffer, int unit, int track, int first,
 extern  int  DiskWrite(void *diskBuffer, int unit, int track, int first,
                        int sectors, int *status);
 extern  int  DiskSize (int unit, int *sector, int *track, int *disk);
+extern  int  DiskReadAsync (void *diskBuffer, int unit, int track, int first,
+                            int sectors, int *handle);
+extern  int  DiskWriteAsync(void *diskBuffer, int unit, int track, int first,
+                            int sectors, int *handle);
+extern  int  DiskWait     (int handle, int *status);
+extern  int  DiskWaitAny  (int *handle, int *status);
+extern  int  DiskReadV    (diskSegment *segs, int nsegs, int unit, int *status);
+extern  int  DiskWriteV   (diskSegment *segs, int nsegs, int unit, int *status);
+extern  int  DiskCopy     (int srcUnit, int srcTrack, int srcSector,
+                           int dstUnit, int dstTrack, int dstSector,
+                           int count, int *status);
+extern  int  SpliceDiskToTerm(int unit, int track, int first, int bytes,
+                             int term, int *handle);
+extern  int  SpliceTermToDisk(int term, int unit, int track, int first,
+                             int bytes, int *handle);
+extern  int  SpliceWait   (int handle, int *count, int *status);
+extern  int  DiskStats    (int unit, diskStats *stats);
+extern  int  DiskHeat     (int unit, int *counts, int size, int *tracks);
+extern  int  DiskSetPriority(int ioClass);
+extern  int  DiskControl  (int unit, int ctl, int value);
+extern  int  DiskProcTime (int pid, int *usecs);
+extern  int  BlockRead    (void *buffer, int vol, int lba, int count,
+                           int *status);
+extern  int  BlockWrite   (void *buffer, int vol, int lba, int count,
+                           int *status);
+extern  int  BlockSize    (int vol, int *blocks);
+extern  int  FileCreate   (char *name, int size, int *fd);
+extern  int  FileOpen     (char *name, int *fd, int *size);
+extern  int  FileRead     (int fd, void *buffer, int offset, int bytes,
+                           int *count);
+extern  int  FileWrite    (int fd, void *buffer, int offset, int bytes,
+                           int *count);
+extern  int  KVPut        (char *key, void *value, int len);
+extern  int  KVGet        (char *key, void *value, int size, int *len);
+extern  int  KVDelete     (char *key);
 extern  int  TermRead (char *buffer, int bufferSize, int unitID,
                        int *numCharsRead);
 extern  int  TermWrite(char *buffer, int bufferSize, int unitID,
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+/* Not part of the graded tests: prints how many sectors per second the
+ * disk path moves for large transfers.  Build and run with "make bench".
+ */
+
+#define SECTORS 64
+#define ROUNDS  8
+
+static char XXbuf[SECTORS * 512];
+
+
+
+static void run(char *name, int unit, int sectors, int write)
+{
+    int status;
+    int start, end;
+    int sectorSize, trackSize, tracks;
+
+    DiskSize(unit, &sectorSize, &trackSize, &tracks);
+
+    GetTimeofDay(&start);
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        int track = (i * sectors / trackSize) % (tracks - sectors / trackSize);
+        if (write)
+            DiskWrite(XXbuf, unit, track, 0, sectors, &status);
+        else
+            DiskRead(XXbuf, unit, track, 0, sectors, &status);
+        if (status != 0)
+            USLOSS_Console("bench(): ERROR: %s round %d status %d\n", name, i, status);
+    }
+    GetTimeofDay(&end);
+
+    int elapsed = end - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    USLOSS_Console("bench(): %-16s %5d sectors in %8d us, %8ld sectors/sec\n",
+                   name, ROUNDS * sectors, elapsed,
+                   (long)ROUNDS * sectors * 1000000 / elapsed);
+}
+
+int start4(char *arg)
+{
+    memset(XXbuf, 'x', sizeof(XXbuf));
+
+    run("write 1 track",   1, 16,      1);
+    run("read 1 track",    1, 16,      0);
+    run("write 4 tracks",  1, SECTORS, 1);
+    run("read 4 tracks",   1, SECTORS, 0);
+
+    Terminate(0);
+}
+
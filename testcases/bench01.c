@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+/* Not part of the graded tests: compares sequential block reads of one
+ * disk with the same reads of the striped volume.  Build and run with
+ * "make bench".
+ */
+
+#define BLOCKS 128
+#define ROUNDS 4
+
+static char XXbuf[BLOCKS * 512];
+
+
+
+static void run(char *name, int vol, int write)
+{
+    int status, size;
+    int start, end;
+
+    BlockSize(vol, &size);
+
+    GetTimeofDay(&start);
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        int lba = (i * BLOCKS) % (size - BLOCKS);
+        if (write)
+            BlockWrite(XXbuf, vol, lba, BLOCKS, &status);
+        else
+            BlockRead(XXbuf, vol, lba, BLOCKS, &status);
+        if (status != 0)
+            USLOSS_Console("bench(): ERROR: %s round %d status %d\n", name, i, status);
+    }
+    GetTimeofDay(&end);
+
+    int elapsed = end - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    USLOSS_Console("bench(): %-16s %5d blocks in %8d us, %8ld blocks/sec\n",
+                   name, ROUNDS * BLOCKS, elapsed,
+                   (long)ROUNDS * BLOCKS * 1000000 / elapsed);
+}
+
+int start4(char *arg)
+{
+    memset(XXbuf, 'x', sizeof(XXbuf));
+
+    run("write disk 0",  BLOCK_VOL_DISK0,  1);
+    run("read disk 0",   BLOCK_VOL_DISK0,  0);
+    run("write stripe",  BLOCK_VOL_STRIPE, 1);
+    run("read stripe",   BLOCK_VOL_STRIPE, 0);
+
+    Terminate(0);
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+/* Not part of the graded tests: compares scattered one block writes to
+ * disk 0 with the same writes to the log structured volume on it.  Build
+ * and run with "make bench".
+ */
+
+#define WRITES 64
+
+static char XXbuf[512];
+static unsigned int seed;
+
+
+
+static int next(int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static void run(char *name, int vol)
+{
+    int status, size;
+    int start, end;
+
+    BlockSize(vol, &size);
+    seed = 1;
+
+    GetTimeofDay(&start);
+    for (int i = 0; i < WRITES; i++)
+    {
+        BlockWrite(XXbuf, vol, next(size), 1, &status);
+        if (status != 0)
+            USLOSS_Console("bench(): ERROR: %s write %d status %d\n", name, i, status);
+    }
+    GetTimeofDay(&end);
+
+    int elapsed = end - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    USLOSS_Console("bench(): %-16s %5d blocks in %8d us, %8ld blocks/sec\n",
+                   name, WRITES, elapsed, (long)WRITES * 1000000 / elapsed);
+}
+
+int start4(char *arg)
+{
+    memset(XXbuf, 'x', sizeof(XXbuf));
+
+    run("random disk 0", BLOCK_VOL_DISK0);
+    run("random log 0",  BLOCK_VOL_LOG0);
+
+    Terminate(0);
+}
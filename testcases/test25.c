@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[3][512];
+static int tracks[3] = { 7, 2, 5 };
+
+
+
+int start4(char *arg)
+{
+    int handle[3];
+    int done, status, sum, retval;
+
+    USLOSS_Console("start4(): async disk test.  Queue 3 writes on disk 1 at once,\n");
+    USLOSS_Console("          collect them with DiskWaitAny, then read them back\n");
+    USLOSS_Console("          with 3 async reads collected by DiskWait.\n");
+
+    strcpy(XXbuf[0], "One flew East");
+    strcpy(XXbuf[1], "One flew West");
+    strcpy(XXbuf[2], "One flew over the coo-coo's nest");
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (DiskWriteAsync(XXbuf[i], 1, tracks[i], 3, 1, &handle[i]) < 0)
+            USLOSS_Console("start4(): ERROR: DiskWriteAsync %d\n", i);
+    }
+
+    sum = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (DiskWaitAny(&done, &status) < 0)
+            USLOSS_Console("start4(): ERROR: DiskWaitAny %d\n", i);
+        sum += status;
+    }
+    USLOSS_Console("start4(): collected 3 writes, status sum = %d\n", sum);
+
+    retval = DiskWaitAny(&done, &status);
+    USLOSS_Console("start4(): DiskWaitAny with nothing outstanding returned %d\n", retval);
+
+    retval = DiskWait(handle[0], &status);
+    USLOSS_Console("start4(): DiskWait on a reaped handle returned %d\n", retval);
+
+    for (int i = 0; i < 3; i++)
+    {
+        strcpy(XXbuf[i], "xxx");
+        if (DiskReadAsync(XXbuf[i], 1, tracks[i], 3, 1, &handle[i]) < 0)
+            USLOSS_Console("start4(): ERROR: DiskReadAsync %d\n", i);
+    }
+
+    for (int i = 2; i >= 0; i--)
+    {
+        if (DiskWait(handle[i], &status) < 0 || status != 0)
+            USLOSS_Console("start4(): ERROR: DiskWait %d\n", i);
+    }
+
+    for (int i = 0; i < 3; i++)
+        USLOSS_Console("start4(): read track %d: %s\n", tracks[i], XXbuf[i]);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[4][512];
+static char YYbuf[2][1024];
+
+
+
+int start4(char *arg)
+{
+    diskSegment segs[4];
+    int status, retval;
+
+    USLOSS_Console("start4(): vectored disk test.  Write 4 scattered sectors on\n");
+    USLOSS_Console("          disk 0 with one DiskWriteV, then read them back with\n");
+    USLOSS_Console("          one DiskReadV into 2 two-sector buffers.\n");
+
+    strcpy(XXbuf[0], "One flew East");
+    strcpy(XXbuf[1], "One flew West");
+    strcpy(XXbuf[2], "One flew over the coo-coo's nest");
+    strcpy(XXbuf[3], "--did it work?");
+
+    segs[0].track = 9;  segs[0].first = 14; segs[0].count = 1; segs[0].buffer = XXbuf[0];
+    segs[1].track = 9;  segs[1].first = 15; segs[1].count = 1; segs[1].buffer = XXbuf[1];
+    segs[2].track = 2;  segs[2].first = 6;  segs[2].count = 1; segs[2].buffer = XXbuf[2];
+    segs[3].track = 2;  segs[3].first = 7;  segs[3].count = 1; segs[3].buffer = XXbuf[3];
+
+    retval = DiskWriteV(segs, 4, 0, &status);
+    USLOSS_Console("start4(): DiskWriteV returned %d, status = %d\n", retval, status);
+
+    segs[0].track = 2;  segs[0].first = 6;  segs[0].count = 2; segs[0].buffer = YYbuf[0];
+    segs[1].track = 9;  segs[1].first = 14; segs[1].count = 2; segs[1].buffer = YYbuf[1];
+
+    retval = DiskReadV(segs, 2, 0, &status);
+    USLOSS_Console("start4(): DiskReadV returned %d, status = %d\n", retval, status);
+
+    USLOSS_Console("start4(): read: %s\n", YYbuf[1]);
+    USLOSS_Console("start4(): read: %s\n", YYbuf[1] + 512);
+    USLOSS_Console("start4(): read: %s\n", YYbuf[0]);
+    USLOSS_Console("start4(): read: %s\n", YYbuf[0] + 512);
+
+    retval = DiskReadV(segs, 0, 0, &status);
+    USLOSS_Console("start4(): DiskReadV with no segments returned %d\n", retval);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[4][512];
+static char YYbuf[3][3*512];
+
+
+
+int start4(char *arg)
+{
+    int handle[4];
+    int status;
+
+    USLOSS_Console("start4(): request merging test.  Queue 4 async writes of\n");
+    USLOSS_Console("          neighbouring sectors on disk 0 track 11, then 3 async\n");
+    USLOSS_Console("          reads that overlap each other, and check the data.\n");
+
+    strcpy(XXbuf[0], "One flew East");
+    strcpy(XXbuf[1], "One flew West");
+    strcpy(XXbuf[2], "One flew over the coo-coo's nest");
+    strcpy(XXbuf[3], "--did it work?");
+
+    for (int i = 0; i < 4; i++)
+        DiskWriteAsync(XXbuf[i], 0, 11, i, 1, &handle[i]);
+    for (int i = 0; i < 4; i++)
+    {
+        if (DiskWait(handle[i], &status) < 0 || status != 0)
+            USLOSS_Console("start4(): ERROR: write %d\n", i);
+    }
+
+    DiskReadAsync(YYbuf[0], 0, 11, 0, 3, &handle[0]);
+    DiskReadAsync(YYbuf[1], 0, 11, 1, 3, &handle[1]);
+    DiskReadAsync(YYbuf[2], 0, 11, 2, 1, &handle[2]);
+    for (int i = 0; i < 3; i++)
+    {
+        if (DiskWait(handle[i], &status) < 0 || status != 0)
+            USLOSS_Console("start4(): ERROR: read %d\n", i);
+    }
+
+    USLOSS_Console("start4(): read A: %s | %s | %s\n", YYbuf[0], YYbuf[0]+512, YYbuf[0]+1024);
+    USLOSS_Console("start4(): read B: %s | %s | %s\n", YYbuf[1], YYbuf[1]+512, YYbuf[1]+1024);
+    USLOSS_Console("start4(): read C: %s\n", YYbuf[2]);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[3][512];
+static char YYbuf[3][512];
+
+
+
+int start4(char *arg)
+{
+    int handle[6];
+    int status;
+
+    USLOSS_Console("start4(): duplicate request test.  Queue 2 writes of the same\n");
+    USLOSS_Console("          sector on disk 0 track 12, then 2 reads of it, then\n");
+    USLOSS_Console("          a write and a read of it again.  Each read must see\n");
+    USLOSS_Console("          the latest write queued before it.\n");
+
+    strcpy(XXbuf[0], "One flew East");
+    strcpy(XXbuf[1], "One flew West");
+    strcpy(XXbuf[2], "One flew over the coo-coo's nest");
+
+    DiskWriteAsync(XXbuf[0], 0, 12, 0, 1, &handle[0]);
+    DiskWriteAsync(XXbuf[0], 0, 12, 5, 1, &handle[1]);
+    DiskWriteAsync(XXbuf[1], 0, 12, 5, 1, &handle[2]);
+    DiskReadAsync (YYbuf[0], 0, 12, 5, 1, &handle[3]);
+    DiskReadAsync (YYbuf[1], 0, 12, 5, 1, &handle[4]);
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (DiskWait(handle[i], &status) < 0 || status != 0)
+            USLOSS_Console("start4(): ERROR: request %d\n", i);
+    }
+
+    DiskWriteAsync(XXbuf[2], 0, 12, 5, 1, &handle[0]);
+    DiskReadAsync (YYbuf[2], 0, 12, 5, 1, &handle[1]);
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (DiskWait(handle[i], &status) < 0 || status != 0)
+            USLOSS_Console("start4(): ERROR: request %d\n", i);
+    }
+
+    for (int i = 0; i < 3; i++)
+        USLOSS_Console("start4(): read %d: %s\n", i, YYbuf[i]);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[3][512];
+
+
+
+int start4(char *arg)
+{
+    int status;
+    diskStats stats;
+
+    USLOSS_Console("start4(): disk stats test.  Write 2 sectors of disk 1 track 4,\n");
+    USLOSS_Console("          read 3 sectors starting at track 4 sector 15, then\n");
+    USLOSS_Console("          check the counters of disk 1.\n");
+
+    strcpy(XXbuf[0], "One flew East");
+    strcpy(XXbuf[1], "One flew West");
+
+    DiskWrite(XXbuf[0], 1, 4, 0, 2, &status);
+    if (status != 0)
+        USLOSS_Console("start4(): ERROR: write status %d\n", status);
+
+    DiskRead(XXbuf[0], 1, 4, 15, 3, &status);
+    if (status != 0)
+        USLOSS_Console("start4(): ERROR: read status %d\n", status);
+
+    if (DiskStats(1, &stats) != 0)
+        USLOSS_Console("start4(): ERROR: DiskStats failed\n");
+
+    int waits = 0, services = 0;
+    for (int i = 0; i < DISK_HISTBUCKETS; i++)
+    {
+        waits += stats.waitHist[i];
+        services += stats.serviceHist[i];
+    }
+
+    USLOSS_Console("start4(): reads %d writes %d\n", stats.reads, stats.writes);
+    USLOSS_Console("start4(): sectors read %d written %d\n", stats.sectorsRead, stats.sectorsWritten);
+    USLOSS_Console("start4(): seeks %d distance %d\n", stats.seeks, stats.seekDistance);
+    USLOSS_Console("start4(): queue depth %d peak %d\n", stats.queueDepth, stats.peakQueueDepth);
+    USLOSS_Console("start4(): timed waits %d services %d\n", waits, services);
+
+    if (stats.waitP50 > stats.waitP99 || stats.serviceP50 > stats.serviceP99)
+        USLOSS_Console("start4(): ERROR: percentiles out of order\n");
+
+    USLOSS_Console("start4(): DiskStats of unit 7 returned %d\n", DiskStats(7, &stats));
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
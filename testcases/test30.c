@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[16][512];
+static char YYbuf[3][512];
+
+
+
+int child(char *arg)
+{
+    int status;
+    int ioClass = arg[0] - '0';
+    int track = 10 * (DISK_NCLASSES - ioClass);
+
+    if (DiskSetPriority(ioClass) != 0)
+        USLOSS_Console("child(): ERROR: DiskSetPriority(%d)\n", ioClass);
+
+    DiskRead(YYbuf[ioClass], 1, track, 0, 1, &status);
+    USLOSS_Console("child(): class %d read of track %d done, status %d\n", ioClass, track, status);
+
+    Terminate(ioClass);
+}
+
+int start4(char *arg)
+{
+    int handle, status, pid;
+
+    USLOSS_Console("start4(): I/O priority test.  Keep disk 1 busy with a write,\n");
+    USLOSS_Console("          then queue an idle read of track 10, a best-effort\n");
+    USLOSS_Console("          read of track 20 and a real-time read of track 30.\n");
+    USLOSS_Console("          They must finish real-time first, idle last.\n");
+
+    DiskWriteAsync(XXbuf[0], 1, 0, 0, 16, &handle);
+
+    Spawn("idle", child, "2", USLOSS_MIN_STACK, 2, &pid);
+    Spawn("be",   child, "1", USLOSS_MIN_STACK, 2, &pid);
+    Spawn("rt",   child, "0", USLOSS_MIN_STACK, 2, &pid);
+
+    if (DiskWait(handle, &status) < 0 || status != 0)
+        USLOSS_Console("start4(): ERROR: write\n");
+
+    Wait(&pid, &status);
+    Wait(&pid, &status);
+    Wait(&pid, &status);
+
+    USLOSS_Console("start4(): DiskSetPriority(7) returned %d\n", DiskSetPriority(7));
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[6][512];
+static char YYbuf[512];
+
+
+
+int hog(char *arg)
+{
+    int handle[6];
+    int done, status;
+
+    for (int i = 0; i < 6; i++)
+        DiskReadAsync(XXbuf[i], 1, 2, i, 1, &handle[i]);
+
+    for (int n = 0; n < 6; n++)
+    {
+        DiskWaitAny(&done, &status);
+        for (int i = 0; i < 6; i++)
+        {
+            if (handle[i] == done)
+                USLOSS_Console("hog(): read of track 2 sector %d done\n", i);
+        }
+    }
+
+    Terminate(1);
+}
+
+int other(char *arg)
+{
+    int status;
+
+    DiskRead(YYbuf, 1, 3, 0, 1, &status);
+    USLOSS_Console("other(): read of track 3 done\n");
+
+    Terminate(2);
+}
+
+int start4(char *arg)
+{
+    int status, pid, hogPid, otherPid;
+    int hogTime, otherTime;
+
+    USLOSS_Console("start4(): fair queueing test.  Put disk 1 in CFQ mode with\n");
+    USLOSS_Console("          2 sectors per turn.  hog queues 6 reads of track 2,\n");
+    USLOSS_Console("          then other queues 1 read of track 3, which must not\n");
+    USLOSS_Console("          wait for all of hog's reads.\n");
+
+    if (DiskControl(1, DISK_CTL_SCHED, DISK_SCHED_CFQ) != 0)
+        USLOSS_Console("start4(): ERROR: DiskControl sched\n");
+    if (DiskControl(1, DISK_CTL_CFQSLICE, 2) != 0)
+        USLOSS_Console("start4(): ERROR: DiskControl slice\n");
+
+    Spawn("hog",   hog,   NULL, USLOSS_MIN_STACK, 2, &hogPid);
+    Spawn("other", other, NULL, USLOSS_MIN_STACK, 2, &otherPid);
+
+    Wait(&pid, &status);
+    Wait(&pid, &status);
+
+    DiskProcTime(hogPid, &hogTime);
+    DiskProcTime(otherPid, &otherTime);
+    USLOSS_Console("start4(): hog used more disk time than other: %s\n",
+                   hogTime > otherTime ? "yes" : "no");
+
+    USLOSS_Console("start4(): DiskControl(1, 9, 0) returned %d\n", DiskControl(1, 9, 0));
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[512];
+static char YYbuf[512];
+static char ZZbuf[512];
+static int idleDone;
+
+
+
+int up(char *arg)
+{
+    int status;
+
+    for (int track = 1; track <= 4; track++)
+    {
+        DiskRead(XXbuf, 1, track, 0, 1, &status);
+        USLOSS_Console("up(): read of track %d done\n", track);
+    }
+
+    Terminate(1);
+}
+
+int down(char *arg)
+{
+    int status;
+
+    for (int track = 30; track >= 27; track--)
+    {
+        DiskRead(YYbuf, 1, track, 0, 1, &status);
+        USLOSS_Console("down(): read of track %d done\n", track);
+    }
+
+    Terminate(2);
+}
+
+int urgent(char *arg)
+{
+    int status;
+
+    DiskSetPriority(DISK_CLASS_RT);
+    DiskRead(ZZbuf, 1, 30, 0, 1, &status);
+    USLOSS_Console("urgent(): read of track 30 done after %d idle reads\n", idleDone);
+
+    Terminate(3);
+}
+
+int idle(char *arg)
+{
+    int status, pid;
+
+    DiskSetPriority(DISK_CLASS_IDLE);
+    for (int track = 1; track <= 16; track++)
+    {
+        DiskRead(XXbuf, 1, track, 0, 1, &status);
+        idleDone++;
+
+        // the real-time read arrives while the head waits for the next one
+        if (track == 2)
+            Spawn("urgent", urgent, NULL, USLOSS_MIN_STACK, 1, &pid);
+    }
+    Wait(&pid, &status);
+    USLOSS_Console("idle(): all %d reads done\n", idleDone);
+
+    Terminate(4);
+}
+
+int start4(char *arg)
+{
+    int status, pid;
+    diskStats stats;
+
+    USLOSS_Console("start4(): anticipatory scheduling test.  Two processes read\n");
+    USLOSS_Console("          disk 1 one track at a time, one going up from\n");
+    USLOSS_Console("          track 1, one going down from track 30.  Each one's\n");
+    USLOSS_Console("          reads must run back to back.  Then a real-time\n");
+    USLOSS_Console("          read must cut into an idle reader's run.\n");
+
+    if (DiskControl(1, DISK_CTL_SCHED, DISK_SCHED_AS) != 0)
+        USLOSS_Console("start4(): ERROR: DiskControl sched\n");
+    if (DiskControl(1, DISK_CTL_ANTICWINDOW, 200000) != 0)
+        USLOSS_Console("start4(): ERROR: DiskControl window\n");
+
+    Spawn("up",   up,   NULL, USLOSS_MIN_STACK, 2, &pid);
+    Spawn("down", down, NULL, USLOSS_MIN_STACK, 2, &pid);
+
+    Wait(&pid, &status);
+    Wait(&pid, &status);
+
+    DiskStats(1, &stats);
+    USLOSS_Console("start4(): follow-ups caught %d\n", stats.anticipationHits);
+
+    // an idle class reader gets no follow-ups while a real-time read waits
+    Spawn("idle", idle, NULL, USLOSS_MIN_STACK, 2, &pid);
+    Wait(&pid, &status);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[3][512];
+static char YYbuf[3][512];
+
+static char *names[6] = {
+    "write of track 1", "write of track 2", "write of track 3",
+    "read of track 10", "read of track 2",  "read of track 11"
+};
+
+
+
+int start4(char *arg)
+{
+    int handle[6];
+    int done, status;
+
+    USLOSS_Console("start4(): read preference test.  While a write of disk 1\n");
+    USLOSS_Console("          track 1 is on the device, queue writes of tracks 2\n");
+    USLOSS_Console("          and 3 and reads of tracks 10, 2 and 11.  The reads\n");
+    USLOSS_Console("          go first, except the one that must see the write\n");
+    USLOSS_Console("          of track 2 queued before it.\n");
+
+    strcpy(XXbuf[0], "One flew East");
+    strcpy(XXbuf[1], "One flew West");
+    strcpy(XXbuf[2], "One flew over the coo-coo's nest");
+
+    DiskWriteAsync(XXbuf[0], 1, 1, 0, 1, &handle[0]);
+    DiskWriteAsync(XXbuf[1], 1, 2, 0, 1, &handle[1]);
+    DiskWriteAsync(XXbuf[2], 1, 3, 0, 1, &handle[2]);
+    DiskReadAsync (YYbuf[0], 1, 10, 0, 1, &handle[3]);
+    DiskReadAsync (YYbuf[1], 1, 2, 0, 1, &handle[4]);
+    DiskReadAsync (YYbuf[2], 1, 11, 0, 1, &handle[5]);
+
+    for (int n = 0; n < 6; n++)
+    {
+        DiskWaitAny(&done, &status);
+        for (int i = 0; i < 6; i++)
+        {
+            if (handle[i] == done)
+                USLOSS_Console("start4(): %s done, status %d\n", names[i], status);
+        }
+    }
+
+    USLOSS_Console("start4(): read of track 2: %s\n", YYbuf[1]);
+    USLOSS_Console("start4(): DiskControl(1, DISK_CTL_WRITESTARVE, 0) returned %d\n",
+                   DiskControl(1, DISK_CTL_WRITESTARVE, 0));
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
+
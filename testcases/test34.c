@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define BLOCKS 40
+#define FIRST  10
+
+static char XXbuf[BLOCKS][512];
+static char YYbuf[BLOCKS][512];
+static char ZZbuf[512];
+
+
+
+int start4(char *arg)
+{
+    int status, blocks, rc;
+    int bad = 0;
+
+    USLOSS_Console("start4(): block layer test.  Write %d blocks of the striped\n", BLOCKS);
+    USLOSS_Console("          volume starting at block %d, read them back, and\n", FIRST);
+    USLOSS_Console("          check where two of them landed on the disks.\n");
+
+    rc = BlockSize(BLOCK_VOL_STRIPE, &blocks);
+    USLOSS_Console("start4(): BlockSize(BLOCK_VOL_STRIPE) returned %d, %d blocks\n", rc, blocks);
+
+    for (int i = 0; i < BLOCKS; i++)
+        sprintf(XXbuf[i], "block %d", FIRST + i);
+
+    rc = BlockWrite(XXbuf, BLOCK_VOL_STRIPE, FIRST, BLOCKS, &status);
+    USLOSS_Console("start4(): BlockWrite returned %d, status %d\n", rc, status);
+
+    rc = BlockRead(YYbuf, BLOCK_VOL_STRIPE, FIRST, BLOCKS, &status);
+    USLOSS_Console("start4(): BlockRead returned %d, status %d\n", rc, status);
+
+    for (int i = 0; i < BLOCKS; i++)
+    {
+        if (strcmp(XXbuf[i], YYbuf[i]) != 0)
+            bad++;
+    }
+    USLOSS_Console("start4(): %d blocks differ\n", bad);
+
+    DiskRead(ZZbuf, 1, 0, 0, 1, &status);
+    USLOSS_Console("start4(): disk 1 track 0 sector 0: %s\n", ZZbuf);
+    DiskRead(ZZbuf, 0, 1, 0, 1, &status);
+    USLOSS_Console("start4(): disk 0 track 1 sector 0: %s\n", ZZbuf);
+
+    rc = BlockRead(YYbuf, BLOCK_VOL_STRIPE, blocks - 1, 2, &status);
+    USLOSS_Console("start4(): BlockRead past the end returned %d\n", rc);
+    rc = BlockRead(YYbuf, BLOCK_VOL_STRIPE, 16, 0x7fffffff, &status);
+    USLOSS_Console("start4(): BlockRead of 0x7fffffff blocks returned %d\n", rc);
+    rc = BlockRead(YYbuf, BLOCK_NVOLS, 0, 1, &status);
+    USLOSS_Console("start4(): BlockRead of a bad volume returned %d\n", rc);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
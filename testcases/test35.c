@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define BLOCKS 20
+
+static char XXbuf[BLOCKS][512];
+static char YYbuf[BLOCKS][512];
+static char ZZbuf[3][512];
+
+
+
+static void showSplit(char *when)
+{
+    diskStats s0, s1;
+
+    DiskStats(0, &s0);
+    DiskStats(1, &s1);
+    USLOSS_Console("start4(): %s: disk 0 served %d mirrored reads, disk 1 %d\n",
+                   when, s0.mirrorReads, s1.mirrorReads);
+}
+
+int start4(char *arg)
+{
+    int status, blocks, rc;
+    int handle[3];
+    int bad = 0;
+
+    USLOSS_Console("start4(): mirrored volume test.  Write %d blocks, check both\n", BLOCKS);
+    USLOSS_Console("          disks got them, then read while disk 0 is busy and\n");
+    USLOSS_Console("          again when only the heads differ.\n");
+
+    rc = BlockSize(BLOCK_VOL_MIRROR, &blocks);
+    USLOSS_Console("start4(): BlockSize(BLOCK_VOL_MIRROR) returned %d, %d blocks\n", rc, blocks);
+
+    for (int i = 0; i < BLOCKS; i++)
+        sprintf(XXbuf[i], "mirrored block %d", i);
+
+    rc = BlockWrite(XXbuf, BLOCK_VOL_MIRROR, 0, BLOCKS, &status);
+    USLOSS_Console("start4(): BlockWrite returned %d, status %d\n", rc, status);
+
+    DiskRead(ZZbuf[0], 0, 1, 3, 1, &status);
+    USLOSS_Console("start4(): disk 0 track 1 sector 3: %s\n", ZZbuf[0]);
+    DiskRead(ZZbuf[0], 1, 1, 3, 1, &status);
+    USLOSS_Console("start4(): disk 1 track 1 sector 3: %s\n", ZZbuf[0]);
+
+    // keep disk 0 busy, so the read goes to disk 1
+    DiskWriteAsync(ZZbuf[0], 0, 8, 0, 1, &handle[0]);
+    DiskWriteAsync(ZZbuf[1], 0, 9, 0, 1, &handle[1]);
+    DiskWriteAsync(ZZbuf[2], 0, 10, 0, 1, &handle[2]);
+
+    rc = BlockRead(YYbuf, BLOCK_VOL_MIRROR, 0, BLOCKS, &status);
+    USLOSS_Console("start4(): BlockRead returned %d, status %d\n", rc, status);
+    for (int i = 0; i < BLOCKS; i++)
+    {
+        if (strcmp(XXbuf[i], YYbuf[i]) != 0)
+            bad++;
+    }
+    USLOSS_Console("start4(): %d blocks differ\n", bad);
+    showSplit("disk 0 busy");
+
+    for (int i = 0; i < 3; i++)
+        DiskWait(handle[i], &status);
+
+    // both idle now, disk 0's head is on track 10 and disk 1's on track 1
+    rc = BlockRead(YYbuf, BLOCK_VOL_MIRROR, 9 * 16, 1, &status);
+    USLOSS_Console("start4(): BlockRead of track 9 returned %d, status %d\n", rc, status);
+    showSplit("both idle");
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
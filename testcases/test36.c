@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define USED   240
+#define ROUNDS 150
+
+static char shadow[USED][512];
+static char XXbuf[16][512];
+static char YYbuf[16][512];
+static unsigned int seed = 1;
+
+
+
+static int next(int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static void writeBlocks(int lba, int count, int round)
+{
+    int status;
+
+    for (int i = 0; i < count; i++)
+    {
+        sprintf(XXbuf[i], "log block %d, round %d", lba + i, round);
+        memcpy(shadow[lba + i], XXbuf[i], 512);
+    }
+    BlockWrite(XXbuf, BLOCK_VOL_LOG1, lba, count, &status);
+    if (status != 0)
+        USLOSS_Console("start4(): ERROR: write of block %d status %d\n", lba, status);
+}
+
+int start4(char *arg)
+{
+    int status, blocks, rc;
+    int bad = 0;
+
+    USLOSS_Console("start4(): log structured volume test.  Scattered writes\n");
+    USLOSS_Console("          land one after the other on disk 1; keep\n");
+    USLOSS_Console("          overwriting until the log has to be cleaned,\n");
+    USLOSS_Console("          then read everything back.\n");
+
+    rc = BlockSize(BLOCK_VOL_LOG1, &blocks);
+    USLOSS_Console("start4(): BlockSize(BLOCK_VOL_LOG1) returned %d, %d blocks\n", rc, blocks);
+
+    writeBlocks(200, 1, 0);
+    writeBlocks(7, 1, 0);
+    writeBlocks(150, 1, 0);
+    for (int s = 0; s < 3; s++)
+    {
+        DiskRead(YYbuf[0], 1, 0, s, 1, &status);
+        USLOSS_Console("start4(): disk 1 track 0 sector %d: %s\n", s, YYbuf[0]);
+    }
+
+    for (int lba = 0; lba < USED; lba += 16)
+        writeBlocks(lba, 16, 0);
+
+    for (int round = 1; round <= ROUNDS; round++)
+    {
+        int count = 1 + next(4);
+        writeBlocks(next(USED - count), count, round);
+    }
+
+    for (int lba = 0; lba < USED; lba += 16)
+    {
+        BlockRead(YYbuf, BLOCK_VOL_LOG1, lba, 16, &status);
+        for (int i = 0; i < 16; i++)
+        {
+            if (strcmp(YYbuf[i], shadow[lba + i]) != 0)
+                bad++;
+        }
+    }
+    USLOSS_Console("start4(): %d blocks differ\n", bad);
+
+    BlockRead(YYbuf, BLOCK_VOL_LOG1, blocks - 1, 1, &status);
+    USLOSS_Console("start4(): block never written reads as \"%s\"\n", YYbuf[0]);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define CHILDREN 4
+#define WRITES   5
+
+static char XXbuf[CHILDREN][512];
+static char YYbuf[512];
+
+
+
+int Child(char *arg)
+{
+    int me = atoi(arg);
+    int status;
+
+    for (int i = 0; i < WRITES; i++)
+    {
+        sprintf(XXbuf[me], "child %d write %d", me, i);
+        DiskWrite(XXbuf[me], 1, 20 + me, i, 1, &status);
+        if (status != 0)
+            USLOSS_Console("Child%d(): ERROR: write %d status %d\n", me, i, status);
+    }
+
+    Terminate(0);
+}
+
+int start4(char *arg)
+{
+    int pid, status, rc;
+    int sectorSize, trackSize, tracks;
+    int bad = 0;
+    char name[20], num[10];
+    diskStats stats;
+
+    USLOSS_Console("start4(): journal test.  Turn on the journal of disk 1, and\n");
+    USLOSS_Console("          have %d children each make %d one sector writes at\n", CHILDREN, WRITES);
+    USLOSS_Console("          once; they should share journal writes.\n");
+
+    rc = DiskControl(1, DISK_CTL_JOURNAL, 1);
+    DiskSize(1, &sectorSize, &trackSize, &tracks);
+    USLOSS_Console("start4(): DiskControl(1, DISK_CTL_JOURNAL, 1) returned %d, disk size %d\n", rc, tracks);
+
+    for (int i = 0; i < CHILDREN; i++)
+    {
+        sprintf(name, "Child%d", i);
+        sprintf(num, "%d", i);
+        Spawn(name, Child, num, USLOSS_MIN_STACK, 4, &pid);
+    }
+    for (int i = 0; i < CHILDREN; i++)
+        Wait(&pid, &status);
+
+    DiskStats(1, &stats);
+    USLOSS_Console("start4(): %d sectors journaled, in fewer journal writes: %s\n",
+                   stats.journalWrites,
+                   stats.journalBatches < stats.journalWrites ? "yes" : "no");
+
+    DiskRead(YYbuf, 1, 22, 4, 1, &status);
+    USLOSS_Console("start4(): disk 1 track 22 sector 4: %s\n", YYbuf);
+
+    DiskWrite(YYbuf, 1, 30, 0, 1, &status);
+    USLOSS_Console("start4(): write of journal track 30, status %d\n", status);
+
+    rc = DiskControl(1, DISK_CTL_JOURNAL, 0);
+    DiskSize(1, &sectorSize, &trackSize, &tracks);
+    USLOSS_Console("start4(): DiskControl(1, DISK_CTL_JOURNAL, 0) returned %d, disk size %d\n", rc, tracks);
+
+    for (int c = 0; c < CHILDREN; c++)
+    {
+        char expect[512];
+        sprintf(expect, "child %d write %d", c, WRITES - 1);
+        DiskRead(YYbuf, 1, 20 + c, WRITES - 1, 1, &status);
+        if (strcmp(YYbuf, expect) != 0)
+            bad++;
+    }
+    USLOSS_Console("start4(): %d last writes missing at home\n", bad);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define RECORDS 40
+#define RECSIZE 300
+
+static char XXbuf[RECSIZE];
+static char YYbuf[RECORDS * RECSIZE];
+
+
+
+int start4(char *arg)
+{
+    int fd, other, size, count, rc;
+    int sector, track, disk;
+    int bad = 0;
+
+    USLOSS_Console("start4(): file store test.  Append %d records of %d bytes to\n", RECORDS, RECSIZE);
+    USLOSS_Console("          a file created with room for 8192, so it has to\n");
+    USLOSS_Console("          grow, then read it back in one call.\n");
+
+    rc = DiskControl(1, DISK_CTL_FILES, 8);
+    DiskSize(1, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_FILES, 8) returned %d, disk 1 has %d tracks\n", rc, disk);
+    rc = DiskControl(1, DISK_CTL_FILES, 4);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_FILES, 4) returned %d\n", rc);
+
+    rc = FileCreate("notes", 8192, &fd);
+    USLOSS_Console("start4(): FileCreate(\"notes\") returned %d\n", rc);
+    rc = FileCreate("other", 1000, &other);
+    USLOSS_Console("start4(): FileCreate(\"other\") returned %d\n", rc);
+
+    for (int i = 0; i < RECORDS; i++)
+    {
+        memset(XXbuf, 'a' + i % 26, RECSIZE);
+        sprintf(XXbuf, "record %d", i);
+        FileWrite(fd, XXbuf, i * RECSIZE, RECSIZE, &count);
+        if (count != RECSIZE)
+            USLOSS_Console("start4(): ERROR: record %d wrote %d\n", i, count);
+    }
+    FileWrite(other, "hello", 0, 6, &count);
+
+    rc = FileOpen("notes", &fd, &size);
+    USLOSS_Console("start4(): FileOpen(\"notes\") returned %d, size %d\n", rc, size);
+
+    FileRead(fd, YYbuf, 0, size, &count);
+    USLOSS_Console("start4(): FileRead of the whole file read %d bytes\n", count);
+    for (int i = 0; i < RECORDS; i++)
+    {
+        char expect[20];
+        sprintf(expect, "record %d", i);
+        if (strcmp(YYbuf + i * RECSIZE, expect) != 0 ||
+            YYbuf[i * RECSIZE + RECSIZE - 1] != 'a' + i % 26)
+            bad++;
+    }
+    USLOSS_Console("start4(): %d records differ\n", bad);
+
+    FileRead(fd, YYbuf, size - 100, 500, &count);
+    USLOSS_Console("start4(): FileRead 100 bytes before the end read %d bytes\n", count);
+
+    rc = FileRead(fd, YYbuf, 500, 0x7fffffff, &count);
+    USLOSS_Console("start4(): FileRead of 0x7fffffff bytes at 500 returned %d, read %d bytes\n", rc, count);
+    rc = FileWrite(fd, XXbuf, 512, 0x7fffff9b, &count);
+    USLOSS_Console("start4(): FileWrite of 0x7fffff9b bytes at 512 returned %d\n", rc);
+
+    FileRead(other, YYbuf, 0, 100, &count);
+    USLOSS_Console("start4(): \"other\" holds %d bytes: %s\n", count, YYbuf);
+
+    USLOSS_Console("start4(): FileOpen(\"missing\") returned %d\n", FileOpen("missing", &fd, &size));
+
+    rc = DiskControl(1, DISK_CTL_FILES, 0);
+    DiskSize(1, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_FILES, 0) returned %d, disk 1 has %d tracks\n", rc, disk);
+    USLOSS_Console("start4(): FileOpen(\"notes\") afterwards returned %d\n", FileOpen("notes", &fd, &size));
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
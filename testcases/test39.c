@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define KEYS 12
+
+static char XXbuf[KV_MAXVALUE];
+
+
+
+int start4(char *arg)
+{
+    char key[KV_KEYLEN], value[64];
+    diskStats before, after;
+    int len, rc;
+    int sector, track, disk;
+    int bad = 0;
+
+    USLOSS_Console("start4(): key-value store test.  Put %d keys, more than the\n", KEYS);
+    USLOSS_Console("          store keeps in memory, then look them up cold and hot.\n");
+
+    rc = KVPut("early", "nowhere", 8);
+    USLOSS_Console("start4(): KVPut() before the store has tracks returned %d\n", rc);
+
+    DiskSize(0, &sector, &track, &disk);
+    USLOSS_Console("start4(): disk 0 has %d tracks\n", disk);
+    rc = DiskControl(0, DISK_CTL_KV, 4);
+    DiskSize(0, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_KV, 4) returned %d, disk 0 has %d tracks\n", rc, disk);
+
+    for (int i = 0; i < KEYS; i++)
+    {
+        sprintf(key, "user%d", i);
+        sprintf(value, "value of user %d", i);
+        if (KVPut(key, value, strlen(value) + 1) != 0)
+            USLOSS_Console("start4(): ERROR: KVPut(\"%s\") failed\n", key);
+    }
+
+    rc = KVPut("user3", "updated", 8);
+    USLOSS_Console("start4(): KVPut(\"user3\") again returned %d\n", rc);
+    rc = KVDelete("user5");
+    USLOSS_Console("start4(): KVDelete(\"user5\") returned %d\n", rc);
+
+    for (int i = 0; i < KEYS; i++)
+    {
+        sprintf(key, "user%d", i);
+        sprintf(value, "value of user %d", i);
+        rc = KVGet(key, XXbuf, sizeof(XXbuf), &len);
+        if (i == 3)
+            bad += rc != 0 || strcmp(XXbuf, "updated") != 0;
+        else if (i == 5)
+            bad += rc != -1;
+        else
+            bad += rc != 0 || len != strlen(value) + 1 || strcmp(XXbuf, value) != 0;
+    }
+    USLOSS_Console("start4(): %d lookups differ\n", bad);
+
+    // the lookups above left user0 out of memory and user11 in it
+    DiskStats(0, &before);
+    KVGet("user0", XXbuf, sizeof(XXbuf), &len);
+    DiskStats(0, &after);
+    USLOSS_Console("start4(): cold lookup of \"user0\": %d disk reads, %s\n", after.reads - before.reads, XXbuf);
+
+    DiskStats(0, &before);
+    KVGet("user0", XXbuf, sizeof(XXbuf), &len);
+    DiskStats(0, &after);
+    USLOSS_Console("start4(): hot lookup of \"user0\": %d disk reads, %s\n", after.reads - before.reads, XXbuf);
+
+    memset(XXbuf, 0, sizeof(XXbuf));
+    rc = KVGet("user7", XXbuf, 5, &len);
+    USLOSS_Console("start4(): KVGet(\"user7\") into 5 bytes returned %d, length %d, got \"%s\"\n", rc, len, XXbuf);
+
+    USLOSS_Console("start4(): KVGet(\"user5\") returned %d\n", KVGet("user5", XXbuf, sizeof(XXbuf), &len));
+    USLOSS_Console("start4(): KVDelete(\"ghost\") returned %d\n", KVDelete("ghost"));
+
+    rc = DiskControl(0, DISK_CTL_KV, 0);
+    DiskSize(0, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_KV, 0) returned %d, disk 0 has %d tracks\n", rc, disk);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
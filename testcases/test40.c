@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define READS 400
+
+static char XXbuf[USLOSS_DISK_TRACK_SIZE * 512];
+static int heat[256];
+static int heatBefore[256];
+
+
+
+int start4(char *arg)
+{
+    diskStats before, after;
+    int blocks, tracks, last, status, rc;
+    int sector, track, disk;
+    int bad = 0;
+    int middle = 0;
+
+    USLOSS_Console("start4(): track migration test.  Read the first and the last\n");
+    USLOSS_Console("          track of disk 1 in turn and let the migrator move\n");
+    USLOSS_Console("          them to the middle.\n");
+
+    // the table is saved on the disk, which takes its last tracks
+    rc = DiskControl(1, DISK_CTL_MIGRATE, 1);
+    DiskSize(1, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_MIGRATE) returned %d, disk 1 has %d tracks\n", rc, disk);
+
+    BlockSize(BLOCK_VOL_DISK1, &blocks);
+    last = blocks / USLOSS_DISK_TRACK_SIZE - 1;
+    for (int lba = 0; lba < blocks; lba += USLOSS_DISK_TRACK_SIZE)
+    {
+        for (int i = 0; i < USLOSS_DISK_TRACK_SIZE; i++)
+            sprintf(XXbuf + i * 512, "block %d", lba + i);
+        BlockWrite(XXbuf, BLOCK_VOL_DISK1, lba, USLOSS_DISK_TRACK_SIZE, &status);
+    }
+
+    rc = DiskHeat(1, heatBefore, 256, &tracks);
+    USLOSS_Console("start4(): DiskHeat returned %d, %d tracks\n", rc, tracks);
+
+    DiskStats(1, &before);
+    for (int i = 0; i < READS; i++)
+    {
+        int lba = i % 2 == 0 ? 0 : blocks - 1;
+        BlockRead(XXbuf, BLOCK_VOL_DISK1, lba, 1, &status);
+
+        if (i == 19)
+        {
+            DiskStats(1, &after);
+            USLOSS_Console("start4(): first 20 reads seek more than 20 tracks each: %s\n",
+                           after.seekDistance - before.seekDistance > 20 * 20 ? "yes" : "no");
+
+            // the migrator has not had a turn yet, so they hit both ends
+            DiskHeat(1, heat, 256, &tracks);
+            USLOSS_Console("start4(): first 20 reads heat track 0 by %d, track %d by %d\n",
+                           heat[0] - heatBefore[0], last, heat[last] - heatBefore[last]);
+        }
+        if (i == READS - 21)
+        {
+            DiskStats(1, &before);
+            DiskHeat(1, heatBefore, 256, &tracks);
+        }
+    }
+    DiskStats(1, &after);
+    USLOSS_Console("start4(): last 20 reads seek at most 2 tracks each: %s\n",
+                   after.seekDistance - before.seekDistance <= 2 * 20 ? "yes" : "no");
+
+    // by now both hot tracks were swapped with cold ones near the middle
+    DiskHeat(1, heat, 256, &tracks);
+    for (int t = (last + 1) / 4; t <= last - (last + 1) / 4; t++)
+        middle += heat[t] - heatBefore[t];
+    USLOSS_Console("start4(): last 20 reads heat track 0 by %d, track %d by %d\n",
+                   heat[0] - heatBefore[0], last, heat[last] - heatBefore[last]);
+    USLOSS_Console("start4(): last 20 reads heat the middle half by %d\n", middle);
+
+    for (int lba = 0; lba < blocks; lba++)
+    {
+        char expect[20];
+        BlockRead(XXbuf, BLOCK_VOL_DISK1, lba, 1, &status);
+        sprintf(expect, "block %d", lba);
+        if (strcmp(XXbuf, expect) != 0)
+            bad++;
+    }
+    USLOSS_Console("start4(): %d of %d blocks differ after the moves\n", bad, blocks);
+
+    // turning it off moves every track home, so the disk reads the same directly
+    rc = DiskControl(1, DISK_CTL_MIGRATE, 0);
+    DiskSize(1, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_MIGRATE, 0) returned %d, disk 1 has %d tracks\n", rc, disk);
+
+    bad = 0;
+    for (int t = 0; t <= last; t++)
+    {
+        char expect[20];
+        DiskRead(XXbuf, 1, t, 0, 1, &status);
+        sprintf(expect, "block %d", t * USLOSS_DISK_TRACK_SIZE);
+        if (strcmp(XXbuf, expect) != 0)
+            bad++;
+    }
+    USLOSS_Console("start4(): %d of %d tracks away from home\n", bad, last + 1);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
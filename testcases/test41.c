@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+static char XXbuf[4 * 512];
+static char YYbuf[512];
+
+
+
+static int deviceReads(void)
+{
+    diskStats stats;
+    DiskStats(1, &stats);
+    return stats.reads;
+}
+
+int start4(char *arg)
+{
+    int sector, track, disk, status, rc, before;
+    diskStats stats;
+
+    USLOSS_Console("start4(): read cache test.  Turn the cache of disk 1 on, read\n");
+    USLOSS_Console("          a sector twice, write it and read it again.\n");
+
+    rc = DiskControl(1, DISK_CTL_CACHE, 1);
+    DiskSize(1, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_CACHE, 1) returned %d, disk 1 has %d tracks\n", rc, disk);
+
+    for (int i = 0; i < 4; i++)
+        sprintf(XXbuf + i * 512, "sector %d", i);
+    DiskWrite(XXbuf, 1, 5, 0, 4, &status);
+
+    before = deviceReads();
+    DiskRead(YYbuf, 1, 5, 2, 1, &status);
+    USLOSS_Console("start4(): first read: %d disk reads, %s\n", deviceReads() - before, YYbuf);
+
+    before = deviceReads();
+    DiskRead(YYbuf, 1, 5, 2, 1, &status);
+    USLOSS_Console("start4(): second read: %d disk reads, %s\n", deviceReads() - before, YYbuf);
+
+    strcpy(XXbuf, "rewritten");
+    DiskWrite(XXbuf, 1, 5, 2, 1, &status);
+    before = deviceReads();
+    DiskRead(YYbuf, 1, 5, 2, 1, &status);
+    USLOSS_Console("start4(): read after a write: %d disk reads, %s\n", deviceReads() - before, YYbuf);
+
+    DiskStats(1, &stats);
+    USLOSS_Console("start4(): %d hits, %d misses\n", stats.cacheHits, stats.cacheMisses);
+
+    rc = DiskControl(1, DISK_CTL_CACHE, 1);
+    USLOSS_Console("start4(): saving the hot list returned %d\n", rc);
+
+    rc = DiskControl(1, DISK_CTL_CACHE, 0);
+    DiskSize(1, &sector, &track, &disk);
+    USLOSS_Console("start4(): DiskControl(DISK_CTL_CACHE, 0) returned %d, disk 1 has %d tracks\n", rc, disk);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define SECTORS 40
+
+static char XXbuf[SECTORS * 512];
+static char YYbuf[SECTORS * 512];
+
+
+
+static void fill(int start)
+{
+    for (int i = 0; i < SECTORS; i++)
+        sprintf(XXbuf + i * 512, "sector %d", start + i);
+}
+
+static int differ(int start)
+{
+    char expect[20];
+    int bad = 0;
+
+    for (int i = 0; i < SECTORS; i++)
+    {
+        sprintf(expect, "sector %d", start + i);
+        if (strcmp(YYbuf + i * 512, expect) != 0)
+            bad++;
+    }
+    return bad;
+}
+
+int start4(char *arg)
+{
+    diskStats before0, after0, before1, after1;
+    int status, rc;
+    int sectorSize, trackSize, tracks;
+
+    USLOSS_Console("start4(): disk copy test.  Copy %d sectors from disk 1 to\n", SECTORS);
+    USLOSS_Console("          disk 0, then overlapping runs within disk 1.\n");
+
+    fill(0);
+    DiskWrite(XXbuf, 1, 20, 5, SECTORS, &status);
+
+    DiskStats(0, &before0);
+    DiskStats(1, &before1);
+    rc = DiskCopy(1, 20, 5, 0, 12, 3, SECTORS, &status);
+    DiskStats(0, &after0);
+    DiskStats(1, &after1);
+    USLOSS_Console("start4(): DiskCopy to disk 0 returned %d, status %d\n", rc, status);
+    USLOSS_Console("start4(): disk 1 read %d sectors, disk 0 wrote %d sectors\n",
+                   after1.sectorsRead - before1.sectorsRead,
+                   after0.sectorsWritten - before0.sectorsWritten);
+
+    DiskRead(YYbuf, 0, 12, 3, SECTORS, &status);
+    USLOSS_Console("start4(): %d sectors differ on disk 0\n", differ(0));
+
+    // destination after the source: copied from the end
+    rc = DiskCopy(1, 20, 5, 1, 20, 12, SECTORS, &status);
+    DiskRead(YYbuf, 1, 20, 12, SECTORS, &status);
+    USLOSS_Console("start4(): copy 7 sectors up returned %d, %d sectors differ\n", rc, differ(0));
+
+    // and back down again
+    rc = DiskCopy(1, 20, 12, 1, 20, 5, SECTORS, &status);
+    DiskRead(YYbuf, 1, 20, 5, SECTORS, &status);
+    USLOSS_Console("start4(): copy 7 sectors down returned %d, %d sectors differ\n", rc, differ(0));
+
+    rc = DiskCopy(1, 20, 5, 0, 12, 16, SECTORS, &status);
+    USLOSS_Console("start4(): DiskCopy from sector 16 returned %d\n", rc);
+    rc = DiskCopy(1, 20, 5, 2, 0, 0, SECTORS, &status);
+    USLOSS_Console("start4(): DiskCopy to disk 2 returned %d\n", rc);
+    rc = DiskCopy(1, 20, 5, 0, 0, 0, 0, &status);
+    USLOSS_Console("start4(): DiskCopy of 0 sectors returned %d\n", rc);
+
+    // the last two tracks of a disk are too short on either side
+    DiskSize(0, &sectorSize, &trackSize, &tracks);
+    rc = DiskCopy(1, 20, 5, 0, tracks - 2, 0, SECTORS, &status);
+    USLOSS_Console("start4(): DiskCopy past the end of disk 0 returned %d\n", rc);
+    rc = DiskCopy(0, tracks - 2, 0, 1, 20, 5, SECTORS, &status);
+    USLOSS_Console("start4(): DiskCopy from past the end of disk 0 returned %d\n", rc);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
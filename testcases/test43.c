@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define LINES   12
+#define LINELEN 50
+#define INBYTES 30
+#define BATCH   16
+
+static char XXbuf[2 * 512];
+static char YYbuf[512];
+
+
+
+int start4(char *arg)
+{
+    int out, in, count, status, rc;
+    int started = 0;
+
+    USLOSS_Console("start4(): splice test.  Send %d lines from disk 1 to terminal 2\n", LINES);
+    USLOSS_Console("          while %d bytes of terminal 1 input go to disk 1.\n", INBYTES);
+
+    for (int i = 0; i < LINES; i++)
+    {
+        char *line = XXbuf + i * LINELEN;
+        memset(line, '.', LINELEN);
+        memcpy(line, "line ", 5);
+        line[5] = '0' + i / 10;
+        line[6] = '0' + i % 10;
+        memcpy(line + 7, " from disk 1 ", 13);
+        line[LINELEN - 1] = '\n';
+    }
+    DiskWrite(XXbuf, 1, 27, 0, 2, &status);
+
+    rc = SpliceDiskToTerm(1, 27, 0, LINES * LINELEN, 2, &out);
+    USLOSS_Console("start4(): SpliceDiskToTerm returned %d\n", rc);
+    rc = SpliceTermToDisk(1, 1, 26, 0, INBYTES, &in);
+    USLOSS_Console("start4(): SpliceTermToDisk returned %d\n", rc);
+
+    rc = SpliceWait(in, &count, &status);
+    USLOSS_Console("start4(): input splice: SpliceWait returned %d, %d bytes, status %d\n", rc, count, status);
+    DiskRead(YYbuf, 1, 26, 0, 1, &status);
+    USLOSS_Console("start4(): disk 1 now holds \"%s\"\n", YYbuf);
+
+    rc = SpliceWait(out, &count, &status);
+    USLOSS_Console("start4(): output splice: SpliceWait returned %d, %d bytes, status %d\n", rc, count, status);
+
+    USLOSS_Console("start4(): SpliceWait again returned %d\n", SpliceWait(out, &count, &status));
+    USLOSS_Console("start4(): SpliceDiskToTerm to terminal 4 returned %d\n",
+                   SpliceDiskToTerm(1, 27, 0, 10, 4, &out));
+
+    // splices nobody waits for must not keep their slots: two batches
+    // that each fill every slot, waiting only for the last of each
+    memset(YYbuf, 0, sizeof(YYbuf));
+    strcpy(YYbuf, "spliced\n");
+    DiskWrite(YYbuf, 1, 25, 0, 1, &status);
+    for (int batch = 0; batch < 2; batch++)
+    {
+        for (int i = 0; i < BATCH; i++)
+            if (SpliceDiskToTerm(1, 25, 0, 8, 3, &out) == 0)
+                started++;
+        SpliceWait(out, &count, &status);
+    }
+    USLOSS_Console("start4(): %d of %d splices to terminal 3 started\n", started, 2 * BATCH);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define TRACKS  16
+#define SECTORS (TRACKS * 16)
+
+static char XXbuf[SECTORS * 512];
+static char YYbuf[SECTORS * 512];
+static char ZZbuf[512];
+static int bigDone;
+
+
+
+int big(char *arg)
+{
+    int status;
+
+    DiskRead(YYbuf, 1, 1, 0, SECTORS, &status);
+    bigDone = 1;
+    USLOSS_Console("big(): read of tracks 1 to %d done, status %d, data %s\n",
+                   TRACKS, status, memcmp(XXbuf, YYbuf, sizeof(XXbuf)) == 0 ? "ok" : "WRONG");
+
+    Terminate(1);
+}
+
+int small(char *arg)
+{
+    int status;
+
+    DiskRead(ZZbuf, 1, 8, 0, 1, &status);
+    USLOSS_Console("small(): read of track 8 done, status %d, big read %s\n",
+                   status, bigDone ? "already done" : "still going");
+
+    Terminate(2);
+}
+
+int start4(char *arg)
+{
+    int status, pid;
+
+    USLOSS_Console("start4(): chunking test.  Read tracks 1 to %d of disk 1\n", TRACKS);
+    USLOSS_Console("          in one request, and queue a one sector read of\n");
+    USLOSS_Console("          track 8 behind it.  The small read must not wait\n");
+    USLOSS_Console("          for the whole big one.\n");
+
+    for (int i = 0; i < SECTORS; i++)
+        sprintf(XXbuf + i * 512, "chunk test sector %d", i);
+    DiskWrite(XXbuf, 1, 1, 0, SECTORS, &status);
+    USLOSS_Console("start4(): write of tracks 1 to %d, status %d\n", TRACKS, status);
+
+    // big queues first; small only runs once big is blocked on the disk
+    Spawn("big",   big,   NULL, USLOSS_MIN_STACK, 3, &pid);
+    Spawn("small", small, NULL, USLOSS_MIN_STACK, 4, &pid);
+
+    Wait(&pid, &status);
+    Wait(&pid, &status);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <usloss.h>
+#include <usyscall.h>
+
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3.h>
+#include <phase3_usermode.h>
+#include <phase4.h>
+#include <phase4_usermode.h>
+
+#define SECTORS 80
+
+static char XXbuf[SECTORS * 512];
+static char YYbuf[SECTORS * 512];
+
+
+
+int start4(char *arg)
+{
+    int status;
+    diskStats before, after;
+
+    USLOSS_Console("start4(): chaining test.  Write and read back %d sectors\n", SECTORS);
+    USLOSS_Console("          of disk 1 from track 3 sector 5, more device\n");
+    USLOSS_Console("          steps than one chain holds.\n");
+
+    for (int i = 0; i < SECTORS; i++)
+        sprintf(XXbuf + i * 512, "chain test sector %d", i);
+
+    // put the head on track 3, so the seeks below are known
+    DiskRead(YYbuf, 1, 3, 0, 1, &status);
+    DiskStats(1, &before);
+
+    DiskWrite(XXbuf, 1, 3, 5, SECTORS, &status);
+    USLOSS_Console("start4(): write status %d\n", status);
+    memset(YYbuf, 0, sizeof(YYbuf));
+    DiskRead(YYbuf, 1, 3, 5, SECTORS, &status);
+    USLOSS_Console("start4(): read status %d, data %s\n",
+                   status, memcmp(XXbuf, YYbuf, sizeof(XXbuf)) == 0 ? "ok" : "WRONG");
+
+    DiskStats(1, &after);
+    USLOSS_Console("start4(): %d reads, %d writes, %d sectors read, %d sectors written\n",
+                   after.reads - before.reads, after.writes - before.writes,
+                   after.sectorsRead - before.sectorsRead, after.sectorsWritten - before.sectorsWritten);
+    USLOSS_Console("start4(): %d seeks over %d tracks\n",
+                   after.seeks - before.seeks, after.seekDistance - before.seekDistance);
+
+    USLOSS_Console("start4(): done\n");
+    Terminate(0);
+}